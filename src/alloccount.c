@@ -0,0 +1,63 @@
+/* alloccount.c
+ *
+ * Counter of the heap allocations, only linked by a build with
+ * -DALLOC_CHECK=ON. The allocator of the libc is interposed so the
+ * allocations made inside the libc (stdio, opendir...) are counted too, the
+ * replay fails when a tick past the warm up allocates.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stddef.h>
+#include <errno.h>
+
+#include "selfstat.h"
+
+/* entry points of the glibc allocator */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+  selfstat_allocs++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+  selfstat_allocs++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  selfstat_allocs++;
+  return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+  selfstat_allocs++;
+  if ((*memptr = __libc_memalign(alignment, size)) == NULL)
+    return ENOMEM;
+  return 0;
+}
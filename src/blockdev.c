@@ -0,0 +1,469 @@
+/* blockdev.c
+ *
+ * Block devices of Linux (/sys/block) and their lines of /proc/diskstats.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "blockdev.h"
+#include "jsonscan.h"
+#include "selfstat.h"
+
+#define BLOCKDEV_BUF_MIN 16384
+#define BLOCKDEV_UEVENT_GROUP 1         /* the uevents of the kernel, not of udev */
+
+static char blockdev_uevent[8192];
+
+void blockdev_init(blockdev_table_t *t)
+{
+  memset(t, 0, sizeof(*t));
+  t->uevent_fd = t->fd = -1;
+  t->stale = 1;
+}
+
+static int blockdev_split(char *list, const char **patterns)
+{
+  char *p, *save = NULL;
+  int n = 0;
+
+  for (p = strtok_r(list, ",", &save); p && n < BLOCKDEV_PATTERNS_MAX; p = strtok_r(NULL, ",", &save))
+    patterns[n++] = p;
+  return n;
+}
+
+int blockdev_select(blockdev_table_t *t, const char *include, const char *exclude, int partitions)
+{
+  size_t li, le;
+
+  if (!exclude)
+    exclude = BLOCKDEV_EXCLUDE;
+  li = (include) ? strlen(include) : 0;
+  le = strlen(exclude);
+  free(t->patterns);
+  if ((t->patterns = malloc(li + le + 2)) == NULL)
+    return -1;
+  memcpy(t->patterns, (include) ? include : "", li + 1);
+  memcpy(t->patterns + li + 1, exclude, le + 1);
+  t->ninclude = blockdev_split(t->patterns, t->include);
+  t->nexclude = blockdev_split(t->patterns + li + 1, t->exclude);
+  t->partitions = partitions;
+  t->stale = 1;
+  return 0;
+}
+
+static blockdev_t *blockdev_add(blockdev_table_t *t, const char *name, unsigned int major, unsigned int minor, int partition)
+{
+  blockdev_t *d;
+
+  if (t->nb == t->max)
+  {
+    int max = (t->max) ? t->max * 2 : 64;
+
+    if ((d = realloc(t->devs, max * sizeof(blockdev_t))) == NULL)
+      return NULL;
+    t->devs = d;
+    t->max = max;
+  }
+  d = t->devs + t->nb++;
+  d->major = major;
+  d->minor = minor;
+  snprintf(d->name, sizeof(d->name), "%.*s", BLOCKDEV_NAME_MAX - 1, name);
+  strcpy(d->label, d->name);
+  d->partition = partition;
+  d->selected = 0;
+  return d;
+}
+
+/* the first line of the file at path, the json quotes replaced */
+static int blockdev_line(int dirfd, const char *path, char *buf, size_t len)
+{
+  ssize_t r;
+  char *p;
+  int fd;
+
+  if ((fd = selfstat_openat(dirfd, path, O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  r = selfstat_read(fd, buf, len - 1);
+  close(fd);
+  if (r <= 0)
+    return -1;
+  buf[r] = '\0';
+  for (p = buf; *p && *p != '\n'; p++)
+    if (*p == '"' || *p == '\\')
+      *p = '_';
+  *p = '\0';
+  return 0;
+}
+
+/* "8:16" */
+static int blockdev_dev(int dirfd, const char *path, unsigned int *major, unsigned int *minor)
+{
+  char buf[32];
+
+  if (blockdev_line(dirfd, path, buf, sizeof(buf)) < 0)
+    return -1;
+  return (sscanf(buf, "%u:%u", major, minor) == 2) ? 0 : -1;
+}
+
+/* the partitions of a disk are the directories with a partition file, their
+ * names start with the name of the disk (sda1, nvme0n1p1) */
+static void blockdev_partitions(blockdev_table_t *t, int dirfd, const char *disk)
+{
+  char path[NAME_MAX + sizeof("/partition")];
+  unsigned int major, minor;
+  struct dirent *de;
+  size_t len = strlen(disk);
+  DIR *dir;
+  int fd;
+
+  if ((fd = dup(dirfd)) < 0)
+    return;
+  if ((dir = fdopendir(fd)) == NULL)
+  {
+    close(fd);
+    return;
+  }
+  while ((de = readdir(dir)) != NULL)
+  {
+    if (strncmp(de->d_name, disk, len) || !de->d_name[len])
+      continue;
+    snprintf(path, sizeof(path), "%s/partition", de->d_name);
+    if (faccessat(dirfd, path, F_OK, 0) < 0)
+      continue;
+    snprintf(path, sizeof(path), "%s/dev", de->d_name);
+    if (!blockdev_dev(dirfd, path, &major, &minor))
+      blockdev_add(t, de->d_name, major, minor, 1);
+  }
+  closedir(dir);
+}
+
+/* "/dev/md/data -> ../md127" */
+static void blockdev_md(blockdev_table_t *t)
+{
+  char link[BLOCKDEV_NAME_MAX], *p;
+  struct dirent *de;
+  ssize_t r;
+  DIR *dir;
+  int i;
+
+  if ((dir = selfstat_opendir(BLOCKDEV_MD_DIR)) == NULL)
+    return;
+  while ((de = readdir(dir)) != NULL)
+  {
+    if (*de->d_name == '.' || (r = readlinkat(dirfd(dir), de->d_name, link, sizeof(link) - 1)) <= 0)
+      continue;
+    link[r] = '\0';
+    p = (p = strrchr(link, '/')) ? p + 1 : link;
+    for (i = 0; i < t->nb; i++)
+      if (!strcmp(t->devs[i].name, p))
+        snprintf(t->devs[i].label, sizeof(t->devs[i].label), "%.*s", BLOCKDEV_NAME_MAX - 1, de->d_name);
+  }
+  closedir(dir);
+}
+
+static int blockdev_sysfs(blockdev_table_t *t)
+{
+  char path[sizeof(BLOCKDEV_DIR) + NAME_MAX + 1];
+  unsigned int major, minor;
+  struct dirent *de;
+  blockdev_t *d;
+  int dirfd;
+  DIR *dir;
+
+  if ((dir = selfstat_opendir(BLOCKDEV_DIR)) == NULL)
+    return -1;
+  while ((de = readdir(dir)) != NULL)
+  {
+    if (*de->d_name == '.')
+      continue;
+    snprintf(path, sizeof(path), BLOCKDEV_DIR "/%s", de->d_name);
+    if ((dirfd = selfstat_open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+      continue;
+    /* the label is left to the name without dm/name */
+    if (!blockdev_dev(dirfd, "dev", &major, &minor) && (d = blockdev_add(t, de->d_name, major, minor, 0)) != NULL
+        && (blockdev_line(dirfd, "dm/name", d->label, sizeof(d->label)) < 0 || !*d->label))
+      strcpy(d->label, d->name);
+    blockdev_partitions(t, dirfd, de->d_name);
+    close(dirfd);
+  }
+  closedir(dir);
+  blockdev_md(t);
+  return 0;
+}
+
+/* "   8       0 sda 1234 ...", p is moved after the name */
+static char *blockdev_parse(char *p, unsigned int *major, unsigned int *minor, char **name, int *lname)
+{
+  while (*p == ' ')
+    p++;
+  for (*major = 0; *p >= '0' && *p <= '9'; p++)
+    *major = *major * 10 + (*p - '0');
+  while (*p == ' ')
+    p++;
+  for (*minor = 0; *p >= '0' && *p <= '9'; p++)
+    *minor = *minor * 10 + (*p - '0');
+  while (*p == ' ')
+    p++;
+  for (*name = p; *p && *p != ' ' && *p != '\n'; p++)
+    ;
+  *lname = p - *name;
+  return p;
+}
+
+static char *blockdev_eol(char *p)
+{
+  while (*p && *p != '\n')
+    p++;
+  return p + (*p == '\n');
+}
+
+#define BLOCKDEV_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+static int blockdev_compare_name(const void *a, const void *b)
+{
+  return strcmp((*(const blockdev_t *const *)a)->name, (*(const blockdev_t *const *)b)->name);
+}
+
+/* length of the name of the disk of a partition as the kernel names it, the
+ * disk then the number with a 'p' between them when the disk ends with a
+ * digit (sda1, vdb2, nvme0n1p1, mmcblk0p2), 0 when it cannot be one */
+static int blockdev_disk_len(const char *name)
+{
+  int l = strlen(name), n = l;
+
+  while (n && BLOCKDEV_DIGIT(name[n - 1]))
+    n--;
+  if (!n || n == l)
+    return 0;
+  if (n >= 2 && name[n - 1] == 'p' && BLOCKDEV_DIGIT(name[n - 2]))
+    n--;
+  return n;
+}
+
+/* without /sys/block, the devices of the lines. A device is a partition when
+ * its name is the one of a partition of another listed device */
+static void blockdev_diskstats(blockdev_table_t *t)
+{
+  char *p, *name, buf[BLOCKDEV_NAME_MAX];
+  unsigned int major, minor;
+  blockdev_t **byname, key, *pkey = &key;
+  int lname, i;
+
+  for (p = t->buf; *p; p = blockdev_eol(p))
+  {
+    p = blockdev_parse(p, &major, &minor, &name, &lname);
+    snprintf(buf, sizeof(buf), "%.*s", lname, name);
+    blockdev_add(t, buf, major, minor, 0);
+  }
+
+  if ((byname = malloc((t->nb + 1) * sizeof(blockdev_t *))) == NULL)
+    return;
+  for (i = 0; i < t->nb; i++)
+    byname[i] = t->devs + i;
+  qsort(byname, t->nb, sizeof(blockdev_t *), blockdev_compare_name);
+  for (i = 0; i < t->nb; i++)
+  {
+    int l = blockdev_disk_len(t->devs[i].name);
+
+    if (!l)
+      continue;
+    snprintf(key.name, sizeof(key.name), "%.*s", l, t->devs[i].name);
+    t->devs[i].partition = bsearch(&pkey, byname, t->nb, sizeof(blockdev_t *), blockdev_compare_name) != NULL;
+  }
+  free(byname);
+}
+
+static int blockdev_match(const char *const *patterns, int n, const blockdev_t *d)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (jsonscan_match(patterns[i], d->name) || jsonscan_match(patterns[i], d->label))
+      return 1;
+  return 0;
+}
+
+static int blockdev_compare(const void *a, const void *b)
+{
+  const blockdev_t *x = a, *y = b;
+
+  if (x->major != y->major)
+    return (x->major < y->major) ? -1 : 1;
+  return (x->minor < y->minor) ? -1 : (x->minor > y->minor);
+}
+
+static void blockdev_scan(blockdev_table_t *t)
+{
+  int i;
+
+  if (!t->patterns)
+    blockdev_select(t, NULL, NULL, 0);
+  t->nb = 0;
+  if (blockdev_sysfs(t) < 0)
+    blockdev_diskstats(t);
+  qsort(t->devs, t->nb, sizeof(blockdev_t), blockdev_compare);
+  for (i = 0; i < t->nb; i++)
+  {
+    blockdev_t *d = t->devs + i;
+
+    d->selected = (!d->partition || t->partitions) && !blockdev_match(t->exclude, t->nexclude, d)
+                  && (!t->ninclude || blockdev_match(t->include, t->ninclude, d));
+  }
+  t->stale = 0;
+}
+
+static int blockdev_find(blockdev_table_t *t, unsigned int major, unsigned int minor)
+{
+  blockdev_t key, *d;
+
+  key.major = major;
+  key.minor = minor;
+  d = bsearch(&key, t->devs, t->nb, sizeof(blockdev_t), blockdev_compare);
+  return (d && d->selected) ? d - t->devs : -1;
+}
+
+/* the lines are checked against the previous ones, -1 when they differ.
+ * rebuild maps them to the devices again */
+static int blockdev_lines(blockdev_table_t *t, int rebuild)
+{
+  unsigned int major, minor;
+  char *p, *name;
+  int n, lname;
+
+  if (rebuild)
+    t->nselected = 0;
+  for (p = t->buf, n = 0; *p; p = blockdev_eol(p), n++)
+  {
+    p = blockdev_parse(p, &major, &minor, &name, &lname);
+    if (!rebuild)
+    {
+      if (n >= t->nlines || t->lines[n].major != major || t->lines[n].minor != minor)
+        return -1;
+      t->lines[n].fields = p;
+      continue;
+    }
+    if (n == t->maxlines)
+    {
+      int max = (t->maxlines) ? t->maxlines * 2 : 64;
+      void *l;
+
+      if ((l = realloc(t->lines, max * sizeof(blockdev_line_t))) == NULL)
+        return -1;
+      t->lines = l;
+      t->maxlines = max;
+    }
+    t->lines[n].major = major;
+    t->lines[n].minor = minor;
+    t->lines[n].fields = p;
+    if ((t->lines[n].dev = blockdev_find(t, major, minor)) >= 0)
+      t->nselected++;
+  }
+  if (!rebuild && n != t->nlines)
+    return -1;
+  t->nlines = n;
+  return n;
+}
+
+static void blockdev_uevent_open(blockdev_table_t *t)
+{
+  struct sockaddr_nl sa;
+
+  if ((t->uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT)) < 0)
+    return;
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+  sa.nl_groups = BLOCKDEV_UEVENT_GROUP;
+  if (bind(t->uevent_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    close(t->uevent_fd);
+    t->uevent_fd = -1;
+  }
+}
+
+int blockdev_uevent_fd(blockdev_table_t *t, int polled)
+{
+  if (t->uevent_fd < 0)
+    blockdev_uevent_open(t);
+  t->polled = (t->uevent_fd >= 0) ? polled : 0;
+  return t->uevent_fd;
+}
+
+/* "add@/devices/.../block/sdb\0ACTION=add\0...\0SUBSYSTEM=block\0..." */
+void blockdev_uevents(blockdev_table_t *t)
+{
+  ssize_t len;
+  char *p;
+
+  if (t->uevent_fd < 0)
+    return;
+  while ((len = recv(t->uevent_fd, blockdev_uevent, sizeof(blockdev_uevent) - 1, 0)) > 0)
+  {
+    blockdev_uevent[len] = '\0';
+    for (p = blockdev_uevent; p < blockdev_uevent + len; p += strlen(p) + 1)
+      if (!strcmp(p, "SUBSYSTEM=block"))
+        t->stale = 1;
+  }
+}
+
+int blockdev_read(blockdev_table_t *t)
+{
+  if (t->fd < 0 || t->gen != selfstat_generation())
+  {
+    if (t->fd >= 0)
+      close(t->fd);
+    t->gen = selfstat_generation();
+    if ((t->fd = selfstat_open(BLOCKDEV_DISKSTATS, O_RDONLY | O_CLOEXEC)) < 0)
+      return -1;
+    if (t->uevent_fd < 0)
+      blockdev_uevent_open(t);
+  }
+  if (selfstat_pread_all(t->fd, &t->buf, &t->size, BLOCKDEV_BUF_MIN) < 0)
+    return -1;
+
+  if (!t->polled)
+    blockdev_uevents(t);
+  if (!t->stale && blockdev_lines(t, 0) >= 0)
+    return t->nlines;
+  blockdev_scan(t);
+  return blockdev_lines(t, 1);
+}
+
+void blockdev_close(blockdev_table_t *t)
+{
+  if (t->fd >= 0)
+    close(t->fd);
+  if (t->uevent_fd >= 0)
+    close(t->uevent_fd);
+  free(t->patterns);
+  free(t->buf);
+  free(t->devs);
+  free(t->lines);
+  blockdev_init(t);
+}
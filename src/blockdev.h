@@ -0,0 +1,101 @@
+/* blockdev.h
+ *
+ * Block devices of Linux (/sys/block) and their lines of /proc/diskstats.
+ *
+ * The devices are listed from /sys/block with their partitions, the name of
+ * a device mapper from its dm/name and the name of a md array from its link
+ * in /dev/md. Whether a device is kept is decided once at the listing from
+ * the include and exclude patterns, each line of diskstats is then mapped
+ * to its device. At each read the lines are only checked against the
+ * previous ones (major and minor), the devices are listed again when they
+ * differ or when the kernel sent a uevent of the block subsystem. The daemon
+ * reads the uevents from its event loop, the replay at each read.
+ *
+ * Without /sys/block (older captures) the devices are taken from diskstats,
+ * a device being a partition when its name is the one the kernel gives to a
+ * partition of another device (sda1, vda1, nvme0n1p1, mmcblk0p1).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _BLOCKDEV_H
+#define _BLOCKDEV_H
+
+#include <inttypes.h>
+
+#define BLOCKDEV_DIR "/sys/block"
+#define BLOCKDEV_MD_DIR "/dev/md"
+#define BLOCKDEV_DISKSTATS "/proc/diskstats"
+#define BLOCKDEV_EXCLUDE "loop*,ram*"   /* exclude patterns by default */
+#define BLOCKDEV_NAME_MAX 64
+#define BLOCKDEV_PATTERNS_MAX 16
+
+typedef struct {
+  unsigned int major;
+  unsigned int minor;
+  char name[BLOCKDEV_NAME_MAX];         /* name of the kernel, dm-0 */
+  char label[BLOCKDEV_NAME_MAX];        /* dm/name, link of /dev/md or name */
+  int partition;
+  int selected;
+} blockdev_t;
+
+typedef struct {
+  unsigned int major;
+  unsigned int minor;
+  int dev;              /* index in devs, -1 for a device not selected */
+  char *fields;         /* columns after the name, in buf until the next read */
+} blockdev_line_t;
+
+typedef struct {
+  char *patterns;       /* copy of the lists, the patterns point into it */
+  const char *include[BLOCKDEV_PATTERNS_MAX];   /* none for all */
+  int ninclude;
+  const char *exclude[BLOCKDEV_PATTERNS_MAX];
+  int nexclude;
+  int partitions;       /* the partitions are selected too */
+  int stale;            /* the devices are listed again at the next read */
+  int uevent_fd;        /* netlink socket of the uevents, -1 without */
+  int polled;           /* uevent_fd is read by an event loop, not by the read */
+  int fd;               /* diskstats */
+  unsigned int gen;
+  char *buf;            /* whole diskstats, grown and never shrunk */
+  size_t size;
+  blockdev_t *devs;     /* by major and minor */
+  int nb;
+  int max;
+  blockdev_line_t *lines;
+  int nlines;
+  int maxlines;
+  int nselected;        /* lines with dev >= 0 */
+} blockdev_table_t;
+
+void blockdev_init(blockdev_table_t *t);
+/* comma separated patterns of '*' and '?' matched against the names and
+ * the labels, NULL for the defaults */
+int  blockdev_select(blockdev_table_t *t, const char *include, const char *exclude, int partitions);
+/* the number of lines, the lines of the devices kept have dev >= 0 */
+int  blockdev_read(blockdev_table_t *t);
+/* the socket of the uevents opened for an event loop if polled, -1 without */
+int  blockdev_uevent_fd(blockdev_table_t *t, int polled);
+/* reads the pending uevents, a device added or removed is listed at the next read */
+void blockdev_uevents(blockdev_table_t *t);
+void blockdev_close(blockdev_table_t *t);
+
+#endif /* _BLOCKDEV_H */
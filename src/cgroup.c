@@ -0,0 +1,582 @@
+/* cgroup.c
+ *
+ * Resource usage of the cgroups v2 of Linux (/sys/fs/cgroup).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+/* getdents64 */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+
+#include "cgroup.h"
+#include "selfstat.h"
+
+#define CGROUP_WATCH (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+const char *cgroup_files[CGROUP_FILES] = {
+  "cpu.stat", "memory.current", "memory.stat", "io.stat", "pids.current"
+};
+
+/* a walk lists one directory at a time and a refresh reads the events in
+ * place, neither allocates */
+static char cgroup_dents[32768];
+static char cgroup_events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+void cgroup_init(cgroup_tree_t *t, int depth)
+{
+  memset(t, 0, sizeof(*t));
+  t->depth = depth;
+  t->inotify_fd = -1;
+}
+
+static void cgroup_release(cgroup_tree_t *t, cgroup_t *c)
+{
+  int f;
+
+  if (c->wd >= 0 && t->inotify_fd >= 0)
+    inotify_rm_watch(t->inotify_fd, c->wd);
+  c->wd = -1;
+  if (c->dirfd >= 0)
+    close(c->dirfd);
+  c->dirfd = -1;
+  for (f = 0; f < CGROUP_FILES; f++)
+    if (c->fd[f] >= 0)
+    {
+      close(c->fd[f]);
+      c->fd[f] = -1;
+    }
+}
+
+/* the slots of the removed cgroups are reused, it returns an index as the
+ * array may move */
+static int cgroup_new(cgroup_tree_t *t, const char *path, int depth)
+{
+  cgroup_t *c;
+  int i, f;
+
+  for (i = (t->count < t->nb) ? 0 : t->nb; i < t->nb && t->cgroups[i].used; i++)
+    ;
+  if (i == t->max)
+  {
+    int max = (t->max) ? 2*t->max : 64;
+    cgroup_t *cgroups = (cgroup_t *)realloc(t->cgroups, sizeof(cgroup_t)*max);
+    if (!cgroups)
+      return -1;
+    t->cgroups = cgroups;
+    t->max = max;
+  }
+  if (i == t->nb)
+    t->nb++;
+
+  c = t->cgroups + i;
+  memset(c, 0, sizeof(*c));
+  snprintf(c->path, sizeof(c->path), "%s", path);
+  c->depth = depth;
+  c->used = 1;
+  c->dirfd = -1;
+  c->wd = -1;
+  for (f = 0; f < CGROUP_FILES; f++)
+    c->fd[f] = -1;
+  t->count++;
+  return i;
+}
+
+/* the files missing (controller not enabled) stay at -1, the directory is
+ * only kept open and watched above the depth */
+static void cgroup_attach(cgroup_tree_t *t, cgroup_t *c, int dirfd)
+{
+  char buf[PATH_MAX], path[CGROUP_PATH_MAX + sizeof(CGROUP_DIR) + 1];
+  int f;
+
+  c->dirfd = dirfd;
+  for (f = 0; f < CGROUP_FILES; f++)
+    c->fd[f] = selfstat_openat(dirfd, cgroup_files[f], O_RDONLY | O_CLOEXEC);
+
+  if (c->depth >= t->depth)
+  {
+    close(c->dirfd);
+    c->dirfd = -1;
+    return;
+  }
+  snprintf(path, sizeof(path), CGROUP_DIR "%s%s", (*c->path) ? "/" : "", c->path);
+  if (t->inotify_fd >= 0)
+    c->wd = inotify_add_watch(t->inotify_fd, selfstat_path(path, buf, sizeof(buf)), CGROUP_WATCH);
+}
+
+/* search from the last match, a walk finds the cgroups in the same order */
+static int cgroup_find(cgroup_tree_t *t, const char *path, int *hint)
+{
+  int n, i;
+
+  for (n = 0, i = (*hint < t->nb) ? *hint : 0; n < t->nb; n++, i = (i + 1 < t->nb) ? i + 1 : 0)
+    if (t->cgroups[i].used && !strcmp(t->cgroups[i].path, path))
+    {
+      *hint = i + 1;
+      return i;
+    }
+  return -1;
+}
+
+static void cgroup_child(cgroup_tree_t *t, int parent, const char *name, int *hint)
+{
+  char path[CGROUP_PATH_MAX];
+  int i, fd;
+
+  if (snprintf(path, sizeof(path), "%s%s%s", t->cgroups[parent].path, (*t->cgroups[parent].path) ? "/" : "", name) >= (int)sizeof(path))
+    return;
+
+  /* already known, or found again by a walk */
+  if ((i = cgroup_find(t, path, hint)) >= 0 && !t->cgroups[i].stale)
+    return;
+  if ((fd = selfstat_openat(t->cgroups[parent].dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    return;
+  if (i < 0 && (i = cgroup_new(t, path, t->cgroups[parent].depth + 1)) < 0)
+  {
+    close(fd);
+    return;
+  }
+  t->cgroups[i].stale = 0;
+  t->cgroups[i].listed = 0;
+  cgroup_attach(t, t->cgroups + i, fd);
+}
+
+static void cgroup_list(cgroup_tree_t *t, int idx, int *hint)
+{
+  struct dirent64 *dent;
+  ssize_t len, pos;
+
+  t->cgroups[idx].listed = 1;
+  if (t->cgroups[idx].dirfd < 0 || lseek(t->cgroups[idx].dirfd, 0, SEEK_SET) < 0)
+    return;
+
+  while ((len = getdents64(t->cgroups[idx].dirfd, cgroup_dents, sizeof(cgroup_dents))) > 0)
+    for (pos = 0; pos < len; pos += dent->d_reclen)
+    {
+      dent = (struct dirent64 *)(cgroup_dents + pos);
+      if (dent->d_type != DT_DIR || !strcmp(dent->d_name, ".") || !strcmp(dent->d_name, ".."))
+        continue;
+      cgroup_child(t, idx, dent->d_name, hint);
+    }
+}
+
+/* lists the new directories, a slot reused may be before the current one */
+static void cgroup_expand(cgroup_tree_t *t, int *hint)
+{
+  int i, listed;
+
+  do
+  {
+    listed = 0;
+    for (i = 0; i < t->nb; i++)
+      if (t->cgroups[i].used && !t->cgroups[i].stale && !t->cgroups[i].listed)
+      {
+        cgroup_list(t, i, hint);
+        listed = 1;
+      }
+  } while (listed);
+}
+
+/* a cgroup is only removed without children, the prefix is for the events lost */
+static void cgroup_remove(cgroup_tree_t *t, const char *path)
+{
+  size_t l = strlen(path);
+  int i;
+
+  for (i = 0; i < t->nb; i++)
+  {
+    cgroup_t *c = t->cgroups + i;
+
+    if (!c->used || strncmp(c->path, path, l) || (c->path[l] && c->path[l] != '/'))
+      continue;
+    cgroup_release(t, c);
+    c->used = 0;
+    t->count--;
+  }
+}
+
+/* The known cgroups are found again by their path, so they keep their
+ * previous values and their rates go on after a new root.
+ */
+static int cgroup_walk(cgroup_tree_t *t)
+{
+  int i, fd, hint = 0;
+
+  /* the inotify fd is kept, its close waits for a grace period of the kernel */
+  for (i = 0; i < t->nb; i++)
+  {
+    cgroup_release(t, t->cgroups + i);
+    t->cgroups[i].stale = 1;
+  }
+  t->gen = selfstat_generation();
+  t->rescan = 0;
+  if (t->inotify_fd < 0)
+    t->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  /* a v1 or hybrid hierarchy has no cgroup.controllers at its root */
+  if ((fd = selfstat_open(CGROUP_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0 && faccessat(fd, "cgroup.controllers", F_OK, 0) < 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+  if (fd >= 0)
+  {
+    if ((i = cgroup_find(t, "", &hint)) < 0 && (i = cgroup_new(t, "", 0)) < 0)
+      close(fd);
+    else
+    {
+      t->cgroups[i].stale = 0;
+      t->cgroups[i].listed = 0;
+      cgroup_attach(t, t->cgroups + i, fd);
+      cgroup_expand(t, &hint);
+    }
+  }
+
+  for (i = 0; i < t->nb; i++)
+    if (t->cgroups[i].used && t->cgroups[i].stale)
+    {
+      t->cgroups[i].used = 0;
+      t->count--;
+    }
+  return (t->count) ? 0 : -1;
+}
+
+/* Each cgroup holds up to 6 fds, the soft limit of the open files is raised
+ * to the hard one for the large hierarchies.
+ */
+int cgroup_open(cgroup_tree_t *t)
+{
+  struct rlimit rl;
+
+  if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max)
+  {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  return cgroup_walk(t);
+}
+
+static void cgroup_event(cgroup_tree_t *t, struct inotify_event *ev, int *hint)
+{
+  char path[CGROUP_PATH_MAX];
+  int p;
+
+  if (ev->mask & IN_Q_OVERFLOW)
+  {
+    t->rescan = 1;
+    return;
+  }
+  if (!(ev->mask & IN_ISDIR) || !ev->len)
+    return;
+
+  for (p = 0; p < t->nb && !(t->cgroups[p].used && t->cgroups[p].wd == ev->wd); p++)
+    ;
+  if (p == t->nb)
+    return;
+
+  if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+    cgroup_child(t, p, ev->name, hint);
+  else if (snprintf(path, sizeof(path), "%s%s%s", t->cgroups[p].path, (*t->cgroups[p].path) ? "/" : "", ev->name) < (int)sizeof(path))
+    cgroup_remove(t, path);
+}
+
+/* the fd is drained even once the events are lost, a level triggered loop
+ * would call again for them */
+void cgroup_inotify(cgroup_tree_t *t)
+{
+  struct inotify_event *ev;
+  ssize_t len, pos;
+  int hint = 0;
+
+  if (t->inotify_fd < 0)
+    return;
+  while ((len = read(t->inotify_fd, cgroup_events, sizeof(cgroup_events))) > 0)
+    for (pos = 0; pos < len && !t->rescan; pos += sizeof(struct inotify_event) + ev->len)
+    {
+      ev = (struct inotify_event *)(cgroup_events + pos);
+      cgroup_event(t, ev, &hint);
+    }
+}
+
+int cgroup_refresh(cgroup_tree_t *t)
+{
+  int hint = 0;
+
+  if (t->gen != selfstat_generation() || t->inotify_fd < 0)
+    t->rescan = 1;
+  if (!t->polled && !t->rescan)
+    cgroup_inotify(t);
+
+  if (t->rescan)
+    return cgroup_walk(t);
+  /* a directory created before its watch */
+  cgroup_expand(t, &hint);
+  return 0;
+}
+
+static uint64_t cgroup_value(int fd)
+{
+  char buf[32];
+  ssize_t n;
+
+  if (fd < 0 || (n = selfstat_pread(fd, buf, sizeof(buf) - 1, 0)) <= 0)
+    return 0;
+  buf[n] = '\0';
+  return strtoull(buf, NULL, 10);
+}
+
+/* "<key> <value>" of cpu.stat and memory.stat */
+static void cgroup_cpu_line(char *l, cgroup_stat_t *st)
+{
+  char *v = strchr(l, ' ');
+
+  if (!v)
+    return;
+  *v++ = '\0';
+  if (!strcmp(l, "usage_usec"))
+    st->usage_usec = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "user_usec"))
+    st->user_usec = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "system_usec"))
+    st->system_usec = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "nr_periods"))
+    st->nr_periods = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "nr_throttled"))
+    st->nr_throttled = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "throttled_usec"))
+    st->throttled_usec = strtoull(v, NULL, 10);
+}
+
+static void cgroup_memory_line(char *l, cgroup_stat_t *st)
+{
+  char *v = strchr(l, ' ');
+
+  if (!v)
+    return;
+  *v++ = '\0';
+  if (!strcmp(l, "anon"))
+    st->anon = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "file"))
+    st->file = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "shmem"))
+    st->shmem = strtoull(v, NULL, 10);
+  else if (!strcmp(l, "pgmajfault"))
+    st->pgmajfault = strtoull(v, NULL, 10);
+}
+
+/* "<major>:<minor> rbytes=<n> wbytes=<n> rios=<n> wios=<n> dbytes=<n> dios=<n>" per device */
+static void cgroup_io_line(char *l, cgroup_stat_t *st)
+{
+  char *p;
+
+  if ((p = strstr(l, " rbytes=")))
+    st->rbytes += strtoull(p + 8, NULL, 10);
+  if ((p = strstr(l, " wbytes=")))
+    st->wbytes += strtoull(p + 8, NULL, 10);
+  if ((p = strstr(l, " rios=")))
+    st->rios += strtoull(p + 6, NULL, 10);
+  if ((p = strstr(l, " wios=")))
+    st->wios += strtoull(p + 6, NULL, 10);
+}
+
+/* The file is read by chunks of whole lines. The files of the cgroups are
+ * generated in one piece, a short read is the end of the file.
+ */
+static void cgroup_lines(int fd, cgroup_stat_t *st, void (*line)(char *, cgroup_stat_t *))
+{
+  char buf[4096], *p, *nl;
+  size_t keep = 0;
+  off_t off = 0;
+  ssize_t n;
+
+  if (fd < 0)
+    return;
+  while ((n = selfstat_pread(fd, buf + keep, sizeof(buf) - 1 - keep, off)) > 0)
+  {
+    int last = (size_t)n < sizeof(buf) - 1 - keep;
+
+    off += n;
+    buf[keep + n] = '\0';
+    for (p = buf; (nl = strchr(p, '\n')); p = nl + 1)
+    {
+      *nl = '\0';
+      line(p, st);
+    }
+    if (last)
+      break;
+    /* a line longer than the buffer is skipped */
+    keep = (p == buf) ? 0 : (size_t)(buf + keep + n - p);
+    memmove(buf, p, keep);
+  }
+}
+
+int cgroup_read(cgroup_t *c, cgroup_stat_t *st)
+{
+  memset(st, 0, sizeof(*st));
+  if (!c->used)
+    return -1;
+  cgroup_lines(c->fd[CGROUP_CPU_STAT], st, cgroup_cpu_line);
+  st->memory = cgroup_value(c->fd[CGROUP_MEMORY_CURRENT]);
+  cgroup_lines(c->fd[CGROUP_MEMORY_STAT], st, cgroup_memory_line);
+  cgroup_lines(c->fd[CGROUP_IO_STAT], st, cgroup_io_line);
+  st->pids = cgroup_value(c->fd[CGROUP_PIDS_CURRENT]);
+  return 0;
+}
+
+void cgroup_close(cgroup_tree_t *t)
+{
+  int i;
+
+  for (i = 0; i < t->nb; i++)
+    if (t->cgroups[i].used)
+      cgroup_release(t, t->cgroups + i);
+  if (t->inotify_fd >= 0)
+    close(t->inotify_fd);
+  t->inotify_fd = -1;
+  free(t->cgroups);
+  t->cgroups = NULL;
+  t->nb = t->max = t->count = 0;
+  t->gen = 0;
+}
+
+/* "0::<path>" is the line of the cgroups v2 in /proc/self/cgroup */
+int cgroup_self_open(cgroup_self_t *cs)
+{
+  char buf[PATH_MAX], path[CGROUP_PATH_MAX + sizeof(CGROUP_DIR)], *p, *nl;
+  ssize_t n;
+  int fd;
+
+  cs->fd_stat = cs->fd_max = cs->fd_cpuset = -1;
+  cs->gen = selfstat_generation();
+  if ((fd = selfstat_open("/proc/self/cgroup", O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  n = selfstat_read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0)
+    return -1;
+  buf[n] = '\0';
+
+  for (p = buf; p && strncmp(p, "0::", 3); p = (nl = strchr(p, '\n')) ? nl + 1 : NULL)
+    ;
+  if (!p)
+    return -1;
+  p[3 + strcspn(p + 3, "\n")] = '\0';
+  snprintf(cs->path, sizeof(cs->path), "%s", p + 3);
+
+  /* the root of a namespace is the mount point */
+  snprintf(path, sizeof(path), CGROUP_DIR "%s", (strcmp(cs->path, "/")) ? cs->path : "");
+  if ((fd = selfstat_open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    return -1;
+  cs->fd_stat = selfstat_openat(fd, "cpu.stat", O_RDONLY | O_CLOEXEC);
+  cs->fd_max = selfstat_openat(fd, "cpu.max", O_RDONLY | O_CLOEXEC);
+  cs->fd_cpuset = selfstat_openat(fd, "cpuset.cpus.effective", O_RDONLY | O_CLOEXEC);
+  close(fd);
+  return (cs->fd_stat < 0) ? -1 : 0;
+}
+
+/* "<quota> <period>" or "max <period>" */
+static void cgroup_self_max(cgroup_self_t *cs)
+{
+  char buf[64], *p;
+  ssize_t n;
+
+  cs->quota_us = 0;
+  cs->period_us = 100000;
+  if (cs->fd_max < 0 || (n = selfstat_pread(cs->fd_max, buf, sizeof(buf) - 1, 0)) <= 0)
+    return;
+  buf[n] = '\0';
+  if (strncmp(buf, "max", 3))
+    cs->quota_us = strtoull(buf, NULL, 10);
+  if ((p = strchr(buf, ' ')))
+    cs->period_us = strtoull(p + 1, NULL, 10);
+  if (!cs->period_us)
+    cs->quota_us = 0;
+}
+
+/* list of ranges "0-3,8,10-11" */
+static void cgroup_self_cpuset(cgroup_self_t *cs)
+{
+  char buf[4096], *p;
+  long from, to;
+  ssize_t n;
+
+  memset(cs->cpus, 0, sizeof(cs->cpus));
+  cs->ncpus = 0;
+  if (cs->fd_cpuset < 0 || (n = selfstat_pread(cs->fd_cpuset, buf, sizeof(buf) - 1, 0)) <= 0)
+    return;
+  buf[n] = '\0';
+
+  for (p = buf; *p >= '0' && *p <= '9'; )
+  {
+    from = to = strtol(p, &p, 10);
+    if (*p == '-')
+      to = strtol(p + 1, &p, 10);
+    for (; from <= to && from < CGROUP_CPUS; from++)
+    {
+      cs->cpus[from / 64] |= 1ULL << (from % 64);
+      cs->ncpus++;
+    }
+    if (*p == ',')
+      p++;
+  }
+}
+
+int cgroup_self_limits(cgroup_self_t *cs)
+{
+  if (cs->gen != selfstat_generation())
+  {
+    cgroup_self_close(cs);
+    if (cgroup_self_open(cs) < 0)
+      return -1;
+  }
+  if (cs->fd_stat < 0)
+    return -1;
+  cgroup_self_max(cs);
+  cgroup_self_cpuset(cs);
+  return 0;
+}
+
+int cgroup_self_read(cgroup_self_t *cs, cgroup_stat_t *st)
+{
+  memset(st, 0, sizeof(*st));
+  if (cgroup_self_limits(cs) < 0)
+    return -1;
+  cgroup_lines(cs->fd_stat, st, cgroup_cpu_line);
+  return 0;
+}
+
+void cgroup_self_close(cgroup_self_t *cs)
+{
+  if (cs->fd_stat >= 0)
+    close(cs->fd_stat);
+  if (cs->fd_max >= 0)
+    close(cs->fd_max);
+  if (cs->fd_cpuset >= 0)
+    close(cs->fd_cpuset);
+  cs->fd_stat = cs->fd_max = cs->fd_cpuset = -1;
+}
@@ -0,0 +1,132 @@
+/* cgroup.h
+ *
+ * Resource usage of the cgroups v2 of Linux (/sys/fs/cgroup).
+ *
+ * The hierarchy is walked once down to a depth, each directory being opened
+ * with openat() relative to the fd of its parent. The files of a cgroup stay
+ * open and are read with pread at each collect. The directories above the
+ * depth are watched with inotify, so the new and removed cgroups are applied
+ * from the events instead of walking the tree again at each tick. It is only
+ * walked again on an overflow of the events or a new root. The daemon reads
+ * the events from its event loop as they come, the replay at each collect.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _CGROUP_H
+#define _CGROUP_H
+
+#include <inttypes.h>
+
+#define CGROUP_DIR "/sys/fs/cgroup"
+#define CGROUP_PATH_MAX 256
+#define CGROUP_DEPTH 2          /* default depth, the children of the root are 1 */
+#define CGROUP_CPUS 4096        /* cpus of a cpuset */
+
+enum CGROUP_FILE_e {
+  CGROUP_CPU_STAT = 0,
+  CGROUP_MEMORY_CURRENT = 1,
+  CGROUP_MEMORY_STAT = 2,
+  CGROUP_IO_STAT = 3,
+  CGROUP_PIDS_CURRENT = 4,
+  CGROUP_FILES = 5
+};
+
+typedef struct {
+  uint64_t usage_usec;  /* cpu.stat */
+  uint64_t user_usec;
+  uint64_t system_usec;
+  uint64_t nr_periods;
+  uint64_t nr_throttled;
+  uint64_t throttled_usec;
+  uint64_t memory;      /* memory.current in bytes */
+  uint64_t anon;        /* memory.stat */
+  uint64_t file;
+  uint64_t shmem;
+  uint64_t pgmajfault;
+  uint64_t rbytes;      /* io.stat, sum of the devices */
+  uint64_t wbytes;
+  uint64_t rios;
+  uint64_t wios;
+  uint64_t pids;        /* pids.current */
+} cgroup_stat_t;
+
+typedef struct {
+  char path[CGROUP_PATH_MAX];   /* under CGROUP_DIR, "" for the root */
+  int depth;
+  int used;             /* slot of a removed cgroup when 0 */
+  int stale;            /* not found yet by the current walk */
+  int listed;           /* children walked */
+  int seen;             /* read by a collect, the next one has rates */
+  int dirfd;            /* only kept above the depth */
+  int wd;               /* inotify watch, -1 at the depth */
+  int fd[CGROUP_FILES];
+  cgroup_stat_t data[2];
+} cgroup_t;
+
+typedef struct {
+  int depth;
+  int inotify_fd;
+  unsigned int gen;     /* root of the walk */
+  int rescan;           /* events lost, the tree is walked again */
+  int polled;           /* inotify_fd is read by an event loop, not by the refresh */
+  cgroup_t *cgroups;    /* by slot, grown and never shrunk */
+  int nb;               /* slots in use or free */
+  int max;
+  int count;            /* cgroups in use */
+} cgroup_tree_t;
+
+/* cgroup of jsonperfmon itself, its cpu quota and its cpuset */
+typedef struct {
+  char path[CGROUP_PATH_MAX];   /* as in /proc/self/cgroup, "/" in a cgroup namespace */
+  unsigned int gen;
+  int fd_stat;          /* cpu.stat */
+  int fd_max;           /* cpu.max */
+  int fd_cpuset;        /* cpuset.cpus.effective */
+  uint64_t quota_us;    /* 0 without quota (max) */
+  uint64_t period_us;
+  int ncpus;            /* 0 without cpuset, all the cpus are allowed */
+  uint64_t cpus[CGROUP_CPUS / 64];
+} cgroup_self_t;
+
+extern const char *cgroup_files[CGROUP_FILES];
+
+void cgroup_init(cgroup_tree_t *t, int depth);
+int  cgroup_open(cgroup_tree_t *t);
+/* applies the pending events of inotify, it walks the tree again if needed */
+int  cgroup_refresh(cgroup_tree_t *t);
+/* reads the events of inotify_fd once readable, the walks wait for the refresh */
+void cgroup_inotify(cgroup_tree_t *t);
+int  cgroup_read(cgroup_t *c, cgroup_stat_t *st);
+void cgroup_close(cgroup_tree_t *t);
+
+int  cgroup_self_open(cgroup_self_t *cs);
+/* the quota and the cpuset in cs as they may change */
+int  cgroup_self_limits(cgroup_self_t *cs);
+/* cpu.stat in st with the limits */
+int  cgroup_self_read(cgroup_self_t *cs, cgroup_stat_t *st);
+void cgroup_self_close(cgroup_self_t *cs);
+
+static inline int cgroup_self_cpu(const cgroup_self_t *cs, int cpu)
+{
+  return !cs->ncpus || (cpu >= 0 && cpu < CGROUP_CPUS && (cs->cpus[cpu / 64] >> (cpu % 64)) & 1);
+}
+
+#endif /* _CGROUP_H */
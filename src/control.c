@@ -0,0 +1,177 @@
+/* control.c
+ *
+ * Local control socket of the daemon.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "control.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static control_client_t *control_client(control_t *ctl, int fd)
+{
+  int i;
+  for (i = 0; i < CONTROL_CLIENTS_MAX; i++)
+    if (ctl->clients[i].fd == fd)
+      return ctl->clients + i;
+  return NULL;
+}
+
+static void control_drop(control_t *ctl, control_client_t *client)
+{
+  evloop_del(ctl->loop, client->fd);
+  close(client->fd);
+  client->fd = -1;
+}
+
+static void control_read(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  control_t *ctl = (control_t *)data;
+  control_client_t *client = control_client(ctl, fd);
+  ssize_t n;
+  char *nl;
+
+  (void)loop;
+  (void)events;
+  if (!client)
+    return;
+
+  n = read(fd, client->buf + client->len, sizeof(client->buf) - 1 - client->len);
+  if (n <= 0)
+  {
+    if (n < 0 && errno == EAGAIN)
+      return;
+    control_drop(ctl, client);
+    return;
+  }
+  client->len += (size_t)n;
+  client->buf[client->len] = '\0';
+
+  while (client->fd >= 0 && (nl = strchr(client->buf, '\n')))
+  {
+    *nl = '\0';
+    if (nl > client->buf && nl[-1] == '\r')
+      nl[-1] = '\0';
+    (*ctl->cb)(ctl, fd, client->buf, ctl->data);
+    client->len -= (size_t)(nl + 1 - client->buf);
+    memmove(client->buf, nl + 1, client->len + 1);
+  }
+
+  /* a line longer than the buffer */
+  if (client->fd >= 0 && client->len == sizeof(client->buf) - 1)
+    control_drop(ctl, client);
+}
+
+static void control_accept(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  control_t *ctl = (control_t *)data;
+  control_client_t *client = control_client(ctl, -1);
+  int cfd = accept(fd, NULL, NULL);
+
+  (void)events;
+  if (cfd < 0)
+    return;
+  if (!client || evloop_add(loop, cfd, POLLIN, control_read, ctl) < 0)
+  {
+    close(cfd);
+    return;
+  }
+  client->fd = cfd;
+  client->len = 0;
+}
+
+int control_open(control_t *ctl, evloop_t *loop, const char *path, control_cb_t cb, void *data)
+{
+  struct sockaddr_un addr;
+  int i;
+
+  memset(ctl, 0, sizeof(*ctl));
+  ctl->fd = -1;
+  for (i = 0; i < CONTROL_CLIENTS_MAX; i++)
+    ctl->clients[i].fd = -1;
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  /* a previous instance may have left the socket file */
+  unlink(path);
+  if ((ctl->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+      || bind(ctl->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+      || chmod(path, S_IRUSR | S_IWUSR) < 0
+      || listen(ctl->fd, CONTROL_CLIENTS_MAX) < 0
+      || evloop_add(loop, ctl->fd, POLLIN, control_accept, ctl) < 0)
+  {
+    if (ctl->fd >= 0)
+      close(ctl->fd);
+    ctl->fd = -1;
+    return -1;
+  }
+  ctl->path = strdup(path);
+  ctl->loop = loop;
+  ctl->cb = cb;
+  ctl->data = data;
+  return 0;
+}
+
+void control_close(control_t *ctl)
+{
+  int i;
+
+  if (ctl->fd < 0)
+    return;
+  for (i = 0; i < CONTROL_CLIENTS_MAX; i++)
+    if (ctl->clients[i].fd >= 0)
+      control_drop(ctl, ctl->clients + i);
+  evloop_del(ctl->loop, ctl->fd);
+  close(ctl->fd);
+  ctl->fd = -1;
+  unlink(ctl->path);
+  free(ctl->path);
+  ctl->path = NULL;
+}
+
+int control_reply(control_t *ctl, int fd, const char *str, size_t len)
+{
+  control_client_t *client = control_client(ctl, fd);
+
+  if (!client)
+    return -1;
+  if (send(fd, str, len, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)len
+      || (len && str[len - 1] != '\n' && send(fd, "\n", 1, MSG_DONTWAIT | MSG_NOSIGNAL) != 1))
+  {
+    control_drop(ctl, client);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+/* control.h
+ *
+ * Local control socket of the daemon.
+ *
+ * A unix stream socket accepting a few clients. The requests are lines of
+ * text, each one is given to the callback which answers with one json line
+ * through control_reply(). The commands themselves are in jsonperf.c.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _CONTROL_H
+#define _CONTROL_H
+
+#include <stddef.h>
+
+#include "evloop.h"
+
+#define CONTROL_CLIENTS_MAX 8
+#define CONTROL_LINE_MAX    512
+
+typedef struct control_s control_t;
+
+typedef void (*control_cb_t)(control_t *ctl, int fd, char *line, void *data);
+
+typedef struct {
+  int fd;               /* -1 for a free slot */
+  size_t len;
+  char buf[CONTROL_LINE_MAX];
+} control_client_t;
+
+struct control_s {
+  int fd;
+  char *path;
+  evloop_t *loop;
+  control_cb_t cb;
+  void *data;
+  control_client_t clients[CONTROL_CLIENTS_MAX];
+};
+
+int  control_open(control_t *ctl, evloop_t *loop, const char *path, control_cb_t cb, void *data);
+void control_close(control_t *ctl);
+
+/* the json is followed by a new line, a client too slow to read is dropped */
+int  control_reply(control_t *ctl, int fd, const char *str, size_t len);
+
+#endif /* _CONTROL_H */
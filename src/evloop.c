@@ -0,0 +1,317 @@
+/* evloop.c
+ *
+ * Single threaded event loop of the daemon.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef linux
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include "evloop.h"
+#include "scheduler.h"
+
+static evloop_handler_t *evloop_find(evloop_t *loop, int fd)
+{
+  int i;
+  for (i = 0; i < EVLOOP_FDS_MAX; i++)
+    if (loop->handlers[i].fd == fd)
+      return loop->handlers + i;
+  return NULL;
+}
+
+#ifdef linux
+/* the slot and its generation, an event of a removed fd is not delivered
+ * to the handler added in its slot by a previous callback of the batch */
+#define EVLOOP_DATA(loop, h) (((uint64_t)(h)->gen << 32) | (uint64_t)((h) - (loop)->handlers))
+
+static void evloop_timer_event(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  uint64_t expirations;
+
+  (void)data;
+  if (read(fd, &expirations, sizeof(expirations)) < 0)
+    return;
+  loop->deadline_ns = 0;
+  if (loop->timer_cb)
+    (*loop->timer_cb)(loop, -1, events, loop->timer_data);
+}
+
+static void evloop_signal_event(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  struct signalfd_siginfo si;
+
+  (void)data;
+  while (read(fd, &si, sizeof(si)) == sizeof(si))
+    if (si.ssi_signo < NSIG && loop->signal_cb[si.ssi_signo])
+      (*loop->signal_cb[si.ssi_signo])(loop, (int)si.ssi_signo, events, loop->signal_data[si.ssi_signo]);
+}
+#else
+static int evloop_pipe = -1;
+
+static void evloop_sighandler(int sig)
+{
+  unsigned char c = (unsigned char)sig;
+  int err = errno;
+  ssize_t r = write(evloop_pipe, &c, 1);
+  (void)r;
+  errno = err;
+}
+
+static void evloop_signal_event(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  unsigned char c;
+
+  while (read(fd, &c, 1) == 1)
+    if (c < NSIG && loop->signal_cb[c])
+      (*loop->signal_cb[c])(loop, (int)c, events, loop->signal_data[c]);
+}
+#endif
+
+int evloop_open(evloop_t *loop)
+{
+  int i;
+
+  memset(loop, 0, sizeof(*loop));
+  for (i = 0; i < EVLOOP_FDS_MAX; i++)
+    loop->handlers[i].fd = -1;
+  loop->epfd = loop->timerfd = loop->sigfd = loop->sigpipe = -1;
+  sigemptyset(&loop->sigmask);
+
+#ifdef linux
+  if ((loop->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0
+      || (loop->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) < 0
+      || (loop->sigfd = signalfd(-1, &loop->sigmask, SFD_CLOEXEC | SFD_NONBLOCK)) < 0
+      || evloop_add(loop, loop->timerfd, POLLIN, evloop_timer_event, NULL) < 0
+      || evloop_add(loop, loop->sigfd, POLLIN, evloop_signal_event, NULL) < 0)
+  {
+    evloop_close(loop);
+    return -1;
+  }
+#else
+  {
+    int fds[2];
+    if (pipe(fds) < 0)
+      return -1;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    loop->sigfd = fds[0];
+    loop->sigpipe = evloop_pipe = fds[1];
+    evloop_add(loop, loop->sigfd, POLLIN, evloop_signal_event, NULL);
+  }
+#endif
+  return 0;
+}
+
+void evloop_close(evloop_t *loop)
+{
+  if (loop->epfd >= 0)
+    close(loop->epfd);
+  if (loop->timerfd >= 0)
+    close(loop->timerfd);
+  if (loop->sigfd >= 0)
+    close(loop->sigfd);
+  if (loop->sigpipe >= 0)
+    close(loop->sigpipe);
+  loop->epfd = loop->timerfd = loop->sigfd = loop->sigpipe = -1;
+}
+
+int evloop_add(evloop_t *loop, int fd, uint32_t events, evloop_cb_t cb, void *data)
+{
+  evloop_handler_t *h = evloop_find(loop, -1);
+
+  if (fd < 0 || !h)
+    return -1;
+#ifdef linux
+  {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = EVLOOP_DATA(loop, h) + ((uint64_t)1 << 32);
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+      return -1;
+  }
+#endif
+  h->gen++;
+  h->fd = fd;
+  h->events = events;
+  h->cb = cb;
+  h->data = data;
+  return 0;
+}
+
+int evloop_mod(evloop_t *loop, int fd, uint32_t events)
+{
+  evloop_handler_t *h = evloop_find(loop, fd);
+
+  if (fd < 0 || !h)
+    return -1;
+#ifdef linux
+  {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = EVLOOP_DATA(loop, h);
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+      return -1;
+  }
+#endif
+  h->events = events;
+  return 0;
+}
+
+int evloop_del(evloop_t *loop, int fd)
+{
+  evloop_handler_t *h = evloop_find(loop, fd);
+
+  if (fd < 0 || !h)
+    return -1;
+#ifdef linux
+  epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+  h->fd = -1;
+  return 0;
+}
+
+void evloop_timer(evloop_t *loop, evloop_cb_t cb, void *data)
+{
+  loop->timer_cb = cb;
+  loop->timer_data = data;
+}
+
+int evloop_timer_set(evloop_t *loop, uint64_t deadline_ns)
+{
+  loop->deadline_ns = deadline_ns;
+#ifdef linux
+  {
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    /* a zero it_value would disarm the timer */
+    deadline_ns = (deadline_ns) ? deadline_ns : 1;
+    its.it_value.tv_sec = (time_t)(deadline_ns / SCHEDULER_NS_PER_SEC);
+    its.it_value.tv_nsec = (long)(deadline_ns % SCHEDULER_NS_PER_SEC);
+    return timerfd_settime(loop->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+  }
+#else
+  return 0;
+#endif
+}
+
+int evloop_signal(evloop_t *loop, int sig, evloop_cb_t cb, void *data)
+{
+  if (sig <= 0 || sig >= NSIG)
+    return -1;
+  loop->signal_cb[sig] = cb;
+  loop->signal_data[sig] = data;
+#ifdef linux
+  sigaddset(&loop->sigmask, sig);
+  if (sigprocmask(SIG_BLOCK, &loop->sigmask, NULL) < 0)
+    return -1;
+  return (signalfd(loop->sigfd, &loop->sigmask, 0) < 0) ? -1 : 0;
+#else
+  {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = evloop_sighandler;
+    sigemptyset(&sa.sa_mask);
+    return sigaction(sig, &sa, NULL);
+  }
+#endif
+}
+
+void evloop_stop(evloop_t *loop)
+{
+  loop->running = 0;
+}
+
+#ifdef linux
+static int evloop_wait(evloop_t *loop)
+{
+  struct epoll_event events[16];
+  int i, n = epoll_wait(loop->epfd, events, 16, -1);
+
+  if (n < 0)
+    return (errno == EINTR) ? 0 : -1;
+
+  for (i = 0; i < n && loop->running; i++)
+  {
+    evloop_handler_t *h = loop->handlers + (uint32_t)events[i].data.u64;
+    /* the handler may have been removed or replaced by a previous callback */
+    if (h->fd >= 0 && h->gen == (uint32_t)(events[i].data.u64 >> 32))
+      (*h->cb)(loop, h->fd, events[i].events, h->data);
+  }
+  return 0;
+}
+#else
+static int evloop_wait(evloop_t *loop)
+{
+  struct pollfd fds[EVLOOP_FDS_MAX];
+  evloop_handler_t *handlers[EVLOOP_FDS_MAX];
+  int i, n = 0, timeout = -1;
+
+  for (i = 0; i < EVLOOP_FDS_MAX; i++)
+    if (loop->handlers[i].fd >= 0)
+    {
+      fds[n].fd = loop->handlers[i].fd;
+      fds[n].events = (short)loop->handlers[i].events;
+      fds[n].revents = 0;
+      handlers[n++] = loop->handlers + i;
+    }
+
+  if (loop->deadline_ns)
+  {
+    uint64_t now = scheduler_clock();
+    timeout = (loop->deadline_ns > now) ? (int)((loop->deadline_ns - now + 999999) / 1000000) : 0;
+  }
+
+  if (poll(fds, (nfds_t)n, timeout) < 0)
+    return (errno == EINTR) ? 0 : -1;
+
+  for (i = 0; i < n && loop->running; i++)
+    if (fds[i].revents && handlers[i]->fd == fds[i].fd)
+      (*handlers[i]->cb)(loop, fds[i].fd, (uint32_t)fds[i].revents, handlers[i]->data);
+
+  if (loop->running && loop->deadline_ns && scheduler_clock() >= loop->deadline_ns)
+  {
+    loop->deadline_ns = 0;
+    if (loop->timer_cb)
+      (*loop->timer_cb)(loop, -1, 0, loop->timer_data);
+  }
+  return 0;
+}
+#endif
+
+int evloop_run(evloop_t *loop)
+{
+  loop->running = 1;
+  while (loop->running)
+    if (evloop_wait(loop) < 0)
+      return -1;
+  return 0;
+}
@@ -0,0 +1,89 @@
+/* evloop.h
+ *
+ * Single threaded event loop of the daemon.
+ *
+ * It multiplexes the fds of the daemon (PSI triggers, control socket,
+ * inotify...), one timer on CLOCK_MONOTONIC and the signals. On Linux it
+ * relies on epoll, a timerfd and a signalfd so the signals are handled as
+ * any other event outside of any signal handler. Elsewhere it falls back on
+ * poll() with a timeout and a self pipe written by the signal handlers.
+ *
+ * The events are the poll() flags (POLLIN, POLLPRI, POLLOUT), they have the
+ * same values as the epoll ones.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _EVLOOP_H
+#define _EVLOOP_H
+
+#include <inttypes.h>
+#include <signal.h>
+#include <poll.h>
+
+#define EVLOOP_FDS_MAX 64
+
+typedef struct evloop_s evloop_t;
+
+/* fd is the signal number for the signal callbacks and -1 for the timer */
+typedef void (*evloop_cb_t)(evloop_t *loop, int fd, uint32_t events, void *data);
+
+typedef struct {
+  int fd;               /* -1 for a free slot */
+  uint32_t gen;         /* of the slot, bumped at each add */
+  uint32_t events;
+  evloop_cb_t cb;
+  void *data;
+} evloop_handler_t;
+
+struct evloop_s {
+  int running;
+  int epfd;             /* -1 with poll() */
+  int timerfd;
+  uint64_t deadline_ns; /* monotonic deadline of the timer, 0 if disarmed */
+  evloop_cb_t timer_cb;
+  void *timer_data;
+  int sigfd;            /* signalfd or read end of the self pipe */
+  int sigpipe;          /* write end of the self pipe */
+  sigset_t sigmask;
+  evloop_cb_t signal_cb[NSIG];
+  void *signal_data[NSIG];
+  evloop_handler_t handlers[EVLOOP_FDS_MAX];
+};
+
+int  evloop_open(evloop_t *loop);
+void evloop_close(evloop_t *loop);
+
+int  evloop_add(evloop_t *loop, int fd, uint32_t events, evloop_cb_t cb, void *data);
+int  evloop_mod(evloop_t *loop, int fd, uint32_t events);
+int  evloop_del(evloop_t *loop, int fd);
+
+/* a single timer, rearmed by its callback */
+void evloop_timer(evloop_t *loop, evloop_cb_t cb, void *data);
+int  evloop_timer_set(evloop_t *loop, uint64_t deadline_ns);
+
+/* the signal is blocked and delivered to cb by the loop */
+int  evloop_signal(evloop_t *loop, int sig, evloop_cb_t cb, void *data);
+
+/* dispatches the events until evloop_stop() */
+int  evloop_run(evloop_t *loop);
+void evloop_stop(evloop_t *loop);
+
+#endif /* _EVLOOP_H */
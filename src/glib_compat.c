@@ -20,6 +20,13 @@ size_t safe_strlen(const char *str)
         return end - str;
 }
 
+/* the size doubles so a json of several MB is not copied at each 512 bytes */
+static inline size_t grown_len(GString *string, size_t required)
+{
+  size_t new_len = string->len + required + 512;
+  return (new_len < 2 * string->allocated_len) ? 2 * string->allocated_len : new_len;
+}
+
 void *g_new0(size_t  dfl_size)
 {
   void *temp = malloc(dfl_size);
@@ -59,7 +66,7 @@ void g_string_append_printf(GString *string, const char *format, ...)
   fprintf(stderr, "g_string_append_printf 1 str=%p, len=%lu, allocated_len=%lu, required=%lu\n", string->str, string->len, string->allocated_len, required );
   if ( (string->len + required) >= string->allocated_len)
   {
-    size_t new_len  = string->len + required + 512; /* required includes null terminated char */
+    size_t new_len  = grown_len(string, required); /* required includes null terminated char */
     char *tmp = (char*)malloc(new_len + 1);
     if (tmp) /* check "out of memory" */
     {
@@ -94,7 +101,7 @@ GString* g_string_append(GString *string, const char *val)
   fprintf(stderr, "g_string_append        1 str=%p, len=%lu, allocated_len=%lu, required=%lu\n", string->str, string->len, string->allocated_len, required );
   if ( (string->len + required) >= string->allocated_len)
   {
-    size_t new_len  = string->len + required + 512;
+    size_t new_len  = grown_len(string, required);
     char *tmp = (char*)malloc(new_len + 1);
     if (tmp) /* check "out of memory" */
     {
@@ -118,6 +125,52 @@ GString* g_string_append(GString *string, const char *val)
   return string;
 }
 
+GString* g_string_append_len(GString *string, const char *val, size_t required)
+{
+  if ( (string->len + required) >= string->allocated_len)
+  {
+    size_t new_len  = grown_len(string, required);
+    char *tmp = (char*)malloc(new_len + 1);
+    if (!tmp) /* check "out of memory" */
+      return string;
+    memcpy(tmp, string->str, string->len+1);
+    free(string->str);
+    string->str = tmp;
+    string->allocated_len = new_len;
+  }
+  memcpy( string->str + string->len, val, required );
+  string->len += required;
+  string->str[string->len] = '\0';
+  return string;
+}
+
+GString* g_string_truncate(GString *string, size_t len)
+{
+  if (len < string->len)
+  {
+    string->len = len;
+    string->str[len] = '\0';
+  }
+  return string;
+}
+
+GString* g_string_set_size(GString *string, size_t len)
+{
+  if (len >= string->allocated_len)
+  {
+    char *tmp = (char*)malloc(len + 1);
+    if (!tmp) /* check "out of memory" */
+      return string;
+    memcpy(tmp, string->str, string->len+1);
+    free(string->str);
+    string->str = tmp;
+    string->allocated_len = len;
+  }
+  string->len = len;
+  string->str[len] = '\0';
+  return string;
+}
+
 GString* g_string_assign(GString *string, const char *val)
 {
   size_t required = safe_strlen(val);
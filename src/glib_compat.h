@@ -18,6 +18,9 @@ void *g_new0(size_t  dfl_size);
 GString* g_string_sized_new     (size_t  dfl_size);
 void     g_string_append_printf (GString *string, const char *format, ...)  __attribute__((format(printf, 2, 0)));
 GString* g_string_append        (GString *string, const char *val);
+GString* g_string_append_len    (GString *string, const char *val, size_t len);
+GString* g_string_truncate      (GString *string, size_t len);
+GString* g_string_set_size      (GString *string, size_t len);
 GString* g_string_assign        (GString *string, const char *val);
 char*    g_string_free          (GString   *string, int free_segment);
 
@@ -0,0 +1,459 @@
+/* history.c
+ *
+ * Columnar history store of the produced json.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "history.h"
+#include "jsonscan.h"
+
+struct history_s {
+  char dir[PATH_MAX];
+  char host[64];
+  uint64_t keep_ms;
+  uint64_t keep_bytes;
+
+  /* current segment */
+  int fd;
+  void *map;
+  size_t len;
+  history_header_t *hdr;
+  int64_t *times;
+  char *columns;
+  uint8_t *types;        /* history_type_e of the columns */
+  uint32_t nfields;
+  uint32_t fields_max;
+
+  /* name => column, open addressing, value is column+1 */
+  uint32_t *hash;
+  uint32_t hashmask;
+  uint32_t hint;
+
+  /* row being built */
+  int64_t row_ms;
+  double *row;
+  uint32_t row_alloc;
+  char (*pending)[HISTORY_NAME_MAX];
+  double *pending_values;
+  uint8_t *pending_types;
+  uint32_t npending;
+  uint32_t pending_alloc;
+  uint32_t nset;
+};
+
+/******************************************************************************************************************
+ * reader
+ *****************************************************************************************************************/
+
+int history_segment_map(history_segment_t *seg, const char *path)
+{
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+
+  seg->map = NULL;
+  if (fd < 0)
+    return -1;
+
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(history_header_t))
+  {
+    close(fd);
+    return -1;
+  }
+
+  seg->len = (size_t)st.st_size;
+  seg->map = mmap(NULL, seg->len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (seg->map == MAP_FAILED)
+  {
+    seg->map = NULL;
+    return -1;
+  }
+
+  seg->hdr = (const history_header_t *)seg->map;
+  if (memcmp(seg->hdr->magic, HISTORY_MAGIC, sizeof(seg->hdr->magic))
+      || seg->len < HISTORY_SIZE(seg->hdr->fields_max, seg->hdr->capacity)
+      || seg->hdr->count > seg->hdr->capacity || seg->hdr->nfields > seg->hdr->fields_max)
+  {
+    history_segment_unmap(seg);
+    return -1;
+  }
+  seg->times = (const int64_t *)((const char *)seg->map + HISTORY_TIMES_OFFSET(seg->hdr->fields_max));
+  return 0;
+}
+
+void history_segment_unmap(history_segment_t *seg)
+{
+  if (seg->map)
+    munmap(seg->map, seg->len);
+  seg->map = NULL;
+}
+
+uint32_t history_segment_lower_bound(const history_segment_t *seg, int64_t ms)
+{
+  uint32_t lo = 0, hi = seg->hdr->count;
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (seg->times[mid] < ms)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+int history_segment_filter(const struct dirent *dent)
+{
+  size_t l = strlen(dent->d_name);
+  return l > sizeof(HISTORY_SUFFIX) && !strcmp(dent->d_name + l - sizeof(HISTORY_SUFFIX) + 1, HISTORY_SUFFIX);
+}
+
+/******************************************************************************************************************
+ * writer
+ *****************************************************************************************************************/
+
+#define HISTORY_ENTRY(h, i) ((history_column_t *)((char *)(h)->map + HISTORY_NAMES_OFFSET) + (i))
+
+static int history_lookup(history_t *h, const char *name)
+{
+  uint32_t i;
+
+  if (h->hint < h->nfields && !strcmp(name, HISTORY_ENTRY(h, h->hint)->name))
+    return (int)h->hint++;
+
+  if (!h->hash)
+    return -1;
+
+  for (i = jsonscan_hash(name, strlen(name)) & h->hashmask; h->hash[i]; i = (i + 1) & h->hashmask)
+  {
+    uint32_t col = h->hash[i] - 1;
+    if (!strcmp(name, HISTORY_ENTRY(h, col)->name))
+    {
+      h->hint = col + 1;
+      return (int)col;
+    }
+  }
+  return -1;
+}
+
+static void history_hash_insert(history_t *h, uint32_t col)
+{
+  const char *name = HISTORY_ENTRY(h, col)->name;
+  uint32_t i;
+
+  for (i = jsonscan_hash(name, strlen(name)) & h->hashmask; h->hash[i]; i = (i + 1) & h->hashmask)
+    ;
+  h->hash[i] = col + 1;
+}
+
+static void history_unmap(history_t *h)
+{
+  if (h->map)
+  {
+    munmap(h->map, h->len);
+    close(h->fd);
+  }
+  h->map = NULL;
+  h->hdr = NULL;
+  h->nfields = 0;
+}
+
+/* From the newest segment, the current one, just created by the name of
+ * the row time, is always kept. A segment is
+ * older than the age when its last row is, the size is the one used on the
+ * disk as the segments are sparse.
+ */
+static void history_retain(history_t *h)
+{
+  char path[PATH_MAX + 256], current[32];
+  struct dirent **dents;
+  history_header_t hdr;
+  struct stat st;
+  uint64_t total = 0;
+  int i, n, fd;
+
+  if ((!h->keep_ms && !h->keep_bytes) || (n = scandir(h->dir, &dents, history_segment_filter, alphasort)) < 0)
+    return;
+
+  snprintf(current, sizeof(current), "%013" PRId64 HISTORY_SUFFIX, h->row_ms);
+  for (i = n - 1; i >= 0; i--)
+  {
+    int keep = !strcmp(dents[i]->d_name, current);
+
+    snprintf(path, sizeof(path), "%s/%s", h->dir, dents[i]->d_name);
+    free(dents[i]);
+    if ((fd = open(path, O_RDONLY)) < 0)
+      continue;
+    if (fstat(fd, &st) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+      hdr.last_ms = INT64_MAX;
+    close(fd);
+    total += (uint64_t)st.st_blocks * 512;
+    if (!keep && ((h->keep_ms && hdr.last_ms < h->row_ms - (int64_t)h->keep_ms)
+                      || (h->keep_bytes && total > h->keep_bytes)))
+      unlink(path);
+  }
+  free(dents);
+}
+
+/* Create a segment with the columns of the current one, its directory has
+ * room for twice the columns and the pending names. The kept columns keep
+ * their indexes so the row is still valid.
+ */
+static int history_segment_create(history_t *h)
+{
+  char path[PATH_MAX + 32];
+  uint32_t i, nfields = h->nfields, fields_max;
+  uint32_t *hash;
+  size_t len;
+  int fd;
+  void *map;
+
+  for (fields_max = HISTORY_FIELDS; fields_max < 2*(nfields + h->npending); fields_max <<= 1)
+    ;
+
+  if (fields_max > h->row_alloc)
+  {
+    double *row = (double *)realloc(h->row, fields_max*sizeof(double));
+    uint8_t *types;
+    if (!row)
+      return -1;
+    h->row = row;
+    if (!(types = (uint8_t *)realloc(h->types, fields_max)))
+      return -1;
+    h->types = types;
+    h->row_alloc = fields_max;
+  }
+  if (!(hash = (uint32_t *)calloc(2*fields_max, sizeof(uint32_t))))
+    return -1;
+
+  snprintf(path, sizeof(path), "%s/%013" PRId64 HISTORY_SUFFIX, h->dir, h->row_ms);
+  len = HISTORY_SIZE(fields_max, HISTORY_ROWS);
+
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, (off_t)len)
+      || (map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    if (fd >= 0)
+      close(fd);
+    free(hash);
+    return -1;
+  }
+
+  /* the kept columns start at the first row */
+  for (i = 0; i < nfields; i++)
+  {
+    history_column_t *entry = (history_column_t *)((char *)map + HISTORY_NAMES_OFFSET) + i;
+    memcpy(entry->name, HISTORY_ENTRY(h, i)->name, HISTORY_NAME_MAX);
+    entry->type = h->types[i];
+  }
+
+  history_unmap(h);
+  free(h->hash);
+
+  h->fd = fd;
+  h->map = map;
+  h->len = len;
+  h->hdr = (history_header_t *)map;
+  memcpy(h->hdr->magic, HISTORY_MAGIC, sizeof(h->hdr->magic));
+  h->hdr->nfields = nfields;
+  h->hdr->capacity = HISTORY_ROWS;
+  h->hdr->count = 0;
+  h->hdr->fields_max = fields_max;
+  strncpy(h->hdr->host, h->host, sizeof(h->hdr->host) - 1);
+  h->times = (int64_t *)((char *)map + HISTORY_TIMES_OFFSET(fields_max));
+  h->columns = (char *)map + HISTORY_COLUMN_OFFSET(fields_max, HISTORY_ROWS, 0);
+  h->nfields = nfields;
+  h->fields_max = fields_max;
+  h->hash = hash;
+  h->hashmask = 2*fields_max - 1;
+  h->hint = 0;
+  for (i = 0; i < nfields; i++)
+    history_hash_insert(h, i);
+  history_retain(h);
+  return 0;
+}
+
+/* The pending names take the next slots of the directory from the current
+ * row, the earlier rows of these columns are missing.
+ */
+static void history_columns_add(history_t *h)
+{
+  uint32_t j;
+  int col;
+
+  for (j = 0; j < h->npending; j++)
+  {
+    if ((col = history_lookup(h, h->pending[j])) < 0)
+    {
+      history_column_t *entry = HISTORY_ENTRY(h, h->nfields);
+
+      strncpy(entry->name, h->pending[j], HISTORY_NAME_MAX);
+      entry->first = h->hdr->count;
+      entry->type = h->types[h->nfields] = h->pending_types[j];
+      history_hash_insert(h, h->nfields);
+      col = (int)h->nfields++;
+      h->hdr->nfields = h->nfields;
+    }
+    h->row[col] = h->pending_values[j];
+  }
+  h->npending = 0;
+}
+
+static int history_field(const jsonscan_field_t *field, void *data)
+{
+  history_t *h = (history_t *)data;
+  double v = strtod(field->value, NULL);
+  int col;
+
+  /* the timestamp is the time index itself */
+  if (field->lpath >= HISTORY_NAME_MAX || !strcmp(field->path, "timestamp"))
+    return 0;
+
+  h->nset++;
+  if ((col = history_lookup(h, field->path)) >= 0)
+  {
+    h->row[col] = v;
+    return 0;
+  }
+
+  if (h->npending == h->pending_alloc)
+  {
+    uint32_t n = h->pending_alloc ? 2*h->pending_alloc : 256;
+    char (*pending)[HISTORY_NAME_MAX] = (char (*)[HISTORY_NAME_MAX])realloc(h->pending, (size_t)n*HISTORY_NAME_MAX);
+    double *values;
+    uint8_t *types;
+    if (!pending)
+      return 1;
+    h->pending = pending;
+    if (!(values = (double *)realloc(h->pending_values, n*sizeof(double))))
+      return 1;
+    h->pending_values = values;
+    if (!(types = (uint8_t *)realloc(h->pending_types, n)))
+      return 1;
+    h->pending_types = types;
+    h->pending_alloc = n;
+  }
+  memcpy(h->pending[h->npending], field->path, field->lpath + 1);
+  /* the type of a new column comes from the value as printed */
+  h->pending_types[h->npending] = (memchr(field->value, '.', field->lvalue) || memchr(field->value, 'e', field->lvalue))
+                                  ? HISTORY_FLOAT : HISTORY_DOUBLE;
+  h->pending_values[h->npending++] = v;
+  return 0;
+}
+
+history_t *history_open(const char *dir, const char *host)
+{
+  history_t *h = (history_t *)calloc(1, sizeof(history_t));
+
+  if (!h)
+    return NULL;
+
+  if (mkdir(dir, 0755) && access(dir, W_OK))
+  {
+    free(h);
+    return NULL;
+  }
+  strncpy(h->dir, dir, sizeof(h->dir) - 1);
+  strncpy(h->host, host, sizeof(h->host) - 1);
+  h->fd = -1;
+  return h;
+}
+
+void history_retention(history_t *h, uint64_t age_ms, uint64_t bytes)
+{
+  h->keep_ms = age_ms;
+  h->keep_bytes = bytes;
+}
+
+void history_row_begin(history_t *h, int64_t ms)
+{
+  uint32_t i;
+
+  h->row_ms = ms;
+  h->npending = 0;
+  h->nset = 0;
+  h->hint = 0;
+  for (i = 0; i < h->nfields; i++)
+    h->row[i] = NAN;
+}
+
+void history_row_json(history_t *h, const char *json, size_t len)
+{
+  jsonscan(json, len, history_field, h);
+}
+
+int history_row_commit(history_t *h)
+{
+  uint32_t i, count;
+
+  /* nothing produced in this period, the time index must stay sorted */
+  if (!h->nset || (h->hdr && h->hdr->count && h->row_ms <= h->hdr->last_ms))
+    return 0;
+
+  /* a new segment only when the current one is full */
+  if (!h->hdr || h->hdr->count == h->hdr->capacity || h->nfields + h->npending > h->fields_max)
+    if (history_segment_create(h))
+      return -1;
+  history_columns_add(h);
+
+  count = h->hdr->count;
+  h->times[count] = h->row_ms;
+  for (i = 0; i < h->nfields; i++)
+  {
+    char *col = h->columns + (size_t)i*HISTORY_ROWS*sizeof(double);
+    if (h->types[i] == HISTORY_DOUBLE)
+      ((double *)col)[count] = h->row[i];
+    else
+      ((float *)col)[count] = (float)h->row[i];
+  }
+
+  if (!count)
+    h->hdr->first_ms = h->row_ms;
+  h->hdr->last_ms = h->row_ms;
+  h->hdr->count = count + 1;
+  return 0;
+}
+
+void history_close(history_t *h)
+{
+  if (!h)
+    return;
+  history_unmap(h);
+  free(h->hash);
+  free(h->row);
+  free(h->pending);
+  free(h->pending_values);
+  free(h->pending_types);
+  free(h->types);
+  free(h);
+}
@@ -0,0 +1,105 @@
+/* history.h
+ *
+ * Columnar history store of the produced json.
+ *
+ * Each segment is a sparse file preallocated for HISTORY_ROWS samples. It
+ * holds a header, the column directory (the field name, the dotted json path,
+ * its type and the first row of the column), the time index in milliseconds
+ * then one column per directory slot. The integers as printed, the counters,
+ * are doubles so they stay exact up to 2^53, the others, the gauges with
+ * decimals, are floats in the first half of their slot. A new field takes the next slot of the
+ * directory, its rows before the first one are missing as a NaN is. The
+ * segment is only closed when its rows or its directory are full. As the time
+ * index is sorted and the columns are contiguous, the query tool only has to
+ * map the file, binary search the time range and scan the slices.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <dirent.h>
+
+#define HISTORY_MAGIC    "JPMHIST3"
+#define HISTORY_SUFFIX   ".jph"
+#define HISTORY_NAME_MAX 128
+#define HISTORY_ROWS     3600 /* one hour at one second, multiple of 16 */
+#define HISTORY_FIELDS   4096 /* directory slots of a segment, doubled when too short */
+#define HISTORY_ALIGN(x) (((x) + 63) & ~((size_t)63))
+
+typedef struct {
+  char     magic[8];
+  uint32_t nfields;      /* used slots of the directory */
+  uint32_t capacity;
+  uint32_t count;        /* rows written so far */
+  uint32_t fields_max;   /* slots of the directory */
+  int64_t  first_ms;
+  int64_t  last_ms;
+  char     host[64];
+} history_header_t;
+
+typedef enum { HISTORY_FLOAT, HISTORY_DOUBLE } history_type_e;
+
+typedef struct {
+  char     name[HISTORY_NAME_MAX];
+  uint32_t first;        /* row of the first value */
+  uint32_t type;         /* history_type_e */
+} history_column_t;
+
+/* n is the number of slots of the directory, c the capacity in rows */
+#define HISTORY_NAMES_OFFSET     HISTORY_ALIGN(sizeof(history_header_t))
+#define HISTORY_TIMES_OFFSET(n)  HISTORY_ALIGN(HISTORY_NAMES_OFFSET + (size_t)(n)*sizeof(history_column_t))
+#define HISTORY_COLUMN_OFFSET(n, c, i) (HISTORY_TIMES_OFFSET(n) + (size_t)(c)*sizeof(int64_t) + (size_t)(i)*(c)*sizeof(double))
+#define HISTORY_SIZE(n, c)       HISTORY_COLUMN_OFFSET(n, c, n)
+
+/* read only view of a segment */
+typedef struct {
+  void *map;
+  size_t len;
+  const history_header_t *hdr;
+  const int64_t *times;
+} history_segment_t;
+
+#define HISTORY_DIR(s, i)    ((const history_column_t *)((const char *)(s)->map + HISTORY_NAMES_OFFSET) + (i))
+#define HISTORY_NAME(s, i)   (HISTORY_DIR(s, i)->name)
+#define HISTORY_COLUMN(s, i) ((const void *)((const char *)(s)->map + HISTORY_COLUMN_OFFSET((s)->hdr->fields_max, (s)->hdr->capacity, i)))
+
+int  history_segment_map(history_segment_t *seg, const char *path);
+void history_segment_unmap(history_segment_t *seg);
+/* first row with a time >= ms */
+uint32_t history_segment_lower_bound(const history_segment_t *seg, int64_t ms);
+/* scandir filter of the segment files, sorted by time with alphasort */
+int history_segment_filter(const struct dirent *dent);
+
+/* writer used by the daemon */
+typedef struct history_s history_t;
+
+history_t *history_open(const char *dir, const char *host);
+/* the oldest segments beyond an age or a total size (0 no limit) are removed */
+void history_retention(history_t *h, uint64_t age_ms, uint64_t bytes);
+void history_row_begin(history_t *h, int64_t ms);
+void history_row_json(history_t *h, const char *json, size_t len);
+int  history_row_commit(history_t *h);
+void history_close(history_t *h);
+
+#endif /* _HISTORY_H */
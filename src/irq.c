@@ -0,0 +1,258 @@
+/* irq.c
+ *
+ * Interrupts and softirqs of Linux per cpu (/proc/interrupts, /proc/softirqs).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "irq.h"
+#include "selfstat.h"
+
+#define IRQ_BUF_MIN 65536
+#define IRQ_ROWS_MIN 64
+
+void irq_init(irq_table_t *t, const char *path)
+{
+  memset(t, 0, sizeof(*t));
+  t->path = path;
+  t->fd = -1;
+}
+
+int irq_open(irq_table_t *t)
+{
+  t->gen = selfstat_generation();
+  t->fd = selfstat_open(t->path, O_RDONLY | O_CLOEXEC);
+  return (t->fd < 0) ? -1 : 0;
+}
+
+/* new number of rows or of columns, the counters of the rows kept */
+static int irq_resize(irq_table_t *t, int maxrows, int ncpus)
+{
+  size_t cells = (size_t)maxrows * ncpus;
+  void *p;
+  int i;
+
+  if (ncpus != t->ncpus)
+  {
+    if ((p = realloc(t->cpus, ncpus * sizeof(int))) == NULL)
+      return -1;
+    t->cpus = p;
+    if ((p = realloc(t->cpu_delta, ncpus * sizeof(uint64_t))) == NULL)
+      return -1;
+    t->cpu_delta = p;
+  }
+  if (maxrows != t->maxrows)
+  {
+    if ((p = realloc(t->rows, maxrows * sizeof(irq_row_t))) == NULL)
+      return -1;
+    t->rows = p;
+    if ((p = realloc(t->row_delta, maxrows * sizeof(uint64_t))) == NULL)
+      return -1;
+    t->row_delta = p;
+  }
+  for (i = 0; i < 2; i++)
+  {
+    if ((p = realloc(t->counts[i], cells * sizeof(uint32_t))) == NULL)
+      return -1;
+    t->counts[i] = p;
+  }
+  t->maxrows = maxrows;
+  t->ncpus = ncpus;
+  return 0;
+}
+
+/* "           CPU0       CPU1 ...", 1 when the columns changed */
+static int irq_header(irq_table_t *t, char **line)
+{
+  char *p, *nl;
+  int n = 0, c, changed;
+
+  if ((nl = strchr(*line, '\n')) == NULL)
+    return -1;
+  for (p = *line; (p = strstr(p, "CPU")) && p < nl; p += 3)
+    n++;
+  if (!n)
+    return -1;
+
+  changed = (n != t->ncpus);
+  if (changed && irq_resize(t, (t->maxrows) ? t->maxrows : IRQ_ROWS_MIN, n) < 0)
+    return -1;
+  for (p = *line, c = 0; c < n && (p = strstr(p, "CPU")); c++)
+  {
+    int cpu = (int)strtol(p + 3, &p, 10);
+    changed |= (t->cpus[c] != cpu);
+    t->cpus[c] = cpu;
+  }
+  *line = nl + 1;
+  return changed;
+}
+
+/* the rest of the line, the blanks squeezed and the json quotes replaced */
+static char *irq_desc(char *d, char *p)
+{
+  char *e = d + IRQ_DESC_MAX - 1, *s = d;
+
+  for (; *p && *p != '\n' && d < e; p++)
+    if (*p != ' ' && *p != '\t')
+      *d++ = (*p == '"' || *p == '\\') ? '_' : *p;
+    else if (d > s && d[-1] != ' ')
+      *d++ = ' ';
+  if (d > s && d[-1] == ' ')
+    d--;
+  *d = '\0';
+  while (*p && *p != '\n')
+    p++;
+  return p;
+}
+
+int irq_read(irq_table_t *t)
+{
+  int next = 1 - t->odd, reset, r, c;
+  char *p, *name;
+
+  if (t->gen != selfstat_generation())
+  {
+    if (t->fd >= 0)
+      close(t->fd);
+    if (irq_open(t) < 0)
+      return -1;
+  }
+  if (t->fd < 0 || selfstat_pread_all(t->fd, &t->buf, &t->size, IRQ_BUF_MIN) <= 0)
+    return -1;
+  p = t->buf;
+  if ((reset = irq_header(t, &p)) < 0)
+    return -1;
+
+  for (r = 0; *p; r++)
+  {
+    uint32_t *cell, v;
+    int fresh;
+
+    while (*p == ' ')
+      p++;
+    for (name = p; *p && *p != ':' && *p != '\n'; p++)
+      ;
+    if (*p != ':')
+    {
+      r--;
+      p += (*p == '\n');
+      continue;
+    }
+    *p++ = '\0';
+
+    if (r == t->maxrows && irq_resize(t, t->maxrows * 2, t->ncpus) < 0)
+      return -1;
+    cell = t->counts[next] + (size_t)r * t->ncpus;
+
+    /* the columns are digits after blanks, the missing ones are 0 (ERR, MIS) */
+    for (c = 0; c < t->ncpus; c++)
+    {
+      while (*p == ' ')
+        p++;
+      if (*p < '0' || *p > '9')
+        break;
+      for (v = 0; *p >= '0' && *p <= '9'; p++)
+        v = v * 10 + (*p - '0');
+      cell[c] = v;
+    }
+    for (; c < t->ncpus; c++)
+      cell[c] = 0;
+
+    /* a new row or a row whose name changed has no delta until the next read */
+    fresh = (r >= t->nrows || strncmp(t->rows[r].name, name, IRQ_NAME_MAX - 1));
+    if (fresh)
+    {
+      irq_row_t *row = t->rows + r;
+
+      snprintf(row->name, sizeof(row->name), "%s", name);
+      row->device = (*name >= '0' && *name <= '9');
+      p = irq_desc(row->desc, p);
+      if (!reset)
+        memcpy(t->counts[t->odd] + (size_t)r * t->ncpus, cell, t->ncpus * sizeof(uint32_t));
+    }
+    else
+      while (*p && *p != '\n')
+        p++;
+    p += (*p == '\n');
+  }
+  t->nrows = r;
+  if (reset)
+    memcpy(t->counts[t->odd], t->counts[next], (size_t)r * t->ncpus * sizeof(uint32_t));
+  t->odd = next;
+  return 0;
+}
+
+void irq_delta(irq_table_t *t, int devices)
+{
+  const uint32_t *restrict curr = t->counts[t->odd], *restrict prev = t->counts[1 - t->odd];
+  uint64_t *restrict cpu = t->cpu_delta;
+  int n = t->ncpus, r, c;
+
+  memset(cpu, 0, n * sizeof(uint64_t));
+  for (r = 0; r < t->nrows; r++, curr += n, prev += n)
+  {
+    uint64_t sum = 0;
+
+    if (devices && !t->rows[r].device)
+    {
+      t->row_delta[r] = 0;
+      continue;
+    }
+    for (c = 0; c < n; c++)
+    {
+      uint32_t d = curr[c] - prev[c];
+      cpu[c] += d;
+      sum += d;
+    }
+    t->row_delta[r] = sum;
+  }
+}
+
+int irq_find(const irq_table_t *t, const char *name)
+{
+  int r;
+
+  for (r = 0; r < t->nrows; r++)
+    if (!strcmp(t->rows[r].name, name))
+      return r;
+  return -1;
+}
+
+void irq_close(irq_table_t *t)
+{
+  const char *path = t->path;
+
+  if (t->fd >= 0)
+    close(t->fd);
+  free(t->buf);
+  free(t->cpus);
+  free(t->rows);
+  free(t->counts[0]);
+  free(t->counts[1]);
+  free(t->row_delta);
+  free(t->cpu_delta);
+  irq_init(t, path);
+}
@@ -0,0 +1,79 @@
+/* irq.h
+ *
+ * Interrupts and softirqs of Linux per cpu (/proc/interrupts, /proc/softirqs).
+ *
+ * Both files are a matrix of counters, a line per irq and a column per cpu.
+ * The file stays open and is read whole with pread, the counters are kept
+ * in a dense array of the rows one after the other, so the deltas of a
+ * collect are a single pass over two contiguous arrays. The counters of the
+ * kernel are unsigned int, their deltas are taken modulo 2^32.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _IRQ_H
+#define _IRQ_H
+
+#include <inttypes.h>
+
+#define IRQ_INTERRUPTS "/proc/interrupts"
+#define IRQ_SOFTIRQS "/proc/softirqs"
+#define IRQ_NAME_MAX 16
+#define IRQ_DESC_MAX 64
+
+typedef struct {
+  char name[IRQ_NAME_MAX];      /* "24", "LOC", "NET_RX"... */
+  char desc[IRQ_DESC_MAX];      /* chip, type and devices, blanks squeezed */
+  int device;                   /* numbered irq of a device, else an event of the kernel */
+} irq_row_t;
+
+typedef struct {
+  const char *path;
+  int fd;
+  unsigned int gen;
+  char *buf;                    /* whole file, grown and never shrunk */
+  size_t size;
+  int ncpus;                    /* columns */
+  int *cpus;                    /* cpu number of each column */
+  int nrows;
+  int maxrows;
+  irq_row_t *rows;
+  uint32_t *counts[2];          /* [row * ncpus + column], current and previous */
+  int odd;                      /* index of the current counts */
+  uint64_t *row_delta;          /* by irq_delta */
+  uint64_t *cpu_delta;
+} irq_table_t;
+
+void irq_init(irq_table_t *t, const char *path);
+int  irq_open(irq_table_t *t);
+/* the new rows and a change of the columns have a delta of 0 */
+int  irq_read(irq_table_t *t);
+/* deltas of the rows and of the columns, devices restricts them to the
+ * rows of the devices */
+void irq_delta(irq_table_t *t, int devices);
+int  irq_find(const irq_table_t *t, const char *name);
+void irq_close(irq_table_t *t);
+
+static inline uint32_t irq_cell_delta(const irq_table_t *t, int row, int col)
+{
+  return t->counts[t->odd][row * t->ncpus + col] - t->counts[1 - t->odd][row * t->ncpus + col];
+}
+
+#endif /* _IRQ_H */
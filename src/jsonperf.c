@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <assert.h>
 #include <errno.h>
 #include <string.h>
 #include <limits.h>
@@ -62,6 +63,7 @@
 
 #include "jsonperf.h"
 #include "glib_compat.h"
+#include "jsonscan.h"
 
 #define STRUCT_ID_T STRUCT_PREFIX(id_t)
 
@@ -83,6 +85,7 @@
 #define FMTULL(x)  "\"" #x "\":%llu"
 #define FMTILL(x)  "\"" #x  "\":%lli"
 #define FMTDBL1(x) "\"" #x "\":%.1f"
+#define FMTDBL2(x) "\"" #x "\":%.2f"
 #define FMTSEP     ","
 
 /* Defines common */
@@ -95,6 +98,10 @@
 
 #define NONZERO(x) ((x)?(x):1)
 
+/* rate per second over the measured interval of the group */
+#define PERSEC(x) (((TYPE_ULL)(x) * 1000000ULL) / group_elapsed_us)
+#define PERSECDBL(x) ((double)(x) * 1000000.0 / group_elapsed_us)
+
 #define CALLPROTO(v, m)                \
 static int call_ ## m(modPerf_stats_t *v)
 
@@ -118,12 +125,12 @@ CALLPROTO(v, m) {
   nb_comp = STRUCT_PREFIX(m) (&id, tab, sizeof(STRUCT_PREFIX(m ## _t)), nb_comp);
 
 #define CALLCOMPBEGIN2FREQ(v, m, first, curr, nb_comp)   CALLCOMPBEGIN2(v, m, first, curr, nb_comp) \
-  int group_frequency = v->freq_data[GROUP_ ## m].shift;
+  TYPE_ULL group_elapsed_us = NONZERO(v->freq_data[GROUP_ ## m].elapsed_us);
 
 #define CALLCOMPBEGIN(v, m, first, curr)   CALLCOMPBEGIN2(v, m, first, curr, nb_comp)
 
 #define CALLCOMPBEGINFREQ(v, m, first, curr) CALLCOMPBEGIN2(v, m, first, curr, nb_comp) \
-  int group_frequency = v->freq_data[GROUP_ ## m].shift;
+  TYPE_ULL group_elapsed_us = NONZERO(v->freq_data[GROUP_ ## m].elapsed_us);
 
 
 #define RETURN_ON_NB_NULL(x) if (!x) return 0
@@ -141,6 +148,67 @@ CALLPROTO(v, m) {
 
 #define CALLCOMPEND return 0; }
 
+/* index of the previous values of curr in the max entries of previous, -1
+ * for a new component. The components come in the same order from one
+ * collect to the next, so the search starts after the last match (hint) and
+ * is one compare per component instead of a scan of the whole previous
+ * array. Only the nb_prev entries known before this collect are searched,
+ * the names of a collect being unique, so a first collect does no search. */
+#define FINDPREVIOUS(s, m, curr, idx, hint, nb_prev, max)                      \
+  {                                                                            \
+    int n_;                                                                    \
+    assert(nb_prev <= max);                                                    \
+    for (n_ = 0, idx = (hint < nb_prev) ? hint : 0; n_ < nb_prev &&            \
+            strncmp(curr->name, s->m.previous[idx].name, sizeof(curr->name));  \
+        n_++)                                                                  \
+      idx = (idx + 1 < nb_prev) ? idx + 1 : 0;                                 \
+    if (n_ == nb_prev)                                                         \
+      idx = -1;                                                                \
+    else                                                                       \
+    {                                                                          \
+      assert(idx < max);                                                       \
+      hint = idx + 1;                                                          \
+    }                                                                          \
+  }
+
+/* previous and next of the group both hold at least nb_comp components, they
+ * only grow so a collect of a known set does not allocate */
+#define GROWPREVIOUS(s, m, nb_comp)                                            \
+  if (s->m.max < nb_comp)                                                      \
+  {                                                                            \
+    void *p_;                                                                  \
+    if ((p_ = realloc(s->m.previous, sizeof(*s->m.previous) * nb_comp)) == NULL) \
+      return -1;                                                               \
+    s->m.previous = p_;                                                        \
+    if ((p_ = realloc(s->m.next, sizeof(*s->m.next) * nb_comp)) == NULL)       \
+      return -1;                                                               \
+    s->m.next = p_;                                                            \
+    s->m.max = nb_comp;                                                        \
+  }
+
+/* prev is the entry k of next, the previous values of curr or zeros for a
+ * new component. next is rebuilt at each collect so the components gone
+ * since the previous collect are dropped */
+#define NEXTPREVIOUS(s, m, curr, prev, k, idx, hint, nb_prev)                  \
+  {                                                                            \
+    FINDPREVIOUS(s, m, curr, idx, hint, nb_prev, s->m.max);                    \
+    assert(k < s->m.max);                                                      \
+    prev = s->m.next + k;                                                      \
+    if (idx >= 0)                                                              \
+      memcpy(prev, s->m.previous + idx, sizeof(*prev));                        \
+    else                                                                       \
+      memset(prev, 0, sizeof(*prev));                                          \
+  }
+
+/* the next of the collect becomes the previous of the next one */
+#define SWAPPREVIOUS(s, m, nb_comp)                                            \
+  {                                                                            \
+    void *p_ = s->m.previous;                                                  \
+    s->m.previous = s->m.next;                                                 \
+    s->m.next = p_;                                                            \
+    s->m.nb = nb_comp;                                                         \
+  }
+
 /* defines TOTAL */
 
 #define CALLTOTALBEGIN(v, m)  \
@@ -148,7 +216,7 @@ CALLPROTO(v, m) {
 
 #define CALLTOTALBEGINFREQ(v, m)                         \
 CALLPROTO(v, m) {                                        \
-  int group_frequency = v->freq_data[GROUP_ ## m].shift;
+  TYPE_ULL group_elapsed_us = NONZERO(v->freq_data[GROUP_ ## m].elapsed_us);
 
 
 #define CALLTOTALEND return 0; }
@@ -191,12 +259,14 @@ INITPROTO(s,x)                                                              \
 
 #define INITTOTALEND return 0; }
 
+#define PROC_NAME_MAX 63 /* the comm of linux and aix are shorter, the names of the kernel threads not always */
+
 struct _process_t {
   TYPE_ULL pid;
   TYPE_ULL cpu_ms;
   TYPE_ULL mem;
   TYPE_ULL cpu_pml;
-  char *proc;
+  char proc[PROC_NAME_MAX+1];  /* inline, no allocation per process */
   uchar_t odd;
   process_t *next;
 };
@@ -218,9 +288,56 @@ Group_source_t Group_source[] = {
 INITTOTALBEGIN(our_stats, cpu_total, cpu_total, curr)
 our_stats->cpu_total.processorMHZ = curr->processorHZ / 1000000;
 our_stats->n100cpus = 100*curr->ncpus;
+if (our_stats->container.enabled)
+  cgroup_self_read(&our_stats->container.cgroup, &our_stats->container.data[our_stats->container.odd]);
 INITTOTALEND
 
-CALLTOTALBEGIN(our_stats, cpu_total)
+/* cpu of the cgroup of jsonperfmon against its limit, the lower of its quota
+ * and of the cpus of its cpuset */
+static void append_container(modPerf_stats_t *our_stats, int ncpus, TYPE_ULL group_elapsed_us)
+{
+  cgroup_self_t *cs = &our_stats->container.cgroup;
+  uchar_t ts = 1 - our_stats->container.odd;
+  cgroup_stat_t *curr = &our_stats->container.data[ts];
+  cgroup_stat_t *prev = &our_stats->container.data[1 - ts];
+  double quota, limit;
+
+  if (cgroup_self_read(cs, curr) < 0)
+    return;
+  our_stats->container.odd = ts;
+
+  quota = (cs->quota_us) ? (double)cs->quota_us / cs->period_us : 0;
+  limit = (cs->ncpus) ? cs->ncpus : ncpus;
+  if (quota && quota < limit)
+    limit = quota;
+  limit = (limit > 0) ? limit * group_elapsed_us : group_elapsed_us;
+
+  g_string_append_printf(our_stats->out,
+           FMTSEP
+           SECOPEN(container)
+             FMTSTR(cgroup) FMTSEP
+             FMTI(cpuset_cpus) FMTSEP
+             FMTDBL2(quota_cpus) FMTSEP
+             FMTDBL1(used_pct) FMTSEP
+             FMTDBL1(user_pct) FMTSEP
+             FMTDBL1(sys_pct) FMTSEP
+             FMTULL(throttled_s) FMTSEP
+             FMTDBL1(throttled_periods_pct) FMTSEP
+             FMTULL(throttled_us_s)
+           SECCLOSE
+           ,
+             cs->path,
+             (cs->ncpus) ? cs->ncpus : ncpus,
+             quota,
+             100*DELTAMMBRDBL(curr,prev,usage_usec) / limit,
+             100*DELTAMMBRDBL(curr,prev,user_usec) / limit,
+             100*DELTAMMBRDBL(curr,prev,system_usec) / limit,
+             PERSEC(DELTAMMBRULL(curr,prev,nr_throttled)),
+             100*DELTAMMBRDBL(curr,prev,nr_throttled) / NONZERO(DELTAMMBRULL(curr,prev,nr_periods)),
+             PERSEC(DELTAMMBRULL(curr,prev,throttled_usec)));
+}
+
+CALLTOTALBEGINFREQ(our_stats, cpu_total)
   TYPE_ULL  ptotal;
 
   SWAPTOTAL(our_stats->cpu_total, cpu_total, curr, prev);
@@ -234,6 +351,10 @@ CALLTOTALBEGIN(our_stats, cpu_total)
   total = NONZERO(total);
 #endif
   ptotal  = DELTAMMBRULL(curr,prev,puser) + DELTAMMBRULL(curr,prev,psys) + DELTAMMBRULL(curr,prev,pidle) + DELTAMMBRULL(curr,prev,pwait);
+#if !defined(_AIX)
+  ptotal += DELTAMMBRULL(curr,prev,pnice) + DELTAMMBRULL(curr,prev,pirq) + DELTAMMBRULL(curr,prev,psoftirq)
+          + DELTAMMBRULL(curr,prev,psteal) + DELTAMMBRULL(curr,prev,pguest);
+#endif
   ptotal = NONZERO(ptotal);
 
   g_string_append_printf(our_stats->out,
@@ -243,7 +364,12 @@ CALLTOTALBEGIN(our_stats, cpu_total)
                FMTI(configured) FMTSEP
 #endif
                FMTULL(processorMHZ) FMTSEP
+#if defined(_AIX)
                FMTULL(run_queue_s) FMTSEP
+#else
+               FMTULL(procs_running) FMTSEP
+               FMTULL(procs_blocked) FMTSEP
+#endif
                FMTULL(context_switch_s) FMTSEP
 #if defined(_AIX)
                FMTULL(syscall_s) FMTSEP
@@ -259,24 +385,35 @@ CALLTOTALBEGIN(our_stats, cpu_total)
                  FMTDBL1(sys_pct) FMTSEP
                  FMTDBL1(wait_pct) FMTSEP
                  FMTDBL1(idle_pct)
+#if !defined(_AIX)
+                 FMTSEP
+                 FMTDBL1(nice_pct) FMTSEP
+                 FMTDBL1(irq_pct) FMTSEP
+                 FMTDBL1(softirq_pct) FMTSEP
+                 FMTDBL1(steal_pct) FMTSEP
+                 FMTDBL1(guest_pct)
+#endif
                SECCLOSE FMTSEP
                SECOPEN(load_average)
                  FMTDBL1(T0) FMTSEP
                  FMTDBL1(T5) FMTSEP
                  FMTDBL1(T15)
                SECCLOSE
-             SECCLOSE
-             FMTSEP
                          ,
                          curr->ncpus,
 #if defined(_AIX)
                          curr->ncpus_cfg,
 #endif
                          our_stats->cpu_total.processorMHZ,
+#if defined(_AIX)
                          DELTAMMBRULL(curr,prev,runque),
-                         DELTAMMBRULL(curr,prev,pswitch),
+#else
+                         curr->runque,
+                         curr->blocked,
+#endif
+                         PERSEC(DELTAMMBRULL(curr,prev,pswitch)),
 #if defined(_AIX)
-                         DELTAMMBRULL(curr,prev,syscall),
+                         PERSEC(DELTAMMBRULL(curr,prev,syscall)),
 
                          100*DELTAMMBRDBL(curr,prev,user) / total,
                          100*DELTAMMBRDBL(curr,prev,sys) / total,
@@ -288,6 +425,13 @@ CALLTOTALBEGIN(our_stats, cpu_total)
                          100*DELTAMMBRDBL(curr,prev,psys) / ptotal,
                          100*DELTAMMBRDBL(curr,prev,pwait) / ptotal,
                          100*DELTAMMBRDBL(curr,prev,pidle) / ptotal,
+#if !defined(_AIX)
+                         100*DELTAMMBRDBL(curr,prev,pnice) / ptotal,
+                         100*DELTAMMBRDBL(curr,prev,pirq) / ptotal,
+                         100*DELTAMMBRDBL(curr,prev,psoftirq) / ptotal,
+                         100*DELTAMMBRDBL(curr,prev,psteal) / ptotal,
+                         100*DELTAMMBRDBL(curr,prev,pguest) / ptotal,
+#endif
 
 #if defined(_AIX)
                          ((double)curr->loadavg[0])/ldavg_unit, /* uptime */
@@ -300,6 +444,9 @@ CALLTOTALBEGIN(our_stats, cpu_total)
 #endif
 
               );
+  if (our_stats->container.enabled)
+    append_container(our_stats, curr->ncpus, group_elapsed_us);
+  g_string_append(our_stats->out, SECCLOSE FMTSEP);
 
 CALLTOTALEND
 
@@ -324,10 +471,22 @@ INITPROTO(our_stats, cpu)
   return 0;
 }
 
+#if defined(_AIX)
+#define CPU_NUMBER(curr, j) (j)
+#else
+#define CPU_NUMBER(curr, j) ((curr)->cpu)
+#endif
+
 CALLCOMPBEGIN2(our_stats, cpu, FIRST_CPU, curr, nb_cpus)
   TYPE_ULL  total;
   int j;
   STRUCT_PREFIX(cpu_t) *prev;
+  numa_node_t *node;
+  char *sep = "";
+
+  /* the cpuset is refreshed by cpu_total */
+  if (our_stats->container.enabled && !our_stats->freq_data[CPU_TOTAL_GROUP].initialized)
+    cgroup_self_limits(&our_stats->container.cgroup);
 
   g_string_append(our_stats->out, SECOPEN(cpus));
 
@@ -343,7 +502,26 @@ CALLCOMPBEGIN2(our_stats, cpu, FIRST_CPU, curr, nb_cpus)
         our_stats->cpu.nb++;
       }
 
+    /* only the cpus of the cpuset of the container */
+    if (our_stats->container.enabled && !cgroup_self_cpu(&our_stats->container.cgroup, CPU_NUMBER(curr, j)))
+      {
+        memcpy(prev, curr, sizeof (STRUCT_PREFIX(cpu_t)));
+        continue;
+      }
+
     total = DELTAMMBRULL(curr,prev,user) + DELTAMMBRULL(curr,prev,sys) + DELTAMMBRULL(curr,prev,idle) + DELTAMMBRULL(curr,prev,wait);
+#if !defined(_AIX)
+    total += DELTAMMBRULL(curr,prev,nice) + DELTAMMBRULL(curr,prev,irq) + DELTAMMBRULL(curr,prev,softirq)
+           + DELTAMMBRULL(curr,prev,steal) + DELTAMMBRULL(curr,prev,guest);
+#endif
+    /* busy time of the numa node of the cpu, for the numa group */
+    if (our_stats->freq_data[NUMA_GROUP].initialized && (node = numa_cpu_node(&our_stats->numa.nodes, CPU_NUMBER(curr, j))))
+      {
+        node->ticks += total;
+        node->busy += total - DELTAMMBRULL(curr,prev,idle) - DELTAMMBRULL(curr,prev,wait);
+        node->user += DELTAMMBRULL(curr,prev,user);
+        node->sys += DELTAMMBRULL(curr,prev,sys);
+      }
     total = NONZERO(total); /* FREQ */
     g_string_append_printf(our_stats->out,
              "%s"
@@ -352,16 +530,33 @@ CALLCOMPBEGIN2(our_stats, cpu, FIRST_CPU, curr, nb_cpus)
                FMTDBL1(sys_pct) FMTSEP
                FMTDBL1(wait_pct) FMTSEP
                FMTDBL1(idle_pct)
+#if !defined(_AIX)
+               FMTSEP
+               FMTDBL1(nice_pct) FMTSEP
+               FMTDBL1(irq_pct) FMTSEP
+               FMTDBL1(softirq_pct) FMTSEP
+               FMTDBL1(steal_pct) FMTSEP
+               FMTDBL1(guest_pct)
+#endif
              SECCLOSE
              ,
-               (j) ? FMTSEP : "",
-               j,
+               sep,
+               CPU_NUMBER(curr, j),
                100*DELTAMMBRDBL(curr,prev,user)/total,
                100*DELTAMMBRDBL(curr,prev,sys)/total,
                100*DELTAMMBRDBL(curr,prev,wait)/total,
                100*DELTAMMBRDBL(curr,prev,idle)/total
+#if !defined(_AIX)
+               ,
+               100*DELTAMMBRDBL(curr,prev,nice)/total,
+               100*DELTAMMBRDBL(curr,prev,irq)/total,
+               100*DELTAMMBRDBL(curr,prev,softirq)/total,
+               100*DELTAMMBRDBL(curr,prev,steal)/total,
+               100*DELTAMMBRDBL(curr,prev,guest)/total
+#endif
           );
     memcpy(prev, curr, sizeof (STRUCT_PREFIX(cpu_t)));
+    sep = FMTSEP;
   FOREACHCOMPEND
   g_string_append(our_stats->out, SECCLOSE FMTSEP);
 CALLCOMPEND
@@ -424,10 +619,10 @@ CALLTOTALBEGINFREQ(our_stats, memory_total)
 
                curr->virt_active,
 
-               DELTAMMBRULL(curr,prev, pgins) >> group_frequency,
-               DELTAMMBRULL(curr,prev, pgouts) >> group_frequency,
-               DELTAMMBRULL(curr,prev, pgspins) >> group_frequency,
-               DELTAMMBRULL(curr,prev, pgspouts) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev, pgins)),
+               PERSEC(DELTAMMBRULL(curr,prev, pgouts)),
+               PERSEC(DELTAMMBRULL(curr,prev, pgspins)),
+               PERSEC(DELTAMMBRULL(curr,prev, pgspouts)),
 
 #if defined(_AIX)
                (curr->numperm MEM_DECAL),
@@ -443,7 +638,7 @@ CALLTOTALBEGINFREQ(our_stats, memory_total)
 #if defined(_AIX)
                curr->pgsp_rsvd,
 #endif
-               DELTAMMBRULL(curr,prev, pgexct) >> group_frequency
+               PERSEC(DELTAMMBRULL(curr,prev, pgexct))
 
              );
 #if defined(_AIX)
@@ -465,6 +660,25 @@ CALLTOTALBEGINFREQ(our_stats, memory_total)
              mem_page[i].real_inuse
              );
   }
+#else
+  /* -M, the sizes and the gauges as they are, the counters per second */
+  if (our_stats->memory_total.nkeys)
+  {
+    int i, k;
+
+    g_string_append(our_stats->out, FMTSEP SECOPEN(keys));
+    for (i = 0; i < our_stats->memory_total.nkeys; i++)
+    {
+      k = our_stats->memory_total.keys[i];
+      if (memkeys[k].kind == MEMKIND_EVENTS)
+        g_string_append_printf(our_stats->out, "%s\"%s_s\":%llu", (i) ? FMTSEP : "", memkeys[k].name,
+                               PERSEC(DELTAMMBRULL(curr,prev, keys[k])));
+      else
+        g_string_append_printf(our_stats->out, "%s\"%s%s\":%llu", (i) ? FMTSEP : "", memkeys[k].name,
+                               (memkeys[k].kind == MEMKIND_KB) ? "_kb" : "", curr->keys[k]);
+    }
+    g_string_append(our_stats->out, SECCLOSE);
+  }
 #endif
   g_string_append_printf(our_stats->out,
              SECCLOSE
@@ -519,7 +733,7 @@ INITPROTO(our_stats, disk)
   if ( nb_disks < 1 )
       return -1;
 
-  our_stats->disk.previous = (STRUCT_PREFIX(disk_t)*)realloc(our_stats->disk.previous, sizeof(STRUCT_PREFIX(disk_t))*nb_disks);
+  GROWPREVIOUS(our_stats, disk, nb_disks);
 
   nb_disks = STRUCT_PREFIX(disk) (&id, (STRUCT_PREFIX(disk_t)*)(our_stats->disk.previous), sizeof(STRUCT_PREFIX(disk_t)), nb_disks);
 
@@ -529,26 +743,15 @@ INITPROTO(our_stats, disk)
 }
 
 CALLCOMPBEGIN2FREQ(our_stats, disk, FIRST_PAGINGSPACE, curr, nb_disks)
-  int idx,j;
+  int idx, j, hint = 0, nb_prev = our_stats->disk.nb;
   STRUCT_PREFIX(disk_t) *prev;
 
   g_string_append(our_stats->out, SECOPEN(disks));
 
-  if (our_stats->disk.nb < nb_disks)
-     our_stats->disk.previous = (STRUCT_PREFIX(disk_t)*)realloc(our_stats->disk.previous, sizeof(STRUCT_PREFIX(disk_t))*nb_disks);
+  GROWPREVIOUS(our_stats, disk, nb_disks);
 
   FOREACHCOMPBEGIN2(j,nb_disks)
-    for (idx = 0; idx < our_stats->disk.nb &&
-            strncmp(curr->name, our_stats->disk.previous[idx].name, sizeof(curr->name));
-        idx++)
-      ;
-
-    prev = our_stats->disk.previous+idx;
-    if (idx == our_stats->disk.nb)
-    {
-      memset(prev, 0, sizeof(STRUCT_PREFIX(disk_t)));
-      our_stats->disk.nb++;
-    }
+    NEXTPREVIOUS(our_stats, disk, curr, prev, j, idx, hint, nb_prev);
 
     g_string_append_printf(our_stats->out,
              "%s"
@@ -585,16 +788,37 @@ CALLCOMPBEGIN2FREQ(our_stats, disk, FIRST_PAGINGSPACE, curr, nb_disks)
                  FMTULL(read_len_avg) FMTSEP
                  FMTULL(wq_depth)
                SECCLOSE
+#if !defined(_AIX)
+               FMTSEP
+               SECOPEN(iostat)
+                 FMTDBL2(r_s) FMTSEP
+                 FMTDBL2(rkb_s) FMTSEP
+                 FMTDBL2(rrqm_s) FMTSEP
+                 FMTDBL2(r_await_ms) FMTSEP
+                 FMTDBL2(w_s) FMTSEP
+                 FMTDBL2(wkb_s) FMTSEP
+                 FMTDBL2(wrqm_s) FMTSEP
+                 FMTDBL2(w_await_ms) FMTSEP
+                 FMTDBL2(d_s) FMTSEP
+                 FMTDBL2(dkb_s) FMTSEP
+                 FMTDBL2(drqm_s) FMTSEP
+                 FMTDBL2(d_await_ms) FMTSEP
+                 FMTDBL2(f_s) FMTSEP
+                 FMTDBL2(f_await_ms) FMTSEP
+                 FMTDBL2(aqu_sz) FMTSEP
+                 FMTDBL1(util_pct)
+               SECCLOSE
+#endif
              SECCLOSE
              ,
                (j) ? FMTSEP : "",
                curr->name,
-               DELTAMMBRULL(curr,prev,time) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,time)),
 
-               DELTAMMBRULL(curr,prev,rblks) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,rblks)),
 #if defined(_AIX)
-               DELTAMMBRULL(curr,prev,rtimeout) >> group_frequency,
-               DELTAMMBRULL(curr,prev,rfailed) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,rtimeout)),
+               PERSEC(DELTAMMBRULL(curr,prev,rfailed)),
                HWTICS2USECS(curr->min_rserv),
                HWTICS2USECS(curr->max_rserv),
                HWTICS2USECS(DELTAMMBRULL(curr,prev,rserv))/NONZERO(DELTAMMBRULL(curr,prev,xrate)),
@@ -602,10 +826,10 @@ CALLCOMPBEGIN2FREQ(our_stats, disk, FIRST_PAGINGSPACE, curr, nb_disks)
                DELTAMMBRULL(curr,prev,rserv)/NONZERO(DELTAMMBRULL(curr,prev,rfers)),
 #endif
 
-               DELTAMMBRULL(curr,prev,wblks) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,wblks)),
 #if defined(_AIX)
-               DELTAMMBRULL(curr,prev,wtimeout) >> group_frequency,
-               DELTAMMBRULL(curr,prev,wfailed) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,wtimeout)),
+               PERSEC(DELTAMMBRULL(curr,prev,wfailed)),
                HWTICS2USECS(curr->min_wserv),
                HWTICS2USECS(curr->max_wserv),
                HWTICS2USECS(DELTAMMBRULL(curr,prev,wserv))/NONZERO(DELTAMMBRULL(curr,prev,xfers)-DELTAMMBRULL(curr,prev,xrate)),
@@ -614,21 +838,43 @@ CALLCOMPBEGIN2FREQ(our_stats, disk, FIRST_PAGINGSPACE, curr, nb_disks)
 #endif
 
 #if defined(_AIX)
-               DELTAMMBRULL(curr,prev,q_full) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,q_full)),
                HWTICS2USECS(curr->wq_min_time),
                HWTICS2USECS(curr->wq_max_time),
                HWTICS2USECS(DELTAMMBRULL(curr,prev,wq_time))/NONZERO(DELTAMMBRULL(curr,prev,xfers)),
-               (DELTAMMBRULL(curr,prev,wq_sampled) >> group_frequency)/our_stats->n100cpus,
-               (DELTAMMBRULL(curr,prev,q_sampled) >> group_frequency)/our_stats->n100cpus,
+               PERSEC(DELTAMMBRULL(curr,prev,wq_sampled))/our_stats->n100cpus,
+               PERSEC(DELTAMMBRULL(curr,prev,q_sampled))/our_stats->n100cpus,
 #else
                DELTAMMBRULL(curr,prev,wq_time)/NONZERO(DELTAMMBRULL(curr,prev,wfers)+DELTAMMBRULL(curr,prev,rfers)),
-               (DELTAMMBRULL(curr,prev,wq_sampled) >> group_frequency),
-               (DELTAMMBRULL(curr,prev,q_sampled) >> group_frequency),
+               PERSEC(DELTAMMBRULL(curr,prev,wmerged)),
+               PERSEC(DELTAMMBRULL(curr,prev,rmerged)),
 #endif
                curr->wq_depth
+#if !defined(_AIX)
+               ,
+               /* the sectors are of 512 bytes, the service times in us */
+               PERSECDBL(DELTAMMBRULL(curr,prev,rfers)),
+               PERSECDBL(DELTAMMBRULL(curr,prev,rblks)) / 2,
+               PERSECDBL(DELTAMMBRULL(curr,prev,rmerged)),
+               DELTAMMBRDBL(curr,prev,rserv) / 1000 / NONZERO(DELTAMMBRULL(curr,prev,rfers)),
+               PERSECDBL(DELTAMMBRULL(curr,prev,wfers)),
+               PERSECDBL(DELTAMMBRULL(curr,prev,wblks)) / 2,
+               PERSECDBL(DELTAMMBRULL(curr,prev,wmerged)),
+               DELTAMMBRDBL(curr,prev,wserv) / 1000 / NONZERO(DELTAMMBRULL(curr,prev,wfers)),
+               PERSECDBL(DELTAMMBRULL(curr,prev,dfers)),
+               PERSECDBL(DELTAMMBRULL(curr,prev,dblks)) / 2,
+               PERSECDBL(DELTAMMBRULL(curr,prev,dmerged)),
+               DELTAMMBRDBL(curr,prev,dserv) / 1000 / NONZERO(DELTAMMBRULL(curr,prev,dfers)),
+               PERSECDBL(DELTAMMBRULL(curr,prev,ffers)),
+               DELTAMMBRDBL(curr,prev,fserv) / 1000 / NONZERO(DELTAMMBRULL(curr,prev,ffers)),
+               /* the time in queue and the busy time are in ms */
+               PERSECDBL(DELTAMMBRULL(curr,prev,wq_time)) / 1000,
+               PERSECDBL(DELTAMMBRULL(curr,prev,time)) / 10
+#endif
           );
     memcpy(prev, curr, sizeof (*curr));
   FOREACHCOMPEND
+  SWAPPREVIOUS(our_stats, disk, nb_disks);
   g_string_append(our_stats->out, SECCLOSE FMTSEP);
 CALLCOMPEND
 
@@ -673,7 +919,8 @@ CALLTOTALBEGIN(our_stats, filesystems)
 
   for (vm = (struct vmount *)buf, j = 0; j < num; j++)
     {
-      if (vm->vmt_flags & (VFS_DEVMOUNT|VFS_REMOTE))
+      /* once degraded, the remote mounts are skipped as their statvfs may block */
+      if (vm->vmt_flags & ((our_stats->budget.level) ? VFS_DEVMOUNT : (VFS_DEVMOUNT|VFS_REMOTE)))
         {
           u_longlong_t size_mb = 0, free_pct = 0;
           int l, len = (int)vmt2datasize(vm,VMT_OBJECT);
@@ -720,9 +967,9 @@ CALLTOTALBEGIN(our_stats, filesystems)
   struct mntent *ent;
   FILE *aFile;
   struct statvfs svfs;
-  char *sep = "";
+  char *sep = "", mnt[PATH_MAX];
 
-  if ((aFile = setmntent("/etc/mtab", "r")) == NULL)
+  if ((aFile = selfstat_fopen("/etc/mtab", "r")) == NULL)
     return -1;
 
   g_string_append(our_stats->out, SECOPEN(fs));
@@ -731,6 +978,9 @@ CALLTOTALBEGIN(our_stats, filesystems)
   {
     if (strncmp(ent->mnt_type, "ext", 3) && strncmp(ent->mnt_type, "nfs", 3) && strncmp(ent->mnt_type, "xfs", 3))
       continue;
+    /* once degraded, the nfs mounts are skipped as their statvfs may block */
+    if (our_stats->budget.level && !strncmp(ent->mnt_type, "nfs", 3))
+      continue;
     uint64_t size_mb = 0, free_pct = 0;
     char *p, *str = ent->mnt_fsname;
     size_t l, len = safe_strlen(ent->mnt_fsname);
@@ -740,7 +990,7 @@ CALLTOTALBEGIN(our_stats, filesystems)
      for (p=str, l=len; l>0; p++, l--)
        if (*p=='/') *p='_';
 
-     if (!statvfs(ent->mnt_dir,&svfs))
+     if (!statvfs(selfstat_path(ent->mnt_dir, mnt, sizeof(mnt)),&svfs))
        {
          size_mb = (uint64_t)(svfs.f_blocks * svfs.f_frsize / 1024 /1024);
          free_pct = (svfs.f_bfree *100) / svfs.f_blocks;
@@ -763,7 +1013,7 @@ CALLTOTALBEGIN(our_stats, filesystems)
                 );
      sep = FMTSEP;
   }
-  endmntent(aFile);
+  selfstat_fclose(aFile);
   g_string_append(our_stats->out, SECCLOSE FMTSEP);
 
 CALLCOMPEND
@@ -816,7 +1066,7 @@ CALLTOTALBEGINFREQ(our_stats, nfsv3)
                  FMTDBL1(attrGetSet_pct)
              SECCLOSE FMTSEP
              ,
-               total >> group_frequency,
+               PERSEC(total),
                100*DELTAMMBRDBL(curr,prev,u.nfsv3.client.access)/divisor,
                100*DELTAMMBRDBL(curr,prev,u.nfsv3.client.read)/divisor,
                100*DELTAMMBRDBL(curr,prev,u.nfsv3.client.write)/divisor,
@@ -857,7 +1107,7 @@ CALLTOTALBEGINFREQ(our_stats, nfsv4)
                  FMTDBL1(lock_unlock_pct)
              SECCLOSE FMTSEP
              ,
-               total >> group_frequency,
+               PERSEC(total),
                100*DELTAMMBRDBL(curr,prev,u.nfsv4.client.access)/divisor,
                100*DELTAMMBRDBL(curr,prev,u.nfsv4.client.read)/divisor,
                100*DELTAMMBRDBL(curr,prev,u.nfsv4.client.write)/divisor,
@@ -884,31 +1134,21 @@ INITPROTO(our_stats, netinterface)
 }
 
 CALLCOMPBEGIN2FREQ(our_stats, netinterface, FIRST_NETINTERFACE, curr, nb_nets)
-  int idx, j;
+  int idx, j, k = 0, hint = 0, nb_prev = our_stats->netinterface.nb;
   STRUCT_PREFIX(netinterface_t) *prev;
   char * sep = "";
 
   g_string_append(our_stats->out,
            SECOPEN(intfs));
 
-  if (our_stats->netinterface.nb < nb_nets)
-    our_stats->netinterface.previous = (STRUCT_PREFIX(netinterface_t)*)realloc(our_stats->netinterface.previous, sizeof(STRUCT_PREFIX(netinterface_t))*nb_nets);
+  GROWPREVIOUS(our_stats, netinterface, nb_nets);
 
   FOREACHCOMPBEGIN2(j,nb_nets)
     if (!strncmp(curr->name, "lo", 2) && safe_strlen(curr->name)==3)
       continue;
 
-    for (idx = 0; idx < our_stats->netinterface.nb &&
-            strncmp(curr->name, our_stats->netinterface.previous[idx].name, sizeof(curr->name));
-        idx++)
-      ;
-
-    prev = our_stats->netinterface.previous+idx;
-    if (idx == our_stats->netinterface.nb)
-      {
-        memset(prev, 0, sizeof(STRUCT_PREFIX(netinterface_t)));
-        our_stats->netinterface.nb++;
-      }
+    NEXTPREVIOUS(our_stats, netinterface, curr, prev, k, idx, hint, nb_prev);
+    k++;
 
     g_string_append_printf(our_stats->out,
             "%s"
@@ -929,13 +1169,13 @@ CALLCOMPBEGIN2FREQ(our_stats, netinterface, FIRST_NETINTERFACE, curr, nb_nets)
              ,
                sep,
                curr->name,
-               DELTAMMBRULL(curr,prev,ipackets) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,ipackets)),
                curr->ierrors,
-               DELTAMMBRULL(curr,prev,ibytes) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,ibytes)),
 
-               DELTAMMBRULL(curr,prev,opackets) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,opackets)),
                curr->oerrors,
-               DELTAMMBRULL(curr,prev,obytes) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,obytes)),
 
                curr->collisions,
                curr->xmitdrops+curr->if_iqdrops
@@ -943,6 +1183,7 @@ CALLCOMPBEGIN2FREQ(our_stats, netinterface, FIRST_NETINTERFACE, curr, nb_nets)
     memcpy(prev, curr, sizeof (*curr));
     sep = FMTSEP;
   FOREACHCOMPEND
+  SWAPPREVIOUS(our_stats, netinterface, k);
   g_string_append(our_stats->out,
            SECCLOSE FMTSEP);
 CALLCOMPEND
@@ -960,7 +1201,7 @@ INITPROTO(our_stats, fcstat)
   if ( nb_fcadapter < 1 )
       return -1;
 
-  our_stats->fcstat.previous= (STRUCT_PREFIX(fcstat_t)*)realloc(our_stats->fcstat.previous,sizeof(STRUCT_PREFIX(fcstat_t))*nb_fcadapter);
+  GROWPREVIOUS(our_stats, fcstat, nb_fcadapter);
 
   nb_fcadapter = STRUCT_PREFIX(fcstat)(&id, our_stats->fcstat.previous, sizeof(STRUCT_PREFIX(fcstat_t)), nb_fcadapter);
 
@@ -970,28 +1211,17 @@ INITPROTO(our_stats, fcstat)
 }
 
 CALLCOMPBEGIN2FREQ(our_stats, fcstat, FIRST_PAGINGSPACE, curr, nb_fcstat)
-  int idx,j;
+  int idx, j, hint = 0, nb_prev = our_stats->fcstat.nb;
   STRUCT_PREFIX(fcstat_t) *prev;
 
   RETURN_ON_NB_NULL(nb_fcstat);
 
-  if (our_stats->fcstat.nb < nb_fcstat)
-    our_stats->fcstat.previous= (STRUCT_PREFIX(fcstat_t)*)realloc(our_stats->fcstat.previous,sizeof(STRUCT_PREFIX(fcstat_t))*nb_fcstat);
+  GROWPREVIOUS(our_stats, fcstat, nb_fcstat);
 
   g_string_append(our_stats->out, SECOPEN(fcadapters));
 
   FOREACHCOMPBEGIN2(j, nb_fcstat)
-    for (idx = 0; idx < our_stats->fcstat.nb &&
-            strncmp(curr->name, our_stats->fcstat.previous[idx].name, sizeof(curr->name));
-        idx++)
-      ;
-
-    prev = our_stats->fcstat.previous+idx;
-    if (idx == our_stats->fcstat.nb)
-      {
-        memset(prev, 0, sizeof(STRUCT_PREFIX(fcstat_t)));
-        our_stats->fcstat.nb++;
-      }
+    NEXTPREVIOUS(our_stats, fcstat, curr, prev, j, idx, hint, nb_prev);
 
     g_string_append_printf(our_stats->out,
              "%s"
@@ -1014,17 +1244,18 @@ CALLCOMPBEGIN2FREQ(our_stats, fcstat, FIRST_PAGINGSPACE, curr, nb_fcstat)
 #if defined(_AIX)
                curr->EffMaxTransfer,
 #endif
-               DELTAMMBRULL(curr,prev,RxWords) >> group_frequency,
-               DELTAMMBRULL(curr,prev,TxWords) >> group_frequency,
-               DELTAMMBRULL(curr,prev,ErrorFrames) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,RxWords)),
+               PERSEC(DELTAMMBRULL(curr,prev,TxWords)),
+               PERSEC(DELTAMMBRULL(curr,prev,ErrorFrames)),
                curr->ErrorFrames,
-               DELTAMMBRULL(curr,prev,DumpedFrames) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,DumpedFrames)),
                curr->DumpedFrames,
-               DELTAMMBRULL(curr,prev,LinkFailureCount) >> group_frequency,
+               PERSEC(DELTAMMBRULL(curr,prev,LinkFailureCount)),
                curr->LinkFailureCount
           );
     memcpy(prev, curr, sizeof (*curr));
   FOREACHCOMPEND
+  SWAPPREVIOUS(our_stats, fcstat, nb_fcstat);
   g_string_append(our_stats->out,SECCLOSE FMTSEP);
 CALLCOMPEND
 
@@ -1069,7 +1300,7 @@ void store_procentry_init(process_t *cur, struct procentry64 *entry, uchar_t odd
   cur->pid = (TYPE_ULL)entry->pi_pid;
   cur->mem = ((TYPE_ULL)entry->pi_size) MEM_DECAL;
   cur->cpu_ms = TIMED(entry->pi_ru.ru_utime) + TIMED(entry->pi_ru.ru_stime);
-  cur->proc = strdup(entry->pi_comm);
+  snprintf(cur->proc, sizeof(cur->proc), "%.*s", (int)sizeof(cur->proc) - 1, entry->pi_comm);
   cur->cpu_pml = 0;
   cur->odd = odd;
 }
@@ -1093,36 +1324,102 @@ void store_procentry_delta(process_t *cur, struct procentry64 *entry, uchar_t od
   classTopTen(cur, top_ten_mem, nb_top_ten_mem, NB_PROC_MEM, compare_mem);
 }
 
-INITPROTO(our_stats, processes)
+/* heap sort in place, qsort of the glibc allocates its buffer */
+static void sort_procentrys(struct procentry64 *e, int n)
 {
-  pid_t firstproc = (pid_t)0;
-  int nb_processes;
-  int i;
-  process_t *cur_proc, *tmp_proc, **p_prev_proc;
-  struct procentry64 *procentrys;
+  struct procentry64 tmp;
+  int i, root, child, end;
+
+  for (i = n / 2 - 1, end = n - 1; end > 0; )
+    {
+      if (i >= 0)
+        root = i--;                 /* heap building */
+      else
+        {
+          tmp = e[0]; e[0] = e[end]; e[end] = tmp;
+          end--;
+          root = 0;
+        }
+      for (; (child = 2 * root + 1) <= end; root = child)
+        {
+          if (child < end && e[child].pi_pid < e[child+1].pi_pid)
+            child++;
+          if (e[root].pi_pid >= e[child].pi_pid)
+            break;
+          tmp = e[root]; e[root] = e[child]; e[child] = tmp;
+        }
+    }
+}
 
+/* reads the process table in a buffer kept between the collects, an alloca
+ * of 150k entries would not fit in the stack. The entries are sorted by pid
+ * like the list of the processes, so both are merged in a single pass. */
+static int get_procentrys(modPerf_stats_t *our_stats)
+{
+  pid_t firstproc = (pid_t)0;
+  int nb_processes, i;
 
   nb_processes = getprocs64(NULL, sizeof(struct procentry64), NULL, 0, &firstproc, 999999);
-  procentrys = (struct procentry64 *)alloca( nb_processes * sizeof(struct procentry64) );
+  if (nb_processes < 0)
+    return -1;
+
+  if (nb_processes > our_stats->processes.nb_entries)
+  {
+    struct procentry64 *entries = (struct procentry64 *)realloc(our_stats->processes.entries, nb_processes * sizeof(struct procentry64));
+    if (!entries)
+      return -1;
+    our_stats->processes.entries = entries;
+    our_stats->processes.nb_entries = nb_processes;
+  }
 
   firstproc = (pid_t)0; /* you have to reset this every time */
-  nb_processes = getprocs64(procentrys, sizeof(struct procentry64), NULL, 0, &firstproc, nb_processes);
+  nb_processes = getprocs64(our_stats->processes.entries, sizeof(struct procentry64), NULL, 0, &firstproc, nb_processes);
+
+  /* /proc and getprocs64 give the pids in order, a replayed tree may not */
+  for (i = 1; i < nb_processes && our_stats->processes.entries[i-1].pi_pid < our_stats->processes.entries[i].pi_pid; i++)
+    ;
+  if (i < nb_processes)
+    sort_procentrys(our_stats->processes.entries, nb_processes);
+  return nb_processes;
+}
+
+/* the processes gone are kept for the new ones, so a stable host does not
+ * allocate any process_t once the list is built */
+static inline process_t *new_process(modPerf_stats_t *our_stats)
+{
+  process_t *p = our_stats->processes.free;
+
+  if (!p)
+    return (process_t*)malloc(sizeof(process_t));
+  our_stats->processes.free = p->next;
+  return p;
+}
+
+INITPROTO(our_stats, processes)
+{
+  int nb_processes;
+  int i;
+  process_t *tmp_proc, **p_prev_proc = &our_stats->processes.str_procs_first;
+  struct procentry64 *procentrys;
+
+  if ((nb_processes = get_procentrys(our_stats)) < 0)
+    return -1;
+  procentrys = our_stats->processes.entries;
 
+  /* the list is empty, the sorted entries are appended */
   for(i=0;i<nb_processes;i++)
     {
       if (procentrys[i].pi_state != SZOMB && (procentrys[i].pi_flags & SKPROC)==0)
         {
-          tmp_proc = (process_t*)malloc(sizeof(process_t));
+          tmp_proc = new_process(our_stats);
           if (!tmp_proc)
               return -1;
 
           store_procentry_init(tmp_proc, procentrys+i, 0);
 
-          for (cur_proc = our_stats->processes.str_procs_first, p_prev_proc=&our_stats->processes.str_procs_first; cur_proc && cur_proc->pid < procentrys[i].pi_pid; p_prev_proc = &(cur_proc->next), cur_proc=cur_proc->next)
-            ;
-
-          tmp_proc->next = cur_proc;
+          tmp_proc->next = *p_prev_proc;
           (*p_prev_proc) = tmp_proc;
+          p_prev_proc = &(tmp_proc->next);
         }
     }
   return 0;
@@ -1133,7 +1430,6 @@ CALLTOTALBEGINFREQ(our_stats, processes)
   int nb_top_ten_cpu = 0;
   process_t *top_ten_mem[NB_PROC_MEM+1];
   int nb_top_ten_mem = 0;
-  pid_t firstproc = (pid_t)0;
   int nb_processes;
   int i;
   uchar_t ts = 1 - our_stats->processes.odd;
@@ -1145,17 +1441,17 @@ CALLTOTALBEGINFREQ(our_stats, processes)
 
   our_stats->processes.odd = ts;
 
-  nb_processes = getprocs64(NULL, sizeof(struct procentry64), NULL, 0, &firstproc, 999999);
-  procentrys = (struct procentry64 *)alloca(nb_processes * sizeof(struct procentry64) );
-
-  firstproc = (pid_t)0; /* you have to reset this every time */
-  nb_processes = getprocs64(procentrys, sizeof(struct procentry64), NULL, 0, &firstproc, nb_processes);
+  if ((nb_processes = get_procentrys(our_stats)) < 0)
+    return -1;
+  procentrys = our_stats->processes.entries;
 
+  /* both sorted by pid, the search goes on from the previous position */
+  p_prev_proc = &our_stats->processes.str_procs_first;
   for(i=0; i<nb_processes; i++)
     {
       if (procentrys[i].pi_state != SZOMB && (procentrys[i].pi_flags & SKPROC)==0)
         {
-          for (cur_proc = our_stats->processes.str_procs_first, p_prev_proc=&our_stats->processes.str_procs_first; cur_proc && cur_proc->pid < procentrys[i].pi_pid; p_prev_proc = &(cur_proc->next), cur_proc=cur_proc->next)
+          for (cur_proc = *p_prev_proc; cur_proc && cur_proc->pid < procentrys[i].pi_pid; p_prev_proc = &(cur_proc->next), cur_proc=cur_proc->next)
             ;
 
           if (cur_proc && cur_proc->pid == procentrys[i].pi_pid)
@@ -1164,7 +1460,7 @@ CALLTOTALBEGINFREQ(our_stats, processes)
             }
           else
             {
-              tmp_proc = (process_t*)malloc(sizeof(process_t));
+              tmp_proc = new_process(our_stats);
               if (tmp_proc)
                 {
                   store_procentry_new(tmp_proc, procentrys+i, ts, top_ten_cpu, &nb_top_ten_cpu, top_ten_mem, &nb_top_ten_mem);
@@ -1180,8 +1476,8 @@ CALLTOTALBEGINFREQ(our_stats, processes)
       if (cur_proc->odd != ts)
         {
           *p_prev_proc = cur_proc->next;
-          free(cur_proc->proc);
-          free(cur_proc);
+          cur_proc->next = our_stats->processes.free;
+          our_stats->processes.free = cur_proc;
         }
       else
         {
@@ -1206,7 +1502,7 @@ CALLTOTALBEGINFREQ(our_stats, processes)
                  i,
                  top_ten_cpu[i]->pid,
                  top_ten_cpu[i]->proc,
-                 ((double)(top_ten_cpu[i]->cpu_pml >> group_frequency))/10.0,
+                 ((double)PERSEC(top_ten_cpu[i]->cpu_pml))/10.0,
                  top_ten_cpu[i]->mem
             );
     }
@@ -1233,255 +1529,2564 @@ CALLTOTALBEGINFREQ(our_stats, processes)
 CALLTOTALEND
 
 /******************************************************************************************************************
- * global
+ * pressure : Linux pressure stall information, the fds are kept open as
+ * they can hold the triggers
  *****************************************************************************************************************/
-void stats_allocate(modPerf_stats_t *self)
+INITPROTO(our_stats, pressure)
 {
-  int i;
+  int r;
+  for (r = 0; r < PRESSURE_MAX; r++)
+  {
+    if (our_stats->pressure.res[r].fd >= 0)
+      continue;
+    if (pressure_open(&our_stats->pressure.res[r], pressure_names[r], our_stats->pressure.triggers[r]) < 0)
+      continue;
+    pressure_read(&our_stats->pressure.res[r], &our_stats->pressure.data[r][0]);
+  }
+  return 0;
+}
 
-  self->out = g_string_sized_new(1024);
+static void append_pressure_line(modPerf_stats_t *our_stats, const char *name, pressure_line_t *curr, pressure_line_t *prev, TYPE_ULL group_elapsed_us)
+{
+  g_string_append_printf(our_stats->out,
+           "\"%s\":{"
+             FMTDBL1(avg10_pct) FMTSEP
+             FMTDBL1(avg60_pct) FMTSEP
+             FMTDBL1(avg300_pct) FMTSEP
+             FMTULL(stall_us_s)
+           SECCLOSE
+           ,
+             name,
+             curr->avg10,
+             curr->avg60,
+             curr->avg300,
+             PERSEC(DELTAULL(curr->total, prev->total)));
+}
 
-  if (self->freq_data[CPU_TOTAL_GROUP].type)
-    init_cpu_total(self);
-  if (self->freq_data[CPUS_GROUP].type)
-    init_cpu(self);
-  if (self->freq_data[MEMORY_GROUP].type)
-    {
-      init_memory_total(self);
-      init_pagingspace(self);
-    }
-  if (self->freq_data[DISKS_GROUP].type)
-    {
-      init_disk(self);
-      init_filesystems(self);
-      init_nfs(self);
-    }
-  if (self->freq_data[ADAPTERS_GROUP].type)
+CALLTOTALBEGINFREQ(our_stats, pressure)
+  uchar_t ts = 1 - our_stats->pressure.odd;
+  char *sep = "";
+  int r;
+
+  our_stats->pressure.odd = ts;
+  g_string_append(our_stats->out, SECOPEN(pressure));
+  for (r = 0; r < PRESSURE_MAX; r++)
+  {
+    pressure_stat_t *curr = &our_stats->pressure.data[r][ts];
+    pressure_stat_t *prev = &our_stats->pressure.data[r][1 - ts];
+
+    if (pressure_read(&our_stats->pressure.res[r], curr) < 0)
+      continue;
+
+    g_string_append_printf(our_stats->out, "%s\"%s\":{", sep, pressure_names[r]);
+    append_pressure_line(our_stats, "some", &curr->some, &prev->some, group_elapsed_us);
+    if (curr->has_full)
     {
-      init_netinterface(self);
-      init_fcstat(self);
+      g_string_append(our_stats->out, FMTSEP);
+      append_pressure_line(our_stats, "full", &curr->full, &prev->full, group_elapsed_us);
     }
-  if (self->freq_data[PROCESSES_GROUP].type)
-    init_processes(self);
-}
+    g_string_append(our_stats->out, SECCLOSE);
+    sep = FMTSEP;
+  }
+  g_string_append(our_stats->out, SECCLOSE FMTSEP);
 
-void stats_initialize(modPerf_stats_t *self, char *hostname, int lhostname)
+CALLTOTALEND
+
+/******************************************************************************************************************
+ * cgroups : Linux cgroups v2 down to a depth (-G), the top cgroups by cpu, memory and io. The hierarchy
+ * is followed with inotify, see cgroup.h
+ *****************************************************************************************************************/
+#define NB_CGROUP_TOP 5
+
+typedef struct {
+  cgroup_t *cgroup;
+  TYPE_ULL key;
+} cgroup_top_t;
+
+static void classTopCgroup(cgroup_t *cur, TYPE_ULL key, cgroup_top_t *top, int *nb_top)
 {
   int i;
 
-  self->cpu.previous = NULL;
-  self->disk.previous = NULL;
-  self->netinterface.previous = NULL;
-  self->fcstat.previous = NULL;
-  self->processes.str_procs_first = NULL;
+  if (*nb_top == NB_CGROUP_TOP && key <= top[NB_CGROUP_TOP-1].key)
+    return;
+  for (i = *nb_top-1; i>=0 && top[i].key < key; i--)
+    {
+      top[i+1] = top[i];
+    }
+  top[i+1].cgroup = cur;
+  top[i+1].key = key;
+  if (*nb_top < NB_CGROUP_TOP)
+      (*nb_top)++;
+}
 
-  for (i=0; i< GROUP_MAX; i++)
-  {
-    self->freq_data[i].setted = 0;
-    self->freq_data[i].type = 0;
-    self->freq_data[i].mask = UINT32_MAX;
-    self->freq_data[i].shift = 31;
-  }
+/* the new and removed cgroups are applied as they come, the collect only reads them */
+static void on_cgroups(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  modPerf_stats_t *self = (modPerf_stats_t *)data;
 
-  self->mask_freq = UINT32_MAX;
-  self->mask_freq_std = UINT32_MAX;
-  self->lhostname = (((size_t)lhostname)>sizeof(self->hostname)) ? sizeof(self->hostname) : (size_t)lhostname;
-  memcpy(self->hostname, hostname, self->lhostname);
+  (void)loop;
+  (void)fd;
+  (void)events;
+  cgroup_inotify(&self->cgroups.tree);
 }
 
-void stats_free(modPerf_stats_t *self)
+/* the first values of the cgroups, the new ones get theirs at their first collect */
+INITPROTO(our_stats, cgroups)
 {
-  process_t *cur_proc;
-  if (self->freq_data[CPUS_GROUP].type)
-    free(self->cpu.previous);
-  if (self->freq_data[DISKS_GROUP].type)
-    free(self->disk.previous);
-  if (self->freq_data[ADAPTERS_GROUP].type)
-  {
-    free(self->netinterface.previous);
-    free(self->fcstat.previous);
-  }
-  if (self->freq_data[PROCESSES_GROUP].type)
-  {
-    for (cur_proc = self->processes.str_procs_first; cur_proc; )
-      {
-        process_t *tmp = cur_proc;
-        cur_proc = cur_proc->next;
-        free(tmp->proc);
-        free(tmp);
-      }
-  }
-
-#ifdef perfstat_clean_all_exists
-  perfstat_clean_all();
-#endif
+  cgroup_tree_t *tree = &our_stats->cgroups.tree;
+  int i;
 
-  if (self->out)
-    g_string_free(self->out, 1);
+  if (cgroup_open(tree) < 0)
+    return -1;
+  if (our_stats->cgroups.loop && tree->inotify_fd >= 0
+      && !evloop_add(our_stats->cgroups.loop, tree->inotify_fd, POLLIN, on_cgroups, our_stats))
+    tree->polled = 1;
+  for (i = 0; i < tree->nb; i++)
+    if (tree->cgroups[i].used && !cgroup_read(tree->cgroups + i, &tree->cgroups[i].data[our_stats->cgroups.odd]))
+      tree->cgroups[i].seen = 1;
+  return 0;
 }
 
-void set_global_freq(modPerf_stats_t *self, int type, unsigned int shift)
-{
+CALLTOTALBEGINFREQ(our_stats, cgroups)
+  cgroup_tree_t *tree = &our_stats->cgroups.tree;
+  cgroup_top_t top_cpu[NB_CGROUP_TOP+1], top_mem[NB_CGROUP_TOP+1], top_io[NB_CGROUP_TOP+1];
+  int nb_top_cpu = 0, nb_top_mem = 0, nb_top_io = 0, nb = 0;
+  TYPE_ULL cpu, io;
+  uchar_t ts = 1 - our_stats->cgroups.odd;
   int i;
-  TYPE_ULL mask = (TYPE_ULL)((0x0000000000000001<<shift)-1);
-  unsigned int freq_min = UINT_MAX, freq_min_std = UINT_MAX;
-  if (shift > 31)
+
+  if (cgroup_refresh(tree) < 0)
+    return -1;
+  our_stats->cgroups.odd = ts;
+
+  /* the root is the whole host, see the cpu_total and memory groups */
+  for (i = 0; i < tree->nb; i++)
     {
-      mask = UINT32_MAX;
-      shift = 31;
+      cgroup_t *c = tree->cgroups + i;
+      cgroup_stat_t *curr = &c->data[ts], *prev = &c->data[1 - ts];
+
+      if (!c->used || !c->depth || cgroup_read(c, curr) < 0)
+        continue;
+      nb++;
+      classTopCgroup(c, curr->memory, top_mem, &nb_top_mem);
+      /* a new cgroup has no rate until its next collect */
+      if (!c->seen)
+        {
+          *prev = *curr;
+          c->seen = 1;
+          continue;
+        }
+      cpu = DELTAMMBRULL(curr,prev,usage_usec);
+      io = DELTAMMBRULL(curr,prev,rbytes) + DELTAMMBRULL(curr,prev,wbytes);
+      if (cpu)
+        classTopCgroup(c, cpu, top_cpu, &nb_top_cpu);
+      if (io)
+        classTopCgroup(c, io, top_io, &nb_top_io);
     }
 
-  for (i=0; i< GROUP_MAX; i++)
-  {
-    if (!self->freq_data[i].setted)
+  g_string_append_printf(our_stats->out, SECOPEN(cgroups) FMTI(count) FMTSEP SECOPEN(cpu), nb);
+  for (i=0; i<nb_top_cpu; i++)
     {
-      self->freq_data[i].type = type;
-      self->freq_data[i].mask = mask;
-      self->freq_data[i].shift = shift;
+      cgroup_t *c = top_cpu[i].cgroup;
+      cgroup_stat_t *curr = &c->data[ts], *prev = &c->data[1 - ts];
+
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTSTR(cgroup) FMTSEP
+                 FMTDBL1(cpu_pct) FMTSEP
+                 FMTDBL1(user_pct) FMTSEP
+                 FMTDBL1(sys_pct) FMTSEP
+                 FMTULL(throttled_s) FMTSEP
+                 FMTDBL1(throttled_pct) FMTSEP
+                 FMTULL(pids)
+               SECCLOSE
+               ,
+                 (i) ? FMTSEP : "",
+                 i,
+                 c->path,
+                 100*DELTAMMBRDBL(curr,prev,usage_usec) / group_elapsed_us,
+                 100*DELTAMMBRDBL(curr,prev,user_usec) / group_elapsed_us,
+                 100*DELTAMMBRDBL(curr,prev,system_usec) / group_elapsed_us,
+                 PERSEC(DELTAMMBRULL(curr,prev,nr_throttled)),
+                 100*DELTAMMBRDBL(curr,prev,throttled_usec) / group_elapsed_us,
+                 curr->pids
+            );
     }
+  g_string_append(our_stats->out, SECCLOSE FMTSEP SECOPEN(mem));
+  for (i=0; i<nb_top_mem; i++)
+    {
+      cgroup_t *c = top_mem[i].cgroup;
+      cgroup_stat_t *curr = &c->data[ts], *prev = &c->data[1 - ts];
 
-    freq_min = (freq_min > self->freq_data[i].mask) ? (unsigned int)self->freq_data[i].mask : freq_min;
-    freq_min_std = (self->freq_data[i].type > 0 && freq_min_std > self->freq_data[i].mask) ? (unsigned int)self->freq_data[i].mask : freq_min_std;
-  }
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTSTR(cgroup) FMTSEP
+                 FMTULL(mem_mb) FMTSEP
+                 FMTULL(anon_mb) FMTSEP
+                 FMTULL(file_mb) FMTSEP
+                 FMTULL(shmem_mb) FMTSEP
+                 FMTULL(majfaults_s)
+               SECCLOSE
+               ,
+                 (i) ? FMTSEP : "",
+                 i,
+                 c->path,
+                 curr->memory >> 20,
+                 curr->anon >> 20,
+                 curr->file >> 20,
+                 curr->shmem >> 20,
+                 PERSEC(DELTAMMBRULL(curr,prev,pgmajfault))
+            );
+    }
+  g_string_append(our_stats->out, SECCLOSE FMTSEP SECOPEN(io));
+  for (i=0; i<nb_top_io; i++)
+    {
+      cgroup_t *c = top_io[i].cgroup;
+      cgroup_stat_t *curr = &c->data[ts], *prev = &c->data[1 - ts];
 
-  self->mask_freq = freq_min;
-  self->mask_freq_std = freq_min_std;
-}
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTSTR(cgroup) FMTSEP
+                 FMTULL(read_kb_s) FMTSEP
+                 FMTULL(write_kb_s) FMTSEP
+                 FMTULL(reads_s) FMTSEP
+                 FMTULL(writes_s)
+               SECCLOSE
+               ,
+                 (i) ? FMTSEP : "",
+                 i,
+                 c->path,
+                 PERSEC(DELTAMMBRULL(curr,prev,rbytes)) >> 10,
+                 PERSEC(DELTAMMBRULL(curr,prev,wbytes)) >> 10,
+                 PERSEC(DELTAMMBRULL(curr,prev,rios)),
+                 PERSEC(DELTAMMBRULL(curr,prev,wios))
+            );
+    }
+  g_string_append(our_stats->out, SECCLOSE SECCLOSE FMTSEP);
 
-void set_group_freq(modPerf_stats_t *self, GROUP_e group, int type, unsigned int shift)
-{
-  int i;
-  if (self->freq_data[group].setted)
-    return;
+CALLTOTALEND
 
-  self->freq_data[group].setted = 1;
+/******************************************************************************************************************
+ * irq : Linux interrupts and softirqs per cpu, the imbalance between the cpus and the top irqs of the devices,
+ * see irq.h
+ *****************************************************************************************************************/
+#define NB_IRQ_TOP 5
 
-  self->freq_data[group].type  = type;
-  if (shift > 31)
-  {
-    self->freq_data[group].mask = UINTMAX_MAX;
-    self->freq_data[group].shift = 31;
-  }
-  else
-  {
-    self->freq_data[group].shift = shift;
-    self->freq_data[group].mask  = (1ULL<<shift)-1ULL;
-  }
+typedef struct {
+  int row;
+  TYPE_ULL key;
+} irq_top_t;
 
-  unsigned int freq_min = UINT_MAX, freq_min_std = UINT_MAX;
-  for (i=0; i<GROUP_MAX; i++)
-  {
-    freq_min = (freq_min > self->freq_data[i].mask) ? (unsigned int)self->freq_data[i].mask : freq_min;
-    freq_min_std = (self->freq_data[i].type > 0 && freq_min_std > self->freq_data[i].mask) ? (unsigned int)self->freq_data[i].mask : freq_min_std;
-  }
+static void classTopIrq(int row, TYPE_ULL key, irq_top_t *top, int *nb_top)
+{
+  int i;
 
-  self->mask_freq = freq_min;
-  self->mask_freq_std = freq_min_std;
+  if (*nb_top == NB_IRQ_TOP && key <= top[NB_IRQ_TOP-1].key)
+    return;
+  for (i = *nb_top-1; i>=0 && top[i].key < key; i--)
+    {
+      top[i+1] = top[i];
+    }
+  top[i+1].row = row;
+  top[i+1].key = key;
+  if (*nb_top < NB_IRQ_TOP)
+      (*nb_top)++;
 }
 
-int standard(modPerf_stats_t *self, uint64_t tv_sec, char *sep)
+/* busiest cpu against the mean of the cpus, 1 when they are balanced */
+static double irq_imbalance(TYPE_ULL max, TYPE_ULL sum, int nb)
 {
-  int toprint = 0;
-  g_string_assign(self->out, "{");
-  if (self->freq_data[CPU_TOTAL_GROUP].type > 0 && (tv_sec & self->freq_data[CPU_TOTAL_GROUP].mask) == 0)
-  {
-    call_cpu_total(self);
-    toprint = 1;
-  }
-  if (self->freq_data[CPUS_GROUP].type > 0 && (tv_sec & self->freq_data[CPUS_GROUP].mask) == 0)
+  return (sum) ? (double)max * nb / sum : 1;
+}
+
+INITPROTO(our_stats, irq)
+{
+  if (irq_open(&our_stats->irq.interrupts) < 0 || irq_read(&our_stats->irq.interrupts) < 0)
+    return -1;
+  if (irq_open(&our_stats->irq.softirqs) < 0 || irq_read(&our_stats->irq.softirqs) < 0)
+    return -1;
+  return 0;
+}
+
+CALLTOTALBEGINFREQ(our_stats, irq)
+  irq_table_t *hw = &our_stats->irq.interrupts, *sw = &our_stats->irq.softirqs;
+  int rx = -1, tx = -1, timer = -1, nb = 0, max_irq_cpu = -1, max_rx_cpu = -1;
+  TYPE_ULL sum_irq = 0, sum_rx = 0, max_irq = 0, max_rx = 0, irq, net_rx;
+  irq_top_t top[NB_IRQ_TOP+1];
+  int nb_top = 0;
+  char *sep = "";
+  int c, i;
+
+  if (irq_read(hw) < 0 || irq_read(sw) < 0)
+    return -1;
+  irq_delta(hw, 1);
+  rx = irq_find(sw, "NET_RX");
+  tx = irq_find(sw, "NET_TX");
+  timer = irq_find(sw, "TIMER");
+
+  g_string_append(our_stats->out, SECOPEN(irq) SECOPEN(cpus));
+  for (c = 0; c < sw->ncpus; c++)
+    {
+      int cpu = sw->cpus[c];
+
+      /* only the cpus of the cpuset of the container */
+      if (our_stats->container.enabled && !cgroup_self_cpu(&our_stats->container.cgroup, cpu))
+        continue;
+
+      /* both files have a column per online cpu */
+      irq = (c < hw->ncpus && hw->cpus[c] == cpu) ? hw->cpu_delta[c] : 0;
+      net_rx = (rx >= 0) ? irq_cell_delta(sw, rx, c) : 0;
+      nb++;
+      sum_irq += irq;
+      sum_rx += net_rx;
+      if (max_irq_cpu < 0 || irq > max_irq)
+        {
+          max_irq = irq;
+          max_irq_cpu = cpu;
+        }
+      if (max_rx_cpu < 0 || net_rx > max_rx)
+        {
+          max_rx = net_rx;
+          max_rx_cpu = cpu;
+        }
+
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTULL(irq_s) FMTSEP
+                 FMTULL(net_rx_s) FMTSEP
+                 FMTULL(net_tx_s) FMTSEP
+                 FMTULL(timer_s)
+               SECCLOSE
+               ,
+                 sep,
+                 cpu,
+                 PERSEC(irq),
+                 PERSEC(net_rx),
+                 PERSEC((tx >= 0) ? irq_cell_delta(sw, tx, c) : 0),
+                 PERSEC((timer >= 0) ? irq_cell_delta(sw, timer, c) : 0)
+            );
+      sep = FMTSEP;
+    }
+
+  g_string_append_printf(our_stats->out,
+           SECCLOSE FMTSEP
+           SECOPEN(imbalance)
+             FMTDBL2(irq) FMTSEP
+             FMTI(irq_cpu) FMTSEP
+             FMTDBL2(net_rx) FMTSEP
+             FMTI(net_rx_cpu)
+           SECCLOSE FMTSEP
+           SECOPEN(top)
+           ,
+             irq_imbalance(max_irq, sum_irq, nb),
+             max_irq_cpu,
+             irq_imbalance(max_rx, sum_rx, nb),
+             max_rx_cpu);
+
+  for (i = 0; i < hw->nrows; i++)
+    if (hw->row_delta[i])
+      classTopIrq(i, hw->row_delta[i], top, &nb_top);
+  for (i = 0; i < nb_top; i++)
+    {
+      irq_row_t *row = hw->rows + top[i].row;
+      TYPE_ULL max = 0;
+      int max_cpu = 0;
+
+      for (c = 0; c < hw->ncpus; c++)
+        if (irq_cell_delta(hw, top[i].row, c) > max)
+          {
+            max = irq_cell_delta(hw, top[i].row, c);
+            max_cpu = hw->cpus[c];
+          }
+
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTSTR(irq) FMTSEP
+                 FMTSTR(desc) FMTSEP
+                 FMTULL(count_s) FMTSEP
+                 FMTI(cpu) FMTSEP
+                 FMTDBL1(cpu_pct)
+               SECCLOSE
+               ,
+                 (i) ? FMTSEP : "",
+                 i,
+                 row->name,
+                 row->desc,
+                 PERSEC(top[i].key),
+                 max_cpu,
+                 100.0 * max / top[i].key
+            );
+    }
+  g_string_append(our_stats->out, SECCLOSE SECCLOSE FMTSEP);
+
+CALLTOTALEND
+
+/******************************************************************************************************************
+ * sched : Linux run queue latency per cpu, the time the tasks waited for a cpu, see schedstat.h
+ *****************************************************************************************************************/
+INITPROTO(our_stats, sched)
+{
+  if (schedstat_open(&our_stats->sched.stat) < 0 || schedstat_read(&our_stats->sched.stat) < 0)
+    return -1;
+  return 0;
+}
+
+CALLTOTALBEGINFREQ(our_stats, sched)
+  schedstat_t *st = &our_stats->sched.stat;
+  TYPE_ULL run = 0, delay = 0, slices = 0;
+  char *sep = "";
+  int i;
+
+  if (schedstat_read(st) < 0)
+    return -1;
+
+  g_string_append(our_stats->out, SECOPEN(sched) SECOPEN(cpus));
+  for (i = 0; i < st->nb; i++)
+    {
+      schedstat_cpu_t *curr = st->cpus[st->odd] + i, *prev = st->cpus[1 - st->odd] + i;
+
+      /* only the cpus of the cpuset of the container */
+      if (our_stats->container.enabled && !cgroup_self_cpu(&our_stats->container.cgroup, curr->cpu))
+        continue;
+
+      run += DELTAMMBRULL(curr,prev,run_ns) / 1000;
+      delay += DELTAMMBRULL(curr,prev,delay_ns) / 1000;
+      slices += DELTAMMBRULL(curr,prev,slices);
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTULL(delay_us_s) FMTSEP
+                 FMTULL(run_us_s) FMTSEP
+                 FMTULL(timeslices_s) FMTSEP
+                 FMTULL(delay_avg_us)
+               SECCLOSE
+               ,
+                 sep,
+                 curr->cpu,
+                 PERSEC(DELTAMMBRULL(curr,prev,delay_ns) / 1000),
+                 PERSEC(DELTAMMBRULL(curr,prev,run_ns) / 1000),
+                 PERSEC(DELTAMMBRULL(curr,prev,slices)),
+                 DELTAMMBRULL(curr,prev,delay_ns) / 1000 / NONZERO(DELTAMMBRULL(curr,prev,slices))
+            );
+      sep = FMTSEP;
+    }
+
+  /* 1000000 us/s of delay is one task waiting all the time */
+  g_string_append_printf(our_stats->out,
+           SECCLOSE FMTSEP
+             FMTULL(delay_us_s) FMTSEP
+             FMTULL(run_us_s) FMTSEP
+             FMTULL(timeslices_s) FMTSEP
+             FMTULL(delay_avg_us)
+           SECCLOSE FMTSEP
+           ,
+             PERSEC(delay),
+             PERSEC(run),
+             PERSEC(slices),
+             delay / NONZERO(slices));
+
+CALLTOTALEND
+
+/******************************************************************************************************************
+ * numa : Linux memory and allocations of each NUMA node, with the busy time of its cpus summed by the cpus
+ * group, see numa.h
+ *****************************************************************************************************************/
+INITPROTO(our_stats, numa)
+{
+  if (numa_open(&our_stats->numa.nodes) < 0)
+    return -1;
+  return numa_read(&our_stats->numa.nodes, our_stats->numa.odd);
+}
+
+CALLTOTALBEGINFREQ(our_stats, numa)
+  numa_t *n = &our_stats->numa.nodes;
+  uchar_t ts = 1 - our_stats->numa.odd;
+  int i;
+
+  if (numa_read(n, ts) < 0)
+    return -1;
+  our_stats->numa.odd = ts;
+
+  g_string_append(our_stats->out, SECOPEN(numa));
+  for (i = 0; i < n->nb; i++)
+    {
+      numa_node_t *node = n->nodes + i;
+      numa_stat_t *curr = &node->data[ts], *prev = &node->data[1 - ts];
+
+      g_string_append_printf(our_stats->out,
+               "%s"
+               SECOPEN(%d)
+                 FMTULL(total_mb) FMTSEP
+                 FMTULL(free_mb) FMTSEP
+                 FMTULL(used_mb) FMTSEP
+                 FMTULL(file_mb) FMTSEP
+                 FMTULL(anon_mb) FMTSEP
+                 FMTULL(hit_s) FMTSEP
+                 FMTULL(miss_s) FMTSEP
+                 FMTULL(foreign_s) FMTSEP
+                 FMTULL(interleave_s) FMTSEP
+                 FMTULL(local_s) FMTSEP
+                 FMTULL(other_node_s) FMTSEP
+                 FMTI(cpus)
+               ,
+                 (i) ? FMTSEP : "",
+                 node->node,
+                 curr->total_kb >> 10,
+                 curr->free_kb >> 10,
+                 curr->used_kb >> 10,
+                 curr->file_kb >> 10,
+                 curr->anon_kb >> 10,
+                 PERSEC(DELTAMMBRULL(curr,prev,hit)),
+                 PERSEC(DELTAMMBRULL(curr,prev,miss)),
+                 PERSEC(DELTAMMBRULL(curr,prev,foreign)),
+                 PERSEC(DELTAMMBRULL(curr,prev,interleave)),
+                 PERSEC(DELTAMMBRULL(curr,prev,local)),
+                 PERSEC(DELTAMMBRULL(curr,prev,other)),
+                 node->ncpus
+            );
+      /* only when the cpus group was collected since the previous collect */
+      if (node->ticks)
+        g_string_append_printf(our_stats->out,
+                 FMTSEP
+                 FMTDBL1(busy_pct) FMTSEP
+                 FMTDBL1(user_pct) FMTSEP
+                 FMTDBL1(sys_pct)
+                 ,
+                   100.0 * node->busy / node->ticks,
+                   100.0 * node->user / node->ticks,
+                   100.0 * node->sys / node->ticks
+              );
+      g_string_append(our_stats->out, SECCLOSE);
+      node->ticks = node->busy = node->user = node->sys = 0;
+    }
+  g_string_append(our_stats->out, SECCLOSE FMTSEP);
+
+CALLTOTALEND
+
+/******************************************************************************************************************
+ * selfstat : cost of the collectors of jsonperfmon itself, see selfstat.h
+ *****************************************************************************************************************/
+static const char *selfstat_names[SELF_MAX] = {
+  "cpu_total", "cpu", "memory_total", "pagingspace", "disk", "filesystems", "nfs",
+  "netinterface", "fcstat", "processes", "pressure", "cgroups", "irq", "sched",
+  "numa", "window", "emit"
+};
+
+/* the probes only run when the self group is initialized */
+#define PROBE(s, m, call)                                            \
+  do {                                                               \
+    if ((s)->freq_data[SELF_GROUP].initialized)                      \
+    {                                                                \
+      selfstat_mark_t mark_;                                         \
+      size_t len_ = (s)->out->len;                                   \
+      selfstat_begin(&mark_);                                        \
+      call;                                                          \
+      selfstat_end(&mark_, &(s)->selfstat.stats[SELF_ ## m]);        \
+      if ((s)->out->len > len_)                                      \
+        (s)->selfstat.stats[SELF_ ## m].total_out +=                 \
+          (s)->out->len - len_;                                      \
+    }                                                                \
+    else                                                             \
+      call;                                                          \
+  } while (0)
+
+INITPROTO(our_stats, selfstat)
+{
+  memset(our_stats->selfstat.stats, 0, sizeof(our_stats->selfstat.stats));
+  our_stats->selfstat.ticks = our_stats->scheduler.ticks;
+  our_stats->selfstat.overruns = our_stats->scheduler.overruns;
+  our_stats->selfstat.skipped = our_stats->scheduler.skipped;
+  our_stats->selfstat.emitted = 0;
+  return 0;
+}
+
+CALLTOTALBEGINFREQ(our_stats, selfstat)
+  scheduler_t *sched = &our_stats->scheduler;
+  char *sep = "";
+  int i;
+
+  g_string_append_printf(our_stats->out,
+           SECOPEN(jsonperfmon)
+             FMTULL(ticks) FMTSEP
+             FMTULL(overruns) FMTSEP
+             FMTULL(skipped) FMTSEP
+             FMTULL(emitted_bytes_s) FMTSEP
+             SECOPEN(collectors)
+           ,
+             (TYPE_ULL)(sched->ticks - our_stats->selfstat.ticks),
+             (TYPE_ULL)(sched->overruns - our_stats->selfstat.overruns),
+             (TYPE_ULL)(sched->skipped - our_stats->selfstat.skipped),
+             PERSEC(our_stats->selfstat.emitted));
+  our_stats->selfstat.ticks = sched->ticks;
+  our_stats->selfstat.overruns = sched->overruns;
+  our_stats->selfstat.skipped = sched->skipped;
+  our_stats->selfstat.emitted = 0;
+
+  for (i = 0; i < SELF_MAX; i++)
+  {
+    selfstat_t *st = &our_stats->selfstat.stats[i];
+
+    /* only the parts called during the period */
+    if (!st->calls)
+      continue;
+
+    g_string_append_printf(our_stats->out,
+             "%s\"%s\":{"
+               FMTULL(calls) FMTSEP
+               FMTULL(wall_us) FMTSEP
+               FMTULL(cpu_us) FMTSEP
+               FMTULL(opens) FMTSEP
+               FMTULL(reads) FMTSEP
+               FMTULL(read_bytes) FMTSEP
+               FMTDBL1(wall_us_p50) FMTSEP
+               FMTDBL1(wall_us_p99) FMTSEP
+               FMTDBL1(cpu_us_p99) FMTSEP
+               "\"wall_us_sk\":\""
+             ,
+               sep, selfstat_names[i],
+               (TYPE_ULL)st->calls,
+               (TYPE_ULL)st->wall_ns / 1000,
+               (TYPE_ULL)st->cpu_ns / 1000,
+               (TYPE_ULL)st->io.opens,
+               (TYPE_ULL)st->io.reads,
+               (TYPE_ULL)st->io.bytes,
+               sketch_quantile(&st->wall_us, 0.50),
+               sketch_quantile(&st->wall_us, 0.99),
+               sketch_quantile(&st->cpu_us, 0.99));
+    sketch_append(our_stats->out, &st->wall_us);
+    g_string_append(our_stats->out, "\",\"cpu_us_sk\":\"");
+    sketch_append(our_stats->out, &st->cpu_us);
+    g_string_append(our_stats->out, "\"" SECCLOSE);
+    selfstat_reset(st);
+    sep = FMTSEP;
+  }
+  g_string_append(our_stats->out, SECCLOSE SECCLOSE FMTSEP);
+
+CALLTOTALEND
+
+/******************************************************************************************************************
+ * window : the groups are collected at their period but printed once per
+ * window with the min, max and average of their rates and percents
+ *****************************************************************************************************************/
+typedef struct {
+  modPerf_stats_t *self;
+  GROUP_e group;
+  int idx;
+  int emit;
+  const char *src;
+  size_t cursor;
+  size_t extra;         /* bytes the summaries will add at the emit */
+} window_ctx_t;
+
+/* bound of the summary of a field: three keys with the longest %f of a double
+ * rate, and the quantiles with a sketch whose buckets are at most the samples */
+#define WINDOW_SUMMARY_LEN(lkey)        (3*((lkey) + 48))
+#define WINDOW_SKETCH_LEN(lkey, count)  (4*((lkey) + 48) + 48 + ((count) < SKETCH_BUCKETS ? (count) : SKETCH_BUCKETS)*24)
+
+/* The json of the emit tick is longer than the one of the other ticks, out
+ * and window_out are grown to it beforehand so a tick past the first ones
+ * does not allocate whatever the tick the window ends.
+ */
+static void window_reserve(GString *out, size_t len)
+{
+  size_t keep = out->len;
+
+  if (len < out->allocated_len)
+    return;
+  /* doubled as the GString does, the json of the next ticks varies a little */
+  g_string_set_size(out, 2*len);
+  g_string_truncate(out, keep);
+}
+
+static inline int window_summarized(const char *key, size_t lkey)
+{
+  return (lkey > 4 && !memcmp(key + lkey - 4, "_pct", 4))
+      || (lkey > 3 && !memcmp(key + lkey - 3, "_us", 3))
+      || (lkey > 2 && !memcmp(key + lkey - 2, "_s", 2));
+}
+
+/* a key without dot selects the attribute in all groups, ie time_avg_us */
+static int window_sketched(modPerf_stats_t *self, const jsonscan_field_t *field)
+{
+  int i;
+  for (i = 0; i < self->nsketch_keys; i++)
+  {
+    if (strchr(self->sketch_keys[i], '.'))
+    {
+      if (jsonscan_match(self->sketch_keys[i], field->path))
+        return 1;
+    }
+    else if (!strncmp(self->sketch_keys[i], field->key, field->lkey) && !self->sketch_keys[i][field->lkey])
+      return 1;
+  }
+  return 0;
+}
+
+static int window_grow(modPerf_stats_t *self, GROUP_e group, int nb)
+{
+  window_field_t *f = (window_field_t *)realloc(self->windows[group].fields, sizeof(window_field_t)*nb);
+
+  if (!f)
+    return -1;
+  memset(f + self->windows[group].nb, 0, sizeof(window_field_t)*(nb - self->windows[group].nb));
+  self->windows[group].fields = f;
+  self->windows[group].nb = nb;
+  return 0;
+}
+
+static int window_field(const jsonscan_field_t *field, void *data)
+{
+  window_ctx_t *ctx = (window_ctx_t *)data;
+  modPerf_stats_t *self = ctx->self;
+  window_field_t *f;
+  uint32_t hash;
+  double v;
+
+  if (!window_summarized(field->key, field->lkey))
+    return 0;
+
+  /* only the first scan of the group or twice its fields reach it */
+  if (ctx->idx == self->windows[ctx->group].nb
+      && window_grow(self, ctx->group, (self->windows[ctx->group].nb) ? 2*self->windows[ctx->group].nb : 64))
+    return 1;
+
+  f = self->windows[ctx->group].fields + ctx->idx++;
+  hash = jsonscan_hash(field->path, field->lpath);
+  v = strtod(field->value, NULL);
+
+  /* the sketch of a slot is kept for the next field sketched at this position */
+  if (f->hash != hash)
+  {
+    f->hash = hash;
+    f->count = 0;
+    f->sketched = window_sketched(self, field);
+    if (f->sketched && !f->sketch)
+      f->sketch = (sketch_t *)malloc(sizeof(sketch_t));
+    if (!f->sketch)
+      f->sketched = 0;
+  }
+  if (!f->count)
+  {
+    f->sum = 0;
+    f->min = f->max = v;
+    if (f->sketched)
+      sketch_reset(f->sketch);
+  }
+  f->count++;
+  f->sum += v;
+  if (v < f->min) f->min = v;
+  if (v > f->max) f->max = v;
+  if (f->sketched)
+    sketch_add(f->sketch, v);
+  ctx->extra += WINDOW_SUMMARY_LEN(field->lkey) + ((f->sketched) ? WINDOW_SKETCH_LEN(field->lkey, f->count) : 0);
+
+  if (ctx->emit)
+  {
+    /* the last value is kept as is and followed by the summary */
+    size_t end = (size_t)(field->value + field->lvalue - ctx->src);
+    int prec = memchr(field->value, '.', field->lvalue) ? 1 : 0;
+
+    g_string_append_len(self->out, ctx->src + ctx->cursor, end - ctx->cursor);
+    g_string_append_printf(self->out,
+             FMTSEP "\"%.*s_min\":%.*f"
+             FMTSEP "\"%.*s_max\":%.*f"
+             FMTSEP "\"%.*s_avg\":%.1f",
+               (int)field->lkey, field->key, prec, f->min,
+               (int)field->lkey, field->key, prec, f->max,
+               (int)field->lkey, field->key, f->sum / f->count);
+    if (f->sketched)
+    {
+      g_string_append_printf(self->out,
+               FMTSEP "\"%.*s_p50\":%.*f"
+               FMTSEP "\"%.*s_p90\":%.*f"
+               FMTSEP "\"%.*s_p99\":%.*f"
+               FMTSEP "\"%.*s_sk\":\"",
+                 (int)field->lkey, field->key, prec, sketch_quantile(f->sketch, 0.50),
+                 (int)field->lkey, field->key, prec, sketch_quantile(f->sketch, 0.90),
+                 (int)field->lkey, field->key, prec, sketch_quantile(f->sketch, 0.99),
+                 (int)field->lkey, field->key);
+      sketch_append(self->out, f->sketch);
+      g_string_append(self->out, "\"");
+    }
+    ctx->cursor = end;
+    f->count = 0;
+  }
+  return 0;
+}
+
+/* Called after the collect of a group, its json is in out from start. It
+ * returns 0 if the group has to be removed from the json as the window is
+ * not over.
+ */
+static int window_process(modPerf_stats_t *self, GROUP_e group, size_t start, uint64_t t_ms)
+{
+  TYPE_ULL period = GROUP_PERIOD(self, group);
+  TYPE_ULL window = (TYPE_ULL)self->window * 1000;
+  window_ctx_t ctx = { self, group, 0, 0, NULL, 0, 0 };
+
+  if (!window || period >= window)
+    return 1;
+
+  /* the collect at t_ms closes the window ]end-window, end] */
+  ctx.emit = ((t_ms - 1) / window != (t_ms - 1 + period) / window);
+
+  /* the top processes are ranked again at each collect, a position is not
+   * the same process over the window: the last ranking is printed as is */
+  if (group == PROCESSES_GROUP)
+  {
+    if (!ctx.emit)
+    {
+      self->window_extra += self->out->len - start;
+      g_string_truncate(self->out, start);
+    }
+    return ctx.emit;
+  }
+
+  if (!ctx.emit)
+  {
+    jsonscan(self->out->str + start, self->out->len - start, window_field, &ctx);
+    /* twice the fields of the group for the components to come */
+    if (2*ctx.idx > self->windows[group].nb)
+      window_grow(self, group, 2*ctx.idx);
+    window_reserve(self->window_out, self->out->len - start + 1);
+    self->window_extra += self->out->len - start + ctx.extra;
+    g_string_truncate(self->out, start);
+    return 0;
+  }
+
+  g_string_truncate(self->window_out, 0);
+  g_string_append_len(self->window_out, self->out->str + start, self->out->len - start);
+  g_string_truncate(self->out, start);
+  ctx.src = self->window_out->str;
+  jsonscan(self->window_out->str, self->window_out->len, window_field, &ctx);
+  g_string_append_len(self->out, ctx.src + ctx.cursor, self->window_out->len - ctx.cursor);
+  return 1;
+}
+
+/******************************************************************************************************************
+ * burst : threshold rules on the produced fields shorten the period of some
+ * groups until the fields are back under the release threshold
+ *****************************************************************************************************************/
+static int parse_period(const char *str, int *type, TYPE_ULL *period_ms, TYPE_ULL *phase_ms);
+
+static int burst_field(const jsonscan_field_t *field, void *data)
+{
+  modPerf_stats_t *self = (modPerf_stats_t *)data;
+  int i;
+  double v = strtod(field->value, NULL);
+
+  for (i = 0; i < self->nburst_rules; i++)
+  {
+    burst_rule_t *rule = self->burst_rules + i;
+    if (!jsonscan_match(rule->pattern, field->path))
+      continue;
+    rule->seen = 1;
+    if (rule->op * (v - rule->on) > 0)
+      rule->beyond_on = 1;
+    if (rule->op * (v - rule->off) > 0)
+      rule->beyond_off = 1;
+  }
+  return 0;
+}
+
+/* the thresholds accept a number of cpus factor, ie "2*ncpus" */
+static double burst_value(const char *str, char **end)
+{
+  double v = strtod(str, end);
+  if (!strncmp(*end, "*ncpus", 6))
+  {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    v *= (ncpus > 0) ? ncpus : 1;
+    *end += 6;
+  }
+  return v;
+}
+
+/* "<path><op><on>[/<off>]:<groups>[:<period>]" ie "disks.*.busy_pct>90/70:sp:1s" */
+static int burst_parse(modPerf_stats_t *self, char *str, const char *groupsopt)
+{
+  burst_rule_t *rule = self->burst_rules + self->nburst_rules;
+  char *op = strpbrk(str, "<>"), *end, *grp, opc;
+  int typ;
+  TYPE_ULL phase_ms;
+
+  if (self->nburst_rules == BURST_RULES_MAX || !op || op == str)
+    return -1;
+
+  memset(rule, 0, sizeof(*rule));
+  opc = *op;
+  rule->op = (opc == '>') ? 1 : -1;
+  *op = '\0';
+  rule->pattern = str;
+  rule->on = rule->off = burst_value(op + 1, &end);
+  if (*end == '/')
+    rule->off = burst_value(end + 1, &end);
+  if (*end != ':')
+    return -1;
+
+  for (grp = end + 1; *grp && *grp != ':'; grp++)
+  {
+    char *g = strchr(groupsopt, *grp);
+    if (!g)
+      return -1;
+    rule->groups |= 1U << (g - groupsopt);
+  }
+  rule->period_ms = 1000;
+  if (*grp == ':' && (parse_period(grp + 1, &typ, &rule->period_ms, &phase_ms) < 0 || !rule->period_ms))
+    return -1;
+
+  /* the whole rule for the logs, the pattern is cut at the operator */
+  *op = opc;
+  rule->text = strdup(str);
+  *op = '\0';
+  if (!rule->text)
+    return -1;
+  self->nburst_rules++;
+  return 0;
+}
+
+/* evaluation of the rules on the json of a group just collected */
+static void burst_scan(modPerf_stats_t *self, size_t start)
+{
+  if (self->nburst_rules)
+    jsonscan(self->out->str + start, self->out->len - start, burst_field, self);
+}
+
+/* Called at the end of each tick, it updates the state of the rules then
+ * the period of the groups.
+ */
+static void burst_update(modPerf_stats_t *self, uint64_t t_ms)
+{
+  int i, g;
+
+  for (i = 0; i < self->nburst_rules; i++)
+  {
+    burst_rule_t *rule = self->burst_rules + i;
+
+    if (rule->active && t_ms - rule->since_ms >= (uint64_t)self->burst_max * 1000)
+    {
+      rule->active = 0;
+      rule->latched = 1;
+      syslog(LOG_NOTICE, "burst %s stopped after %us", rule->text, self->burst_max);
+    }
+    else if (rule->seen && rule->active && !rule->beyond_off)
+    {
+      rule->active = 0;
+      syslog(LOG_NOTICE, "burst %s released after %" PRIu64 "s", rule->text, (t_ms - rule->since_ms) / 1000);
+    }
+    else if (rule->seen && !rule->active)
+    {
+      if (!rule->beyond_off)
+        rule->latched = 0;
+      if (!rule->latched && rule->beyond_on)
+      {
+        rule->active = 1;
+        rule->since_ms = t_ms;
+        syslog(LOG_NOTICE, "burst %s started", rule->text);
+      }
+    }
+    rule->seen = rule->beyond_on = rule->beyond_off = 0;
+  }
+
+  for (g = 0; g < GROUP_MAX; g++)
+  {
+    self->freq_data[g].burst_ms = 0;
+    for (i = 0; i < self->nburst_rules; i++)
+    {
+      burst_rule_t *rule = self->burst_rules + i;
+      if (rule->active && (rule->groups & (1U << g)) && rule->period_ms < GROUP_PERIOD(self, g))
+        self->freq_data[g].burst_ms = rule->period_ms;
+    }
+  }
+}
+
+static int burst_active(modPerf_stats_t *self)
+{
+  int i, n = 0;
+  for (i = 0; i < self->nburst_rules; i++)
+    n += self->burst_rules[i].active;
+  return n;
+}
+
+/******************************************************************************************************************
+ * budget : beyond the cpu time allowed per tick the groups of low priority
+ * are degraded, first to cheaper variants, then to longer periods
+ *****************************************************************************************************************/
+
+/* period multiplier of each group (GROUP_e order) at each level, the level 1
+ * only uses the cheaper variants: process names from stat, no nfs statvfs */
+static const unsigned int budget_levels[BUDGET_LEVELS][GROUP_MAX] = {
+  /* t  u  m  s  n  i   p  P  g  q  k  N  j */
+  {  1, 1, 1, 1, 1, 1,  1, 1, 1, 1, 1, 1, 1 },
+  {  1, 1, 1, 1, 1, 1,  1, 1, 1, 1, 1, 1, 1 },
+  {  1, 1, 1, 1, 1, 1,  4, 1, 1, 1, 1, 1, 1 },
+  {  1, 1, 1, 4, 4, 4,  8, 1, 4, 4, 1, 4, 1 },
+  {  1, 4, 1, 8, 8, 8, 16, 1, 8, 8, 4, 8, 4 }
+};
+
+static void budget_apply(modPerf_stats_t *self, int level, uint64_t t_ms)
+{
+  int g;
+
+  syslog(LOG_NOTICE, "cpu budget of %" PRIu64 "us per tick %s (%" PRIu64 "us), degradation level %d",
+         self->budget.limit_ns / 1000, (level > self->budget.level) ? "exceeded" : "recovered",
+         self->budget.avg_ns / 1000, level);
+  self->budget.level = level;
+  self->budget.since_ms = t_ms;
+  for (g = 0; g < GROUP_MAX; g++)
+    self->freq_data[g].stretch = budget_levels[level][g];
+#ifdef linux
+  getprocs_names = (level == 0);
+#endif
+}
+
+/* Called at the end of each tick with its cpu time. The level changes at
+ * most once per window so the effect of a change is measured before the
+ * next one, it goes back up with half of the budget used.
+ */
+static void budget_update(modPerf_stats_t *self, uint64_t t_ms, uint64_t cpu_ns)
+{
+  uint64_t sec = t_ms / 1000, cpu = 0, ticks = 0;
+  unsigned int i, w = self->budget.window;
+
+  if (!self->budget.limit_ns)
+    return;
+
+  /* the first tick starts the window */
+  if (!self->budget.since_ms)
+  {
+    self->budget.since_ms = t_ms;
+    self->budget.slot = sec;
+  }
+
+  /* the seconds without tick are emptied */
+  if (sec - self->budget.slot > w)
+    self->budget.slot = sec - w;
+  while (self->budget.slot < sec)
+  {
+    self->budget.slot++;
+    self->budget.cpu_ns[self->budget.slot % w] = 0;
+    self->budget.ticks[self->budget.slot % w] = 0;
+  }
+  self->budget.cpu_ns[sec % w] += cpu_ns;
+  self->budget.ticks[sec % w]++;
+
+  for (i = 0; i < w; i++)
+  {
+    cpu += self->budget.cpu_ns[i];
+    ticks += self->budget.ticks[i];
+  }
+  self->budget.avg_ns = cpu / NONZERO(ticks);
+
+  if (t_ms - self->budget.since_ms < (uint64_t)w * 1000)
+    return;
+  if (self->budget.avg_ns > self->budget.limit_ns && self->budget.level < BUDGET_LEVELS - 1)
+    budget_apply(self, self->budget.level + 1, t_ms);
+  else if (self->budget.avg_ns < self->budget.limit_ns / 2 && self->budget.level > 0)
+    budget_apply(self, self->budget.level - 1, t_ms);
+}
+
+/* letters of the degraded groups */
+static void budget_groups(modPerf_stats_t *self, char *letters)
+{
+  const char *groupsopt = GROUPS_OPT;
+  int g;
+
+  for (g = 0; g < GROUP_MAX; g++)
+    if (self->freq_data[g].stretch > 1
+        || (self->budget.level && (g == DISKS_GROUP || g == PROCESSES_GROUP)))
+      *letters++ = groupsopt[g];
+  *letters = '\0';
+}
+
+/******************************************************************************************************************
+ * global
+ *****************************************************************************************************************/
+
+/* the time of the replayed tick or the monotonic clock */
+static inline uint64_t stats_clock(modPerf_stats_t *self)
+{
+  return (self->clock_ns) ? self->clock_ns : scheduler_clock();
+}
+
+/* measures the real interval since the previous collect of the group */
+static void group_clock(modPerf_stats_t *self, GROUP_e group)
+{
+  uint64_t now = stats_clock(self);
+
+  self->freq_data[group].elapsed_us = (now - self->freq_data[group].last_ns) / 1000;
+  self->freq_data[group].last_ns = now;
+}
+
+static void append_scheduler(modPerf_stats_t *self)
+{
+  scheduler_t *s = &self->scheduler;
+
+  g_string_append_printf(self->out,
+           SECOPEN(scheduler)
+             FMTULL(tick_ms) FMTSEP
+             FMTULL(ticks) FMTSEP
+             FMTULL(overruns) FMTSEP
+             FMTULL(skipped) FMTSEP
+             FMTULL(collect_us) FMTSEP
+             FMTULL(collect_avg_us) FMTSEP
+             FMTULL(collect_max_us) FMTSEP
+             FMTI(bursts)
+           ,
+             self->tick_ms,
+             (TYPE_ULL)s->ticks,
+             (TYPE_ULL)s->overruns,
+             (TYPE_ULL)s->skipped,
+             (TYPE_ULL)s->collect_ns / 1000,
+             (TYPE_ULL)(s->collect_total_ns / NONZERO(s->collected)) / 1000,
+             (TYPE_ULL)s->collect_max_ns / 1000,
+             burst_active(self));
+
+  if (self->budget.limit_ns)
+  {
+    char letters[GROUP_MAX + 1];
+
+    budget_groups(self, letters);
+    g_string_append_printf(self->out,
+             FMTSEP SECOPEN(budget)
+               FMTULL(limit_us) FMTSEP
+               FMTULL(cpu_avg_us) FMTSEP
+               FMTI(level) FMTSEP
+               FMTSTR(degraded)
+             SECCLOSE
+             ,
+               (TYPE_ULL)self->budget.limit_ns / 1000,
+               (TYPE_ULL)self->budget.avg_ns / 1000,
+               self->budget.level,
+               letters);
+  }
+  g_string_append(self->out, SECCLOSE FMTSEP);
+}
+
+FREEPROTO(our_stats, cpu)
+{
+  free(our_stats->cpu.previous);
+  our_stats->cpu.previous = NULL;
+}
+
+FREEPROTO(our_stats, disk)
+{
+  free(our_stats->disk.previous);
+  free(our_stats->disk.next);
+  our_stats->disk.previous = our_stats->disk.next = NULL;
+  our_stats->disk.nb = our_stats->disk.max = 0;
+}
+
+FREEPROTO(our_stats, netinterface)
+{
+  free(our_stats->netinterface.previous);
+  free(our_stats->netinterface.next);
+  our_stats->netinterface.previous = our_stats->netinterface.next = NULL;
+  our_stats->netinterface.nb = our_stats->netinterface.max = 0;
+}
+
+FREEPROTO(our_stats, fcstat)
+{
+  free(our_stats->fcstat.previous);
+  free(our_stats->fcstat.next);
+  our_stats->fcstat.previous = our_stats->fcstat.next = NULL;
+  our_stats->fcstat.nb = our_stats->fcstat.max = 0;
+}
+
+FREEPROTO(our_stats, processes)
+{
+  process_t *cur_proc;
+
+  for (cur_proc = our_stats->processes.str_procs_first; cur_proc; )
+    {
+      process_t *tmp = cur_proc;
+      cur_proc = cur_proc->next;
+      free(tmp);
+    }
+  our_stats->processes.str_procs_first = NULL;
+  for (cur_proc = our_stats->processes.free; cur_proc; )
+    {
+      process_t *tmp = cur_proc;
+      cur_proc = cur_proc->next;
+      free(tmp);
+    }
+  our_stats->processes.free = NULL;
+  free(our_stats->processes.entries);
+  our_stats->processes.entries = NULL;
+  our_stats->processes.nb_entries = 0;
+}
+
+/* the pressure fds holding a trigger stay open */
+FREEPROTO(our_stats, pressure)
+{
+  int r;
+  for (r = 0; r < PRESSURE_MAX; r++)
+    if (!our_stats->pressure.res[r].trigger)
+      pressure_close(&our_stats->pressure.res[r]);
+}
+
+FREEPROTO(our_stats, cgroups)
+{
+  if (our_stats->cgroups.tree.polled)
+    evloop_del(our_stats->cgroups.loop, our_stats->cgroups.tree.inotify_fd);
+  our_stats->cgroups.tree.polled = 0;
+  cgroup_close(&our_stats->cgroups.tree);
+}
+
+FREEPROTO(our_stats, irq)
+{
+  irq_close(&our_stats->irq.interrupts);
+  irq_close(&our_stats->irq.softirqs);
+}
+
+FREEPROTO(our_stats, sched)
+{
+  schedstat_close(&our_stats->sched.stat);
+}
+
+FREEPROTO(our_stats, numa)
+{
+  numa_close(&our_stats->numa.nodes);
+}
+
+/* first snapshot of a group, the first rates are computed against it */
+void group_init(modPerf_stats_t *self, GROUP_e group)
+{
+  if (self->freq_data[group].initialized)
+    return;
+
+  switch (group)
+  {
+    case CPU_TOTAL_GROUP:
+      init_cpu_total(self);
+      break;
+    case CPUS_GROUP:
+      init_cpu(self);
+      break;
+    case MEMORY_GROUP:
+      init_memory_total(self);
+      init_pagingspace(self);
+      break;
+    case DISKS_GROUP:
+      init_disk(self);
+      init_filesystems(self);
+      break;
+    case NFS_GROUP:
+      init_nfs(self);
+      break;
+    case ADAPTERS_GROUP:
+      init_netinterface(self);
+      init_fcstat(self);
+      break;
+    case PROCESSES_GROUP:
+      init_processes(self);
+      break;
+    case PRESSURE_GROUP:
+      init_pressure(self);
+      break;
+    case CGROUPS_GROUP:
+      init_cgroups(self);
+      break;
+    case IRQ_GROUP:
+      init_irq(self);
+      break;
+    case SCHED_GROUP:
+      init_sched(self);
+      break;
+    case NUMA_GROUP:
+      init_numa(self);
+      break;
+    case SELF_GROUP:
+      init_selfstat(self);
+      break;
+    default:
+      break;
+  }
+  self->freq_data[group].initialized = 1;
+  self->freq_data[group].last_ns = stats_clock(self);
+}
+
+void group_free(modPerf_stats_t *self, GROUP_e group)
+{
+  if (!self->freq_data[group].initialized)
+    return;
+
+  switch (group)
+  {
+    case CPUS_GROUP:
+      free_cpu(self);
+      break;
+    case DISKS_GROUP:
+      free_disk(self);
+      break;
+    case ADAPTERS_GROUP:
+      free_netinterface(self);
+      free_fcstat(self);
+      break;
+    case PROCESSES_GROUP:
+      free_processes(self);
+      break;
+    case PRESSURE_GROUP:
+      free_pressure(self);
+      break;
+    case CGROUPS_GROUP:
+      free_cgroups(self);
+      break;
+    case IRQ_GROUP:
+      free_irq(self);
+      break;
+    case SCHED_GROUP:
+      free_sched(self);
+      break;
+    case NUMA_GROUP:
+      free_numa(self);
+      break;
+    default:
+      break;
+  }
+  self->freq_data[group].initialized = 0;
+}
+
+void stats_allocate(modPerf_stats_t *self)
+{
+  int i;
+
+  if (self->container.enabled && cgroup_self_open(&self->container.cgroup) < 0)
+  {
+    syslog(LOG_ERR, "unable to find the cgroup v2 of jsonperfmon, -C is ignored");
+    cgroup_self_close(&self->container.cgroup);
+    self->container.enabled = 0;
+  }
+
+  self->out = g_string_sized_new(1024);
+  self->window_out = g_string_sized_new(1024);
+
+  for (i=0; i< GROUP_MAX; i++)
+    if (self->freq_data[i].type)
+      group_init(self, (GROUP_e)i);
+
+  /* the triggers are needed even without the pressure group */
+  if (self->pressure.triggers[PRESSURE_CPU] || self->pressure.triggers[PRESSURE_MEMORY] || self->pressure.triggers[PRESSURE_IO])
+    init_pressure(self);
+}
+
+void stats_initialize(modPerf_stats_t *self, char *hostname, int lhostname)
+{
+  int i;
+
+  self->cpu.previous = NULL;
+  self->disk.previous = self->disk.next = NULL;
+  self->disk.nb = self->disk.max = 0;
+  self->netinterface.previous = self->netinterface.next = NULL;
+  self->netinterface.nb = self->netinterface.max = 0;
+  self->fcstat.previous = self->fcstat.next = NULL;
+  self->fcstat.nb = self->fcstat.max = 0;
+  self->processes.str_procs_first = NULL;
+  self->processes.free = NULL;
+  self->processes.entries = NULL;
+  self->processes.nb_entries = 0;
+  self->pressure.odd = 0;
+  for (i=0; i< PRESSURE_MAX; i++)
+  {
+    self->pressure.res[i].fd = -1;
+    self->pressure.res[i].trigger = NULL;
+    self->pressure.triggers[i] = NULL;
+  }
+  cgroup_init(&self->cgroups.tree, CGROUP_DEPTH);
+  self->cgroups.odd = 0;
+  irq_init(&self->irq.interrupts, IRQ_INTERRUPTS);
+  irq_init(&self->irq.softirqs, IRQ_SOFTIRQS);
+  schedstat_init(&self->sched.stat);
+  numa_init(&self->numa.nodes);
+  self->numa.odd = 0;
+  memset(&self->container, 0, sizeof(self->container));
+  self->container.cgroup.fd_stat = self->container.cgroup.fd_max = self->container.cgroup.fd_cpuset = -1;
+  self->history = NULL;
+  self->stream = NULL;
+  self->clock_ns = 0;
+  self->sep = "";
+  self->control.fd = -1;
+  self->window = 0;
+  self->window_out = NULL;
+  self->nsketch_keys = 0;
+  self->memory_total.nkeys = 0;
+  self->nburst_rules = 0;
+  self->burst_max = 300;
+  memset(&self->budget, 0, sizeof(self->budget));
+  self->budget.window = 60;
+
+  for (i=0; i< GROUP_MAX; i++)
+  {
+    self->windows[i].fields = NULL;
+    self->windows[i].nb = 0;
+    self->freq_data[i].setted = 0;
+    self->freq_data[i].type = 0;
+    self->freq_data[i].period_ms = 0;
+    self->freq_data[i].phase_ms = 0;
+    self->freq_data[i].burst_ms = 0;
+    self->freq_data[i].stretch = 1;
+    self->freq_data[i].initialized = 0;
+    self->freq_data[i].last_ns = 0;
+    self->freq_data[i].elapsed_us = 0;
+  }
+
+  self->tick_ms = 1000;
+  self->lhostname = (((size_t)lhostname)>sizeof(self->hostname)) ? sizeof(self->hostname) : (size_t)lhostname;
+  memcpy(self->hostname, hostname, self->lhostname);
+}
+
+void stats_free(modPerf_stats_t *self)
+{
+  int i;
+
+  for (i=0; i< GROUP_MAX; i++)
+    group_free(self, (GROUP_e)i);
+  for (i=0; i< PRESSURE_MAX; i++)
+    pressure_close(&self->pressure.res[i]);
+  cgroup_self_close(&self->container.cgroup);
+
+#ifdef perfstat_clean_all_exists
+  perfstat_clean_all();
+#endif
+
+  if (self->out)
+    g_string_free(self->out, 1);
+  if (self->window_out)
+    g_string_free(self->window_out, 1);
+  for (i=0; i< GROUP_MAX; i++)
+  {
+    int j;
+    for (j = 0; j < self->windows[i].nb; j++)
+      free(self->windows[i].fields[j].sketch);
+    free(self->windows[i].fields);
+  }
+
+  history_close(self->history);
+  for (i=0; i< self->nburst_rules; i++)
+    free((char *)self->burst_rules[i].text);
+}
+
+static TYPE_ULL gcd(TYPE_ULL a, TYPE_ULL b)
+{
+  while (b)
+  {
+    TYPE_ULL r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/* the scheduler wakes up at the greatest common divisor of the periods,
+ * of the phases and of the periods of the burst rules
+ */
+static void set_tick(modPerf_stats_t *self)
+{
+  TYPE_ULL tick = 0;
+  int i;
+
+  for (i=0; i< GROUP_MAX; i++)
+    if (self->freq_data[i].type)
+    {
+      tick = gcd(self->freq_data[i].period_ms, tick);
+      tick = gcd(self->freq_data[i].phase_ms, tick);
+    }
+  for (i=0; i< self->nburst_rules; i++)
+    tick = gcd(self->burst_rules[i].period_ms, tick);
+
+  self->tick_ms = (tick) ? tick : 1000;
+}
+
+/* "<n>" means a period of 2^(n-1) seconds, "<n>s" a period in seconds and
+ * "<n>ms" in milliseconds, the sign gives the type of output, 0 disables.
+ * A "@<m>" suffix delays the collects by a phase of m seconds (or "@<m>ms").
+ */
+static int parse_period(const char *str, int *type, TYPE_ULL *period_ms, TYPE_ULL *phase_ms)
+{
+  char *end;
+  long val = strtol(str, &end, 10);
+
+  *type = (val<0)?-1:((val>0)?1:0);
+  val = labs(val);
+  *phase_ms = 0;
+
+  if (!strncmp(end, "ms", 2))
+  {
+    *period_ms = (TYPE_ULL)val;
+    end += 2;
+  }
+  else if (*end == 's')
+  {
+    *period_ms = (TYPE_ULL)val * 1000;
+    end++;
+  }
+  else
+    *period_ms = (val > 32) ? (1000ULL << 31) : (val) ? (1000ULL << (val - 1)) : 0;
+
+  if (*end == '@')
+  {
+    long phase = strtol(end + 1, &end, 10);
+    if (phase < 0)
+      return -1;
+    if (!strncmp(end, "ms", 2))
+    {
+      *phase_ms = (TYPE_ULL)phase;
+      end += 2;
+    }
+    else
+    {
+      *phase_ms = (TYPE_ULL)phase * 1000;
+      if (*end == 's')
+        end++;
+    }
+  }
+  if (*end)
+    return -1;
+
+  if (!*period_ms)
+    *type = 0;
+  else
+    *phase_ms %= *period_ms;
+  return 0;
+}
+
+void set_global_freq(modPerf_stats_t *self, int type, TYPE_ULL period_ms, TYPE_ULL phase_ms)
+{
+  int i;
+
+  for (i=0; i< GROUP_MAX; i++)
+  {
+    if (!self->freq_data[i].setted)
+    {
+      self->freq_data[i].type = type;
+      self->freq_data[i].period_ms = period_ms;
+      self->freq_data[i].phase_ms = phase_ms;
+    }
+  }
+  set_tick(self);
+}
+
+void set_group_freq(modPerf_stats_t *self, GROUP_e group, int type, TYPE_ULL period_ms, TYPE_ULL phase_ms)
+{
+  self->freq_data[group].setted = 1;
+  self->freq_data[group].type  = type;
+  self->freq_data[group].period_ms = period_ms;
+  self->freq_data[group].phase_ms = phase_ms;
+  set_tick(self);
+}
+
+/* Adds to the phase of the groups with a period of several seconds a whole
+ * number of seconds derived from the hostname and the group, so the hosts
+ * of a fleet and the groups of a host do not collect on the same second.
+ */
+void set_jitter(modPerf_stats_t *self)
+{
+  uint32_t hash = jsonscan_hash(self->hostname, self->lhostname);
+  int i;
+
+  for (i=0; i< GROUP_MAX; i++)
+  {
+    TYPE_ULL period = self->freq_data[i].period_ms;
+    uint32_t seed = (hash ^ (uint32_t)i) * 2654435761U;
+
+    if (!self->freq_data[i].type || period < 2000 || period % 1000)
+      continue;
+    self->freq_data[i].phase_ms = (self->freq_data[i].phase_ms + (seed >> 8) % (period / 1000) * 1000) % period;
+  }
+  set_tick(self);
+}
+
+/* the self group only measures the replay itself, it is left out of it */
+static inline int group_due(modPerf_stats_t *self, GROUP_e group, uint64_t t_ms)
+{
+  if (self->clock_ns && group == SELF_GROUP)
+    return 0;
+  return self->freq_data[group].type && (t_ms - self->freq_data[group].phase_ms) % GROUP_PERIOD(self, group) == 0;
+}
+
+/* the timestamp is in seconds, the milliseconds are added for the sub-second periods */
+static void append_timestamp(modPerf_stats_t *self, uint64_t t_ms, char *sep)
+{
+  if (self->tick_ms % 1000)
+    g_string_append_printf(self->out, "\"server\":\"%s\",\"timestamp\":%" PRIu64 ",\"timestamp_ms\":%" PRIu64 "}%s\n",
+                           self->hostname, t_ms / 1000, t_ms, sep);
+  else
+    g_string_append_printf(self->out, "\"server\":\"%s\",\"timestamp\":%" PRIu64 "}%s\n", self->hostname, t_ms / 1000, sep);
+}
+
+/* collect of a group, its json is appended to out */
+static int collect(modPerf_stats_t *self, GROUP_e group)
+{
+  uint64_t start = scheduler_clock();
+  int ret = 0;
+
+  group_clock(self, group);
+  switch (group)
+  {
+    case CPU_TOTAL_GROUP:
+      PROBE(self, cpu_total, call_cpu_total(self));
+      break;
+    case CPUS_GROUP:
+      PROBE(self, cpu, call_cpu(self));
+      break;
+    case MEMORY_GROUP:
+      PROBE(self, memory_total, call_memory_total(self));
+      PROBE(self, pagingspace, call_pagingspace(self));
+      break;
+    case DISKS_GROUP:
+      PROBE(self, disk, call_disk(self));
+      PROBE(self, filesystems, call_filesystems(self));
+      break;
+    case NFS_GROUP:
+      PROBE(self, nfs, ret = call_nfs(self));
+      break;
+    case ADAPTERS_GROUP:
+      PROBE(self, netinterface, call_netinterface(self));
+      PROBE(self, fcstat, call_fcstat(self));
+      break;
+    case PROCESSES_GROUP:
+      PROBE(self, processes, call_processes(self));
+      break;
+    case PRESSURE_GROUP:
+      PROBE(self, pressure, call_pressure(self));
+      break;
+    case CGROUPS_GROUP:
+      PROBE(self, cgroups, call_cgroups(self));
+      break;
+    case IRQ_GROUP:
+      PROBE(self, irq, call_irq(self));
+      break;
+    case SCHED_GROUP:
+      PROBE(self, sched, call_sched(self));
+      break;
+    case NUMA_GROUP:
+      PROBE(self, numa, call_numa(self));
+      break;
+    case SELF_GROUP:
+      call_selfstat(self);
+      break;
+    default:
+      break;
+  }
+  self->freq_data[group].collect_ns = scheduler_clock() - start;
+  return ret;
+}
+
+/* the burst rules and the window on the json of a group just collected */
+static int post_collect(modPerf_stats_t *self, GROUP_e group, size_t start, uint64_t t_ms)
+{
+  burst_scan(self, start);
+  return window_process(self, group, start, t_ms);
+}
+
+int standard(modPerf_stats_t *self, uint64_t t_ms, char *sep)
+{
+  int i, toprint = 0;
+  size_t start;
+  g_string_assign(self->out, "{");
+  self->window_extra = 0;
+  for (i=0; i< GROUP_MAX; i++)
+  {
+    if (self->freq_data[i].type > 0 && group_due(self, (GROUP_e)i, t_ms))
+    {
+      start = self->out->len;
+      collect(self, (GROUP_e)i);
+      PROBE(self, window, toprint |= post_collect(self, (GROUP_e)i, start, t_ms));
+    }
+  }
+  append_scheduler(self);
+  append_timestamp(self, t_ms, sep);
+  window_reserve(self->out, self->out->len + self->window_extra + 256);
+  return toprint;
+}
+
+int group(modPerf_stats_t *self, GROUP_e group, uint64_t t_ms, char *sep)
+{
+  int ret;
+
+  g_string_assign(self->out, "{");
+  self->window_extra = 0;
+  if (collect(self, group))
+    return -1;
+  PROBE(self, window, ret = post_collect(self, group, 1, t_ms));
+  if (!ret)
+  {
+    window_reserve(self->out, self->out->len + self->window_extra + 256);
+    return -1;
+  }
+  append_scheduler(self);
+  append_timestamp(self, t_ms, sep);
+  return 0;
+}
+
+/* Out of cycle json of a set of groups (1 << GROUP_e) for the PSI triggers
+ * and the control socket. It is never summarized by the window, tag is an
+ * optional member added before the scheduler.
+ */
+int snapshot(modPerf_stats_t *self, uint32_t groups, const char *tag, uint64_t t_ms, char *sep)
+{
+  int i;
+
+  g_string_assign(self->out, "{");
+  for (i=0; i< GROUP_MAX; i++)
+    if (self->freq_data[i].initialized && (groups & (1U << i)))
+      collect(self, (GROUP_e)i);
+
+  if (tag)
+    g_string_append_printf(self->out, "%s" FMTSEP, tag);
+  append_scheduler(self);
+  append_timestamp(self, t_ms, sep);
+  return 0;
+}
+
+/* send the json built in out to syslog and to the history if any */
+static void sink(modPerf_stats_t *self)
+{
+  if (self->stream)
+    fwrite(self->out->str, 1, self->out->len, self->stream);
+  else
+    syslog(LOG_INFO, "%.*s", (int)self->out->len, self->out->str);
+  if (self->history)
+    history_row_json(self->history, self->out->str, self->out->len);
+}
+
+void emit(modPerf_stats_t *self)
+{
+  PROBE(self, emit, sink(self));
+  self->selfstat.emitted += self->out->len;
+}
+
+/******************************************************************************************************************
+ * main
+ *****************************************************************************************************************/
+#include <signal.h>
+#include <sys/time.h>
+
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "jsonperfmon"
+#endif
+
+/* collects and emits the groups due at t_ms, the daemon and the replay share it */
+static void tick(modPerf_stats_t *self, uint64_t t_ms)
+{
+  int i;
+
+  if (self->history)
+    history_row_begin(self->history, (int64_t)t_ms);
+
+  /* This is the single json */
+  if (standard(self, t_ms, self->sep))
+  {
+    /* With at least a group in the json */
+    emit(self);
+  }
+  for (i=0; i<GROUP_MAX; i++)
+  {
+    if (self->freq_data[i].type < 0 && group_due(self, (GROUP_e)i, t_ms))
+    {
+      /* This is the group level json */
+      if (!group(self, (GROUP_e)i, t_ms, self->sep))
+      {
+        /* This group produce a json */
+        emit(self);
+      }
+    }
+  }
+
+  if (self->history)
+    history_row_commit(self->history);
+
+  burst_update(self, t_ms);
+}
+
+static void on_tick(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  modPerf_stats_t *self = (modPerf_stats_t *)data;
+  uint64_t cpu_ns;
+
+  (void)fd;
+  (void)events;
+  if (scheduler_tick(&self->scheduler))
+  {
+    cpu_ns = selfstat_cpu();
+    tick(self, self->scheduler.now_ns / 1000000ULL);
+    scheduler_done(&self->scheduler);
+    budget_update(self, self->scheduler.now_ns / 1000000ULL, selfstat_cpu() - cpu_ns);
+  }
+  evloop_timer_set(loop, scheduler_next(&self->scheduler));
+}
+
+#if !defined(_AIX)
+/* a block device was added or removed, it is listed at the next collect of the disks */
+static void on_uevents(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  (void)loop;
+  (void)fd;
+  (void)events;
+  (void)data;
+  perfunix_disk_uevents();
+}
+#endif
+
+/* a PSI trigger fired */
+static void on_trigger(evloop_t *loop, int fd, uint32_t events, void *data)
+{
+  static const uint32_t related[PRESSURE_MAX] = {
+    (1U << CPU_TOTAL_GROUP) | (1U << CPUS_GROUP) | (1U << PROCESSES_GROUP) | (1U << PRESSURE_GROUP) | (1U << CGROUPS_GROUP)
+      | (1U << IRQ_GROUP) | (1U << SCHED_GROUP),
+    (1U << MEMORY_GROUP) | (1U << PROCESSES_GROUP) | (1U << PRESSURE_GROUP) | (1U << CGROUPS_GROUP)
+      | (1U << NUMA_GROUP),
+    (1U << DISKS_GROUP) | (1U << PROCESSES_GROUP) | (1U << PRESSURE_GROUP) | (1U << CGROUPS_GROUP)
+  };
+  modPerf_stats_t *self = (modPerf_stats_t *)data;
+  uint64_t t_ms = scheduler_realtime() / 1000000ULL;
+  char tag[256];
+  int r;
+
+  (void)loop;
+  (void)events;
+  for (r = 0; r < PRESSURE_MAX && self->pressure.res[r].fd != fd; r++)
+    ;
+  if (r == PRESSURE_MAX)
+    return;
+
+  snprintf(tag, sizeof(tag), SECOPEN(trigger) FMTSTR(resource) FMTSEP FMTSTR(threshold) SECCLOSE,
+           pressure_names[r], self->pressure.res[r].trigger);
+
+  if (self->history)
+    history_row_begin(self->history, (int64_t)t_ms);
+  snapshot(self, related[r], tag, t_ms, self->sep);
+  emit(self);
+  if (self->history)
+    history_row_commit(self->history);
+}
+
+/* groups given by their option letters, "A" for all of them */
+static uint32_t control_groups(const char *letters)
+{
+  uint32_t groups = 0;
+  const char *groupsopt = GROUPS_OPT, *g;
+
+  if (!letters || !strcmp(letters, "A"))
+    return (1U << GROUP_MAX) - 1;
+  for (; *letters; letters++)
   {
-    call_cpu(self);
-    toprint = 1;
+    if (!(g = strchr(groupsopt, *letters)))
+      return 0;
+    groups |= 1U << (g - groupsopt);
   }
-  if (self->freq_data[MEMORY_GROUP].type > 0 && (tv_sec & self->freq_data[MEMORY_GROUP].mask) == 0)
+  return groups;
+}
+
+static void control_error(modPerf_stats_t *self, int fd, const char *msg)
+{
+  g_string_assign(self->out, "{");
+  g_string_append_printf(self->out, FMTSTR(error) "}", msg);
+  control_reply(&self->control, fd, self->out->str, self->out->len);
+}
+
+static void control_timing(modPerf_stats_t *self, int fd)
+{
+  const char *groupsopt = GROUPS_OPT;
+  char *sep = "";
+  int i;
+
+  g_string_assign(self->out, "{" SECOPEN(groups));
+  for (i=0; i< GROUP_MAX; i++)
   {
-    call_memory_total(self);
-    call_pagingspace(self);
-    toprint = 1;
+    g_string_append_printf(self->out,
+             "%s\"%c\":{"
+               FMTI(type) FMTSEP
+               FMTULL(period_ms) FMTSEP
+               FMTULL(phase_ms) FMTSEP
+               FMTULL(burst_ms) FMTSEP
+               FMTULL(elapsed_us) FMTSEP
+               FMTULL(collect_us)
+             SECCLOSE
+             ,
+               sep, groupsopt[i],
+               self->freq_data[i].type,
+               self->freq_data[i].period_ms,
+               self->freq_data[i].phase_ms,
+               self->freq_data[i].burst_ms,
+               self->freq_data[i].elapsed_us,
+               (TYPE_ULL)self->freq_data[i].collect_ns / 1000);
+    sep = FMTSEP;
   }
-  if (self->freq_data[DISKS_GROUP].type > 0 && (tv_sec & self->freq_data[DISKS_GROUP].mask) == 0)
+  g_string_append(self->out, SECCLOSE FMTSEP);
+  append_scheduler(self);
+  append_timestamp(self, scheduler_realtime() / 1000000ULL, "");
+  control_reply(&self->control, fd, self->out->str, self->out->len);
+}
+
+/* Requests of the control socket, one per line:
+ *   snapshot [<groups>]        json of the groups now, ie "snapshot ps"
+ *   period <groups> <n>        same syntax as the options, 0 stops the periodic
+ *                              collect but the group stays available to snapshot
+ *   timing                     periods and cost of the collects
+ */
+static void on_control(control_t *ctl, int fd, char *line, void *data)
+{
+  modPerf_stats_t *self = (modPerf_stats_t *)data;
+  char *save = NULL;
+  char *cmd = strtok_r(line, " \t", &save);
+  char *arg1 = strtok_r(NULL, " \t", &save);
+  char *arg2 = strtok_r(NULL, " \t", &save);
+  uint32_t groups = control_groups(arg1);
+  int i;
+
+  if (!cmd)
+    return;
+
+  if (!strcmp(cmd, "snapshot"))
   {
-    call_disk(self);
-    call_filesystems(self);
-    toprint = 1;
+    if (!groups)
+    {
+      control_error(self, fd, "unknown group");
+      return;
+    }
+    /* a group without period is initialized at its first request */
+    for (i=0; i< GROUP_MAX; i++)
+      if (groups & (1U << i))
+        group_init(self, (GROUP_e)i);
+    snapshot(self, groups, NULL, scheduler_realtime() / 1000000ULL, "");
+    control_reply(ctl, fd, self->out->str, self->out->len);
   }
-  if (self->freq_data[NFS_GROUP].type > 0 && (tv_sec & self->freq_data[NFS_GROUP].mask) == 0)
+  else if (!strcmp(cmd, "period"))
   {
-    call_nfs(self);
-    toprint = 1;
+    int typ;
+    TYPE_ULL period_ms, phase_ms;
+
+    if (!groups || !arg2 || parse_period(arg2, &typ, &period_ms, &phase_ms) < 0)
+    {
+      control_error(self, fd, "usage: period <groups> <n>");
+      return;
+    }
+    for (i=0; i< GROUP_MAX; i++)
+      if (groups & (1U << i))
+      {
+        self->freq_data[i].type = typ;
+        self->freq_data[i].period_ms = period_ms;
+        self->freq_data[i].phase_ms = phase_ms;
+        if (typ)
+          group_init(self, (GROUP_e)i);
+      }
+    set_tick(self);
+    scheduler_set_tick(&self->scheduler, self->tick_ms * 1000000ULL);
+    evloop_timer_set(ctl->loop, scheduler_next(&self->scheduler));
+    syslog(LOG_NOTICE, "period of %s set to %s", arg1, arg2);
+    control_timing(self, fd);
   }
-  if (self->freq_data[ADAPTERS_GROUP].type > 0 && (tv_sec & self->freq_data[ADAPTERS_GROUP].mask) == 0)
+  else if (!strcmp(cmd, "timing"))
+    control_timing(self, fd);
+  else
+    control_error(self, fd, "unknown command, use snapshot, period or timing");
+}
+
+/* Options of the command line, the config file given by -c is read over
+ * them at start and at each SIGHUP.
+ */
+typedef struct {
+  int argc;
+  char **argv;
+  char *config;
+  char *history_dir;     /* -H, -K, -S, -r and -X are only used at start */
+  unsigned int keep_hours;
+  unsigned int keep_mb;
+  char *control_path;
+  char *root;
+  char *replay;
+  char *disks;           /* -d, -D and -e select the block devices of Linux */
+  char *disks_exclude;
+  int partitions;
+  int jitter;
+  int groups;            /* at least a group is given */
+  char *args;            /* copy of the command line and content of the */
+  char *buf;             /* config file, the configuration points into them */
+  modPerf_stats_t *self;
+} options_t;
+
+#define CONFIG_ARGS_MAX 256
+
+/* The config file holds an option per line as on the command line, ie
+ * "-p 60s@15" or "-T memory:some 150000 1000000", the lines starting by
+ * '#' are comments. It returns the number of arguments put in av from 1.
+ */
+static int config_read(const char *path, char **buf, char **av, int max)
+{
+  FILE *f = fopen(path, "r");
+  struct stat st;
+  char *line, *save = NULL;
+  size_t n;
+  int ac = 1;
+
+  if (!f)
+    return -1;
+  if (fstat(fileno(f), &st) < 0 || (*buf = (char *)malloc((size_t)st.st_size + 1)) == NULL)
   {
-    call_netinterface(self);
-    call_fcstat(self);
-    toprint = 1;
+    fclose(f);
+    return -1;
   }
-  if (self->freq_data[PROCESSES_GROUP].type > 0 && (tv_sec & self->freq_data[PROCESSES_GROUP].mask) == 0)
+  n = fread(*buf, 1, (size_t)st.st_size, f);
+  fclose(f);
+  (*buf)[n] = '\0';
+
+  for (line = strtok_r(*buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
   {
-    call_processes(self);
-    toprint = 1;
+    char *arg, *end;
+
+    line += strspn(line, " \t\r");
+    if (!*line || *line == '#')
+      continue;
+    if (*line != '-' || ac + 2 >= max)
+      return -1;
+
+    arg = line + strcspn(line, " \t\r");
+    if (*arg)
+    {
+      *arg++ = '\0';
+      arg += strspn(arg, " \t");
+    }
+    for (end = arg + strlen(arg); end > arg && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'); end--)
+      ;
+    *end = '\0';
+
+    av[ac++] = line;
+    if (*arg)
+      av[ac++] = arg;
   }
-  g_string_append_printf(self->out, "\"server\":\"%s\",\"timestamp\":%ld}%s\n", self->hostname, tv_sec, sep);
-  return toprint;
+  av[ac] = NULL;
+  return ac;
 }
 
-int group(modPerf_stats_t *self, GROUP_e group, uint64_t tv_sec, char *sep)
+/* It returns -1 on an invalid option, 1 if the usage is requested */
+static int parse_options(modPerf_stats_t *self, options_t *opts, int argc, char *argv[], int from_file)
 {
-  g_string_assign(self->out, "{");
-  switch (group)
+  const char *groupsopt = GROUPS_OPT;
+  int opt, grp;
+
+  /* the options are parsed several times */
+#ifdef __GLIBC__
+  optind = 0;
+#else
+  optind = 1;
+#endif
+  while ((opt = getopt(argc, argv, "A:t:u:m:s:n:i:p:P:g:q:k:N:j:G:CW:Q:M:d:D:eH:K:S:c:r:X:JB:b:L:T:Rh?")) != -1)
   {
-    case CPU_TOTAL_GROUP:
-      call_cpu_total(self);
+    int typ = 0;
+    TYPE_ULL period_ms = 0, phase_ms = 0;
+    if (strchr(groupsopt, opt) || opt == 'A')
+    {
+      if (parse_period(optarg, &typ, &period_ms, &phase_ms) < 0)
+      {
+        fprintf(stderr, "invalid period -%c %s\n", opt, optarg);
+        return -1;
+      }
+    }
+    switch (opt) {
+    case 'A':
+      set_global_freq(self, typ, period_ms, phase_ms);
+      opts->groups = 1;
       break;
-    case CPUS_GROUP:
-      call_cpu(self);
+    case 't':
+      /* fall through */
+    case 'u':
+      /* fall through */
+    case 'm':
+      /* fall through */
+    case 's':
+      /* fall through */
+    case 'n':
+      /* fall through */
+    case 'i':
+      /* fall through */
+    case 'p':
+      /* fall through */
+    case 'P':
+      /* fall through */
+    case 'g':
+      /* fall through */
+    case 'q':
+      /* fall through */
+    case 'k':
+      /* fall through */
+    case 'N':
+      /* fall through */
+    case 'j':
+      /* with cases above, groupsopt will contain opt */
+      for (grp = 0; grp < GROUP_MAX && opt != groupsopt[grp]; grp++)
+        ;
+      set_group_freq(self, (GROUP_e)grp, typ, period_ms, phase_ms);
+      opts->groups = 1;
       break;
-    case MEMORY_GROUP:
-      call_memory_total(self);
-      call_pagingspace(self);
+    case 'G':
+      if ((self->cgroups.tree.depth = atoi(optarg)) < 1)
+      {
+        fprintf(stderr, "invalid cgroup depth %s\n", optarg);
+        return -1;
+      }
       break;
-    case DISKS_GROUP:
-      call_disk(self);
-      call_filesystems(self);
+    case 'C':
+      self->container.enabled = 1;
       break;
-    case NFS_GROUP:
-      if (call_nfs(self))
+    case 'W':
+      self->window = (unsigned int)abs(atoi(optarg));
+      break;
+    case 'Q':
+      {
+        char *key, *save = NULL;
+        for (key = strtok_r(optarg, ",", &save); key && self->nsketch_keys < SKETCH_KEYS_MAX; key = strtok_r(NULL, ",", &save))
+          self->sketch_keys[self->nsketch_keys++] = key;
+      }
+      break;
+    case 'M':
+      {
+        char *key, *save = NULL;
+        int k;
+        for (key = strtok_r(optarg, ",", &save); key; key = strtok_r(NULL, ",", &save))
+        {
+          if ((k = memkeys_find(key)) < 0)
+          {
+            fprintf(stderr, "unknown memory key %s\n", key);
+            return -1;
+          }
+          if (self->memory_total.nkeys < MEMKEY_MAX)
+            self->memory_total.keys[self->memory_total.nkeys++] = k;
+        }
+      }
+      break;
+    case 'd':
+      opts->disks = optarg;
+      break;
+    case 'D':
+      opts->disks_exclude = optarg;
+      break;
+    case 'e':
+      opts->partitions = 1;
+      break;
+    case 'H':
+      opts->history_dir = optarg;
+      break;
+    case 'K':
+      {
+        char *end;
+        opts->keep_hours = (unsigned int)strtoul(optarg, &end, 10);
+        if (*end == '/')
+          opts->keep_mb = (unsigned int)strtoul(end + 1, &end, 10);
+        if (*end)
+        {
+          fprintf(stderr, "invalid history retention %s\n", optarg);
+          return -1;
+        }
+      }
+      break;
+    case 'S':
+      opts->control_path = optarg;
+      break;
+    case 'c':
+      if (!from_file)
+        opts->config = optarg;
+      break;
+    case 'r':
+      opts->root = optarg;
+      break;
+    case 'X':
+      opts->replay = optarg;
+      break;
+    case 'J':
+      opts->jitter = 1;
+      break;
+    case 'B':
+      if (burst_parse(self, optarg, groupsopt) < 0)
+      {
+        fprintf(stderr, "invalid burst rule %s\n", optarg);
         return -1;
+      }
       break;
-    case ADAPTERS_GROUP:
-      call_netinterface(self);
-      call_fcstat(self);
+    case 'b':
+      self->burst_max = (unsigned int)abs(atoi(optarg));
       break;
-    case PROCESSES_GROUP:
-      call_processes(self);
+    case 'L':
+      {
+        char *end;
+        double ms = strtod(optarg, &end);
+        if (*end == '/')
+          self->budget.window = (unsigned int)strtoul(end + 1, &end, 10);
+        if (*end || ms < 0 || !self->budget.window || self->budget.window > BUDGET_SLOTS)
+        {
+          fprintf(stderr, "invalid cpu budget %s\n", optarg);
+          return -1;
+        }
+        self->budget.limit_ns = (uint64_t)(ms * 1000000);
+      }
       break;
-    default:
+    case 'T':
+      {
+        char *trigger = strchr(optarg, ':');
+        for (grp = 0; trigger && grp < PRESSURE_MAX && strncmp(optarg, pressure_names[grp], trigger - optarg); grp++)
+          ;
+        if (!trigger || grp == PRESSURE_MAX)
+        {
+          fprintf(stderr, "invalid pressure trigger %s\n", optarg);
+          return -1;
+        }
+        self->pressure.triggers[grp] = trigger + 1;
+      }
       break;
+    case 'R':
+      self->sep = "\n";
+      break;
+    case 'h':
+    case '?':
+    default:
+      return (from_file) ? -1 : 1;
+    }
   }
-  g_string_append_printf(self->out, "\"server\":\"%s\",\"timestamp\":%ld}%s\n", self->hostname, tv_sec, sep);
   return 0;
 }
 
-/******************************************************************************************************************
- * main
- *****************************************************************************************************************/
-int go_on = 1;
+/* The command line then the config file. As getopt and the parsers modify
+ * the arguments, a copy of the command line is parsed each time.
+ */
+static int configure(modPerf_stats_t *self, options_t *opts)
+{
+  char *av[CONFIG_ARGS_MAX], *p;
+  size_t len = 0;
+  int ac, i, ret;
 
-#include <signal.h>
-#include <sys/time.h>
+  if (opts->argc >= CONFIG_ARGS_MAX)
+    return -1;
+  for (i = 0; i < opts->argc; i++)
+    len += strlen(opts->argv[i]) + 1;
+  if ((opts->args = (char *)malloc(len)) == NULL)
+    return -1;
+  for (p = opts->args, i = 0; i < opts->argc; i++)
+  {
+    av[i] = strcpy(p, opts->argv[i]);
+    p += strlen(p) + 1;
+  }
+  av[i] = NULL;
+  if ((ret = parse_options(self, opts, opts->argc, av, 0)) != 0)
+    return ret;
 
-#ifndef PACKAGE_NAME
-#define PACKAGE_NAME "jsonperfmon"
+  if (opts->config)
+  {
+    av[0] = opts->argv[0];
+    if ((ac = config_read(opts->config, &opts->buf, av, CONFIG_ARGS_MAX)) < 0)
+    {
+      fprintf(stderr, "unable to read the config file %s\n", opts->config);
+      return -1;
+    }
+    if ((ret = parse_options(self, opts, ac, av, 1)) != 0)
+      return ret;
+  }
+
+  if (!opts->groups)
+    return 1;
+  if (opts->jitter)
+    set_jitter(self);
+  set_tick(self);
+  return 0;
+}
+
+static int same_str(const char *a, const char *b)
+{
+  return (!a || !b) ? a == b : !strcmp(a, b);
+}
+
+/* SIGHUP: the options are read again and applied to the running stats. Only
+ * the groups whose period changed are initialized or freed, the others keep
+ * their previous snapshot so their rates go on without a gap.
+ */
+static void reconfigure(options_t *opts, evloop_t *loop)
+{
+  modPerf_stats_t *self = opts->self;
+  modPerf_stats_t *cfg = (modPerf_stats_t *)calloc(1, sizeof(modPerf_stats_t));
+  options_t next;
+  int i, j, r;
+
+  if (!cfg)
+    return;
+  memset(&next, 0, sizeof(next));
+  next.argc = opts->argc;
+  next.argv = opts->argv;
+  next.self = self;
+  stats_initialize(cfg, self->hostname, (int)self->lhostname);
+
+  if (configure(cfg, &next) != 0)
+  {
+    syslog(LOG_ERR, "invalid configuration, the running one is kept");
+    stats_free(cfg);
+    free(cfg);
+    free(next.args);
+    free(next.buf);
+    return;
+  }
+
+  for (i=0; i< GROUP_MAX; i++)
+  {
+    if (self->freq_data[i].type == cfg->freq_data[i].type
+        && self->freq_data[i].period_ms == cfg->freq_data[i].period_ms
+        && self->freq_data[i].phase_ms == cfg->freq_data[i].phase_ms)
+      continue;
+    self->freq_data[i].type = cfg->freq_data[i].type;
+    self->freq_data[i].period_ms = cfg->freq_data[i].period_ms;
+    self->freq_data[i].phase_ms = cfg->freq_data[i].phase_ms;
+    if (self->freq_data[i].type)
+      group_init(self, (GROUP_e)i);
+    else
+      group_free(self, (GROUP_e)i);
+  }
+
+  /* the cgroups are walked again down to the new depth */
+  if (self->cgroups.tree.depth != cfg->cgroups.tree.depth)
+  {
+    int initialized = self->freq_data[CGROUPS_GROUP].initialized;
+
+    group_free(self, CGROUPS_GROUP);
+    self->cgroups.tree.depth = cfg->cgroups.tree.depth;
+    if (initialized)
+      group_init(self, CGROUPS_GROUP);
+  }
+
+  /* every key is read, a new selection has its rates at once */
+  memcpy(self->memory_total.keys, cfg->memory_total.keys, sizeof(self->memory_total.keys));
+  self->memory_total.nkeys = cfg->memory_total.nkeys;
+
+  /* a changed trigger needs a new fd */
+  for (r = 0; r < PRESSURE_MAX; r++)
+  {
+    pressure_t *res = &self->pressure.res[r];
+
+    self->pressure.triggers[r] = cfg->pressure.triggers[r];
+    if (same_str(res->trigger, self->pressure.triggers[r]))
+      continue;
+    if (res->trigger)
+      evloop_del(loop, res->fd);
+    pressure_close(res);
+    if (!self->pressure.triggers[r] && !self->freq_data[PRESSURE_GROUP].initialized)
+      continue;
+    pressure_open(res, pressure_names[r], self->pressure.triggers[r]);
+    if (res->trigger)
+      evloop_add(loop, res->fd, POLLPRI, on_trigger, self);
+    else if (self->pressure.triggers[r])
+      syslog(LOG_ERR, "unable to set the %s pressure trigger %s", pressure_names[r], self->pressure.triggers[r]);
+  }
+
+  /* the windows restart if their length or the sketched fields change */
+  for (i = (self->nsketch_keys == cfg->nsketch_keys) ? 0 : cfg->nsketch_keys; i < cfg->nsketch_keys && !strcmp(self->sketch_keys[i], cfg->sketch_keys[i]); i++)
+    ;
+  if (self->window != cfg->window || i != cfg->nsketch_keys)
+    for (i=0; i< GROUP_MAX; i++)
+      for (j = 0; j < self->windows[i].nb; j++)
+        self->windows[i].fields[j].hash = 0;
+  self->window = cfg->window;
+  memcpy(self->sketch_keys, cfg->sketch_keys, sizeof(self->sketch_keys));
+  self->nsketch_keys = cfg->nsketch_keys;
+
+  /* the state of the burst rules is kept if they are the same */
+  for (i = 0; i < cfg->nburst_rules && i < self->nburst_rules && !strcmp(self->burst_rules[i].text, cfg->burst_rules[i].text); i++)
+    self->burst_rules[i].pattern = cfg->burst_rules[i].pattern;
+  if (i != cfg->nburst_rules || i != self->nburst_rules)
+  {
+    for (i=0; i< self->nburst_rules; i++)
+      free((char *)self->burst_rules[i].text);
+    memcpy(self->burst_rules, cfg->burst_rules, sizeof(burst_rule_t) * cfg->nburst_rules);
+    self->nburst_rules = cfg->nburst_rules;
+    cfg->nburst_rules = 0;
+    for (i=0; i< GROUP_MAX; i++)
+      self->freq_data[i].burst_ms = 0;
+  }
+  self->burst_max = cfg->burst_max;
+  self->sep = cfg->sep;
+
+  /* a new budget is measured from scratch */
+  if (self->budget.limit_ns != cfg->budget.limit_ns || self->budget.window != cfg->budget.window)
+  {
+    if (self->budget.level)
+      budget_apply(self, 0, 0);
+    memset(&self->budget, 0, sizeof(self->budget));
+    self->budget.limit_ns = cfg->budget.limit_ns;
+    self->budget.window = cfg->budget.window;
+  }
+
+#if !defined(_AIX)
+  /* the block devices are listed again at the next collect */
+  if (!same_str(opts->disks, next.disks) || !same_str(opts->disks_exclude, next.disks_exclude)
+      || opts->partitions != next.partitions)
+    perfunix_disk_select(next.disks, next.disks_exclude, next.partitions);
+#endif
+
+  if (!same_str(opts->history_dir, next.history_dir) || !same_str(opts->control_path, next.control_path)
+      || !same_str(opts->root, next.root) || self->container.enabled != cfg->container.enabled)
+    syslog(LOG_NOTICE, "-H, -S, -r and -C are only read at start, restart to change them");
+
+  set_tick(self);
+  scheduler_set_tick(&self->scheduler, self->tick_ms * 1000000ULL);
+  evloop_timer_set(loop, scheduler_next(&self->scheduler));
+
+  stats_free(cfg);
+  free(cfg);
+  free(opts->args);
+  free(opts->buf);
+  *opts = next;
+  syslog(LOG_NOTICE, "configuration reloaded");
+}
+
+#define REPLAY_WARMUP 2 /* collects before the allocations are checked */
+static char stdout_buf[BUFSIZ];
+
+/* Replay of a capture of jsonperfmon-capture: each numbered directory of
+ * dir is the root of a tick whose time_ms file gives its time. The first
+ * tick initializes the groups, then each one goes through the tick of the
+ * daemon with its time aligned on the tick as clock, so the periods, the
+ * window and the bursts apply, the self group aside. The json go to stdout and only depend on the capture, so
+ * two versions can be compared on the same one; the cost of each collector
+ * goes to stderr. A build with -DALLOC_CHECK=ON fails when a collect past
+ * the warm up allocates.
+ */
+static int replay(modPerf_stats_t *self, const char *dir)
+{
+  char path[PATH_MAX];
+  FILE *f;
+  uint64_t t_ms = 0, start_ms = 0;
+  int n, i, r, failed = 0;
+
+  snprintf(path, sizeof(path), "%s/hostname", dir);
+  if ((f = fopen(path, "r")) != NULL)
+  {
+    if (fgets(path, sizeof(self->hostname), f))
+    {
+      self->lhostname = strcspn(path, ".\n");
+      memcpy(self->hostname, path, self->lhostname);
+      self->hostname[self->lhostname] = '\0';
+    }
+    fclose(f);
+  }
+
+  /* only the ticks are counted, the timings of the scheduler are not replayed */
+  scheduler_open(&self->scheduler, self->tick_ms * 1000000ULL);
+  self->stream = stdout;
+  /* a window delays the first output past the warm up, its buffer is not allocated then */
+  setvbuf(stdout, stdout_buf, _IOFBF, sizeof(stdout_buf));
+
+  for (n = 0; ; n++)
+  {
+    snprintf(path, sizeof(path), "%s/%d/time_ms", dir, n);
+    if ((f = fopen(path, "r")) == NULL)
+      break;
+    r = fscanf(f, "%" SCNu64, &t_ms);
+    fclose(f);
+    if (r != 1)
+      break;
+
+    snprintf(path, sizeof(path), "%s/%d", dir, n);
+    selfstat_root(path);
+    /* aligned on the tick as the scheduler does, a tick already served is skipped */
+    t_ms -= t_ms % self->tick_ms;
+    if (n && t_ms <= self->clock_ns / 1000000ULL)
+    {
+      self->scheduler.skipped++;
+      continue;
+    }
+    self->clock_ns = t_ms * 1000000ULL;
+
+    if (!n)
+    {
+      start_ms = t_ms;
+      stats_allocate(self);
+      group_init(self, SELF_GROUP);
+      continue;
+    }
+
+    /* the pressure files stay open on a live host */
+    for (r = 0; r < PRESSURE_MAX; r++)
+      if (self->pressure.res[r].fd >= 0)
+      {
+        pressure_close(&self->pressure.res[r]);
+        pressure_open(&self->pressure.res[r], pressure_names[r], NULL);
+      }
+
+    /* the allocations of the warm up are not reported */
+    if (n == REPLAY_WARMUP + 1)
+      for (i = 0; i < SELF_MAX; i++)
+        self->selfstat.stats[i].total_allocs = 0;
+#ifdef ALLOC_CHECK
+    uint64_t allocs = selfstat_allocs;
+#endif
+
+    self->scheduler.ticks++;
+    tick(self, t_ms);
+
+#ifdef ALLOC_CHECK
+    if (n > REPLAY_WARMUP && selfstat_allocs != allocs)
+    {
+      fprintf(stderr, "tick %d: %" PRIu64 " allocations past the warm up\n", n, selfstat_allocs - allocs);
+      failed = 1;
+    }
+#endif
+  }
+
+  if (!self->scheduler.ticks)
+  {
+    fprintf(stderr, "no tick to replay in %s\n", dir);
+    return -1;
+  }
+
+  fprintf(stderr, "%" PRIu64 " ticks over %" PRIu64 "s\n%-14s %10s %10s %10s %12s %10s %10s"
+#ifdef ALLOC_CHECK
+          " %10s"
 #endif
+          "\n", self->scheduler.ticks, (self->clock_ns / 1000000 - start_ms) / 1000,
+          "collector", "ns/tick", "p99_us", "opens", "bytes/tick", "MB/s", "out/tick"
+#ifdef ALLOC_CHECK
+          , "allocs"
+#endif
+          );
+  for (i = 0; i < SELF_MAX; i++)
+  {
+    selfstat_t *st = &self->selfstat.stats[i];
+
+    if (!st->total_calls)
+      continue;
+    fprintf(stderr, "%-14s %10" PRIu64 " %10.1f %10" PRIu64 " %12" PRIu64 " %10.1f %10" PRIu64,
+            selfstat_names[i],
+            st->total_wall_ns / st->total_calls,
+            sketch_quantile(&st->wall_us, 0.99),
+            st->io.opens,
+            st->total_bytes / st->total_calls,
+            (st->total_wall_ns) ? st->total_bytes * 1000.0 / st->total_wall_ns : 0,
+            st->total_out / st->total_calls);
+#ifdef ALLOC_CHECK
+    fprintf(stderr, " %10" PRIu64, st->total_allocs);
+#endif
+    fprintf(stderr, "\n");
+  }
+  return failed ? -1 : 0;
+}
 
-static void end_pgm (int sig)
+static void on_signal(evloop_t *loop, int sig, uint32_t events, void *data)
 {
-   go_on = 0;
+  (void)events;
+  if (sig == SIGHUP)
+  {
+    reconfigure((options_t *)data, loop);
+    return;
+  }
+  evloop_stop(loop);
 }
 
 static void usage() {
-  printf("Usage : " PACKAGE_NAME " [-A <n>] [-t <n>] [-u <n>] [-m <n>] [-s <n>] [-n <n>] [-i <n>] [-p <n>] [-r] [-R]\n\n"
-      " <n>   The absolute value is the period computed as 2^(n-1) seconds.\n"
+  printf("Usage : " PACKAGE_NAME " [-A <n>] [-t <n>] [-u <n>] [-m <n> [-M <keys>]] [-s <n> [-d <disks>] [-D <disks>] [-e]] [-n <n>] [-i <n>] [-p <n>] [-P <n>] [-g <n> [-G <depth>]] [-q <n>] [-k <n>] [-N <n>] [-j <n>] [-C] [-W <n> [-Q <keys>]] [-H <dir> [-K <hours>[/<MB>]]] [-S <path>] [-J] [-B <rule> [-b <n>]] [-L <ms>] [-T <trigger>] [-c <file>] [-r <root>] [-X <capture>] [-R]\n\n"
+      " <n>   The absolute value is the period computed as 2^(n-1) seconds, or in seconds\n"
+      "       with the s suffix (-p 60s), or in milliseconds with the ms suffix (-t 100ms).\n"
+      "       A @<m> suffix delays the collects of the group by m seconds (-s 60s@30).\n"
+      "       0s disables the periodic collect but keeps the group for the control socket.\n"
       "       If <0 this group is printed separately. If >0 the output is embedded in the main json\n"
       "       structure. If global group is negative, all groups (not explicitly defined)\n"
       "       are printed separately. If zero then all the concerned groups are not printed.\n"
@@ -1494,7 +4099,56 @@ static void usage() {
       " -n    Nfs group\n"
       " -i    IO Adaptors net/FC\n"
       " -p    Top 10 high cpu processes and top 5 high memory processes\n"
+      " -P    Pressure stall information of cpu, memory and io (Linux)\n"
+      " -g    Top 5 cgroups v2 by cpu, memory and io (Linux), the new and removed cgroups\n"
+      "       are followed with inotify\n"
+      " -q    Interrupts and softirqs per cpu, imbalance between the cpus and top 5 irqs\n"
+      "       of the devices (Linux)\n"
+      " -k    Run queue latency per cpu from /proc/schedstat (Linux, needs schedstats)\n"
+      " -N    Memory, allocations and cpu busy of each NUMA node (Linux), the cpu busy\n"
+      "       needs the cpus group\n"
+      " -j    Cost of the collectors of jsonperfmon itself: wall and cpu times with their\n"
+      "       sketches, opens, reads and bytes read, bytes emitted, ticks overrun or skipped\n"
       "\nOptions:\n"
+      " -W    Output window in seconds, the groups with a shorter period are printed once\n"
+      "       per window with the min, max and avg of their _pct, _s and _us attributes\n"
+      " -Q    Comma separated attributes (time_avg_us) or paths (cpus.*.user_pct) whose\n"
+      "       p50, p90, p99 and mergeable sketch are added at the end of each window\n"
+      " -M    Comma separated keys of meminfo and vmstat added to the memory group\n"
+      "       (MemAvailable,Dirty,nr_dirty,pgmajfault), the events per second\n"
+      " -d    Comma separated patterns of the disks of Linux, the names (sd*) or the names\n"
+      "       of the device mappers and md arrays (vg0-*), all by default\n"
+      " -D    Comma separated patterns of the disks excluded (" BLOCKDEV_EXCLUDE ")\n"
+      " -e    The partitions of the disks too\n"
+      " -G    Depth of the cgroups, the children of the root are at 1 (2)\n"
+      " -C    Container mode, cpu_total also gives the cpu of the cgroup of " PACKAGE_NAME "\n"
+      "       against its quota and cpuset with its throttling, cpus only the cpus of its cpuset\n"
+      " -J    Spread the groups of several seconds over their period with a phase derived\n"
+      "       from the hostname\n"
+      " -B    Burst rule <path><op><on>[/<off>]:<groups>[:<period>], ie disks.*.busy_pct>90/70:sp:1s\n"
+      "       collects the storage and processes groups every second while a busy_pct is\n"
+      "       over 90 and until all of them are under 70 (thresholds accept <k>*ncpus)\n"
+      " -b    Max duration of a burst in seconds (300)\n"
+      " -L    Cpu budget <ms>[/<s>], average cpu time allowed per tick over a sliding window\n"
+      "       (60s), beyond it the processes, storage, nfs, adapters, cgroups, irq, numa,\n"
+      "       cpus and sched groups are degraded step by step to cheaper collects and\n"
+      "       longer periods\n"
+      " -T    PSI trigger <cpu|memory|io>:<some|full> <stall us> <window us>, ie\n"
+      "       memory:some 150000 1000000, a json of the groups related to the resource\n"
+      "       is produced each time the trigger fires\n"
+      " -S    Control socket, a unix socket accepting the requests snapshot [<groups>],\n"
+      "       period <groups> <n> and timing, one per line\n"
+      " -H    Also store the produced values in the history segments of <dir>\n"
+      "       (see " PACKAGE_NAME "-query)\n"
+      " -K    Keep the history segments of the last <hours> and at most <MB> on the disk,\n"
+      "       the oldest ones are removed when a segment is created (0 no limit)\n"
+      " -c    Config file with an option per line as on the command line (-p 60s@15),\n"
+      "       read after the command line at start and again on SIGHUP: only the groups\n"
+      "       whose period changed are restarted, the others keep their rates\n"
+      " -r    Root of /proc, /sys and /etc/mtab, ie /host for the host tree in a container\n"
+      " -X    Replay a capture of " PACKAGE_NAME "-capture: each captured tick is a tick of\n"
+      "       the daemon with the captured time as clock, the json go to stdout and the\n"
+      "       cost of each collector to stderr. -S, -J, -r, -L and -T are refused\n"
       " -R    More human Readable output\n\n");
 }
 
@@ -1502,9 +4156,7 @@ int main (int argc, char *argv[])
 {
   modPerf_stats_t *self = malloc(sizeof(modPerf_stats_t));
   char hostname[500], line[100];
-
-  signal(SIGINT, end_pgm);
-  signal(SIGTERM, end_pgm);
+  evloop_t loop;
 
   openlog("jsonperfmon", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_LOCAL1);
 
@@ -1517,98 +4169,93 @@ int main (int argc, char *argv[])
   /* Initialize the structure content */
   stats_initialize(self, hostname, strlen(hostname));
 
-  int opt, i;
-  char *sep = "";
-  int nothing_to_do = 1;
-  char *groupsopt = "tumsnip";
+  options_t opts;
+  int i, ret;
 
-  /* Manage command line options */
-  while ((opt = getopt(argc, argv, "A:t:u:m:s:n:i:p:Rh?")) != -1)
+  memset(&opts, 0, sizeof(opts));
+  opts.argc = argc;
+  opts.argv = argv;
+  if ((ret = configure(self, &opts)) != 0)
   {
-    int grp, val = (optarg!=NULL) ? atoi(optarg) : 0;
-    int typ = (val<0)?-1:((val>0)?1:0);
-    val = abs(val) - 1;
-    switch (opt) {
-    case 'A':
-      set_global_freq(self, typ, (unsigned int)val);
-      nothing_to_do = 0;
-      break;
-    case 't':
-      /* fall through */
-    case 'u':
-      /* fall through */
-    case 'm':
-      /* fall through */
-    case 's':
-      /* fall through */
-    case 'n':
-      /* fall through */
-    case 'i':
-      /* fall through */
-    case 'p':
-      /* with cases above, groupsopt will contain opt */
-      for (grp = 0; grp < GROUP_MAX && opt != groupsopt[grp]; grp++)
-        ;
-      set_group_freq(self, (GROUP_e)grp, typ, (unsigned int)val);
-      nothing_to_do = 0;
-      break;
-    case 'R':
-      sep = "\n";
-      break;
-    case 'h':
-    case '?':
-    default:
+    if (ret > 0)
       usage();
-      return 0;
+    return (ret < 0) ? 1 : 0;
+  }
+
+  if (opts.root)
+    selfstat_root(opts.root);
+#if !defined(_AIX)
+  perfunix_disk_select(opts.disks, opts.disks_exclude, opts.partitions);
+#endif
+
+  if (opts.history_dir && (self->history = history_open(opts.history_dir, self->hostname)) == NULL)
+    syslog(LOG_ERR, "unable to use history directory %s", opts.history_dir);
+  if (self->history)
+    history_retention(self->history, (uint64_t)opts.keep_hours * 3600000, (uint64_t)opts.keep_mb << 20);
+
+  if (opts.replay)
+  {
+    if (opts.control_path || opts.jitter || opts.root || self->budget.limit_ns
+        || self->pressure.triggers[0] || self->pressure.triggers[1] || self->pressure.triggers[2])
+    {
+      fprintf(stderr, "-S, -J, -r, -L and -T cannot be replayed\n");
+      stats_free(self);
+      free(self);
+      return 1;
     }
+    ret = replay(self, opts.replay);
+    stats_free(self);
+    free(self);
+    free(opts.args);
+    free(opts.buf);
+    closelog();
+    return (ret < 0) ? 1 : 0;
   }
 
-  if (nothing_to_do){
-    usage();
-    return 0;
+  if (evloop_open(&loop) < 0)
+  {
+    syslog(LOG_ERR, "unable to create the event loop");
+    return 1;
   }
+  opts.self = self;
+  evloop_signal(&loop, SIGINT, on_signal, &opts);
+  evloop_signal(&loop, SIGTERM, on_signal, &opts);
+  evloop_signal(&loop, SIGHUP, on_signal, &opts);
 
+  scheduler_open(&self->scheduler, self->tick_ms * 1000000ULL);
+
+  self->cgroups.loop = &loop;
   stats_allocate(self);
 
-  while (go_on)
+  for (i=0; i< PRESSURE_MAX; i++)
   {
-    struct timeval tim;
-	struct timespec tsns, tsrm;
-    gettimeofday(&tim, NULL);
-    /* let sleep until next seconds border .000000
-     * with this mechanism the period is the exact second
-     */
-	tsns.tv_sec = 0;
-	tsns.tv_nsec = (1000000 - tim.tv_usec)*1000;
-    nanosleep(&tsns, &tsrm);
-    /* now we are at (tim.tv_sec++).000000 */
-    tim.tv_sec++;
-
-    if (((TYPE_ULL)tim.tv_sec & self->mask_freq_std) == 0)
-    {
-      /* This is the single json */
-      if (standard(self, tim.tv_sec, sep))
-      {
-        /* With at least a group in the json */
-        syslog(LOG_INFO, "%.*s", (int)self->out->len, self->out->str);
-      }
-    }
-    for (i=0; go_on && i<GROUP_MAX; i++)
-    {
-      if (self->freq_data[i].type < 0 && (((TYPE_ULL)tim.tv_sec) & self->freq_data[i].mask) == 0)
-      {
-        /* This is the group level json */
-        if (!group(self, (GROUP_e)i, tim.tv_sec, sep))
-        {
-          /* This group produce a json */
-          syslog(LOG_INFO, "%.*s", (int)self->out->len, self->out->str);
-        }
-      }
-    }
+    if (!self->pressure.triggers[i])
+      continue;
+    if (!self->pressure.res[i].trigger)
+      syslog(LOG_ERR, "unable to set the %s pressure trigger %s", pressure_names[i], self->pressure.triggers[i]);
+    else
+      evloop_add(&loop, self->pressure.res[i].fd, POLLPRI, on_trigger, self);
   }
 
+  if (opts.control_path && control_open(&self->control, &loop, opts.control_path, on_control, self) < 0)
+    syslog(LOG_ERR, "unable to create the control socket %s", opts.control_path);
+
+#if !defined(_AIX)
+  /* without a slot in the loop the uevents are read at each collect of the disks */
+  if ((i = perfunix_disk_uevent_fd(1)) >= 0 && evloop_add(&loop, i, POLLIN, on_uevents, NULL) < 0)
+    perfunix_disk_uevent_fd(0);
+#endif
+
+  evloop_timer(&loop, on_tick, self);
+  evloop_timer_set(&loop, scheduler_next(&self->scheduler));
+  evloop_run(&loop);
+
+  control_close(&self->control);
+  evloop_close(&loop);
   stats_free(self);
   free(self);
+  free(opts.args);
+  free(opts.buf);
   closelog();
 
   return 0;
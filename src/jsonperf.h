@@ -31,6 +31,19 @@
 #include <inttypes.h>
 
 #include "glib_compat.h"
+#include "blockdev.h"
+#include "cgroup.h"
+#include "control.h"
+#include "evloop.h"
+#include "history.h"
+#include "irq.h"
+#include "memkeys.h"
+#include "numa.h"
+#include "pressure.h"
+#include "schedstat.h"
+#include "scheduler.h"
+#include "selfstat.h"
+#include "sketch.h"
 #ifdef _AIX
 #include <libperfstat.h>
 # define STRUCT_PREFIX(x) perfstat_ ## x
@@ -53,10 +66,41 @@ enum GROUP_e {
   NFS_GROUP = 4,
   ADAPTERS_GROUP = 5,
   PROCESSES_GROUP = 6,
-  GROUP_MAX = 7
+  PRESSURE_GROUP = 7,
+  CGROUPS_GROUP = 8,
+  IRQ_GROUP = 9,
+  SCHED_GROUP = 10,
+  NUMA_GROUP = 11,
+  SELF_GROUP = 12,
+  GROUP_MAX = 13
 };
 typedef enum GROUP_e GROUP_e;
 
+/* option letter of each group, in the GROUP_e order */
+#define GROUPS_OPT "tumsnipPgqkNj"
+
+/* measured parts of jsonperfmon, named as their call_* */
+enum SELF_e {
+  SELF_cpu_total = 0,
+  SELF_cpu,
+  SELF_memory_total,
+  SELF_pagingspace,
+  SELF_disk,
+  SELF_filesystems,
+  SELF_nfs,
+  SELF_netinterface,
+  SELF_fcstat,
+  SELF_processes,
+  SELF_pressure,
+  SELF_cgroups,
+  SELF_irq,
+  SELF_sched,
+  SELF_numa,
+  SELF_window,          /* summary of the window and burst rules */
+  SELF_emit,            /* syslog and history */
+  SELF_MAX
+};
+
 struct Group_source_s {
   char *str;
   int len;
@@ -71,6 +115,47 @@ typedef struct Group_source_s Group_source_t;
 typedef unsigned char uchar_t;
 #endif /*_UCHAR_T */
 
+/* Accumulator of a summarized field over the output window, the fields of
+ * a group are identified by their position in the group json, the hash of
+ * their path checks the structure did not change (new disk...)
+ */
+typedef struct {
+  uint32_t hash;
+  uint32_t count;
+  double min;
+  double max;
+  double sum;
+  sketch_t *sketch;     /* kept by the slot once a field selected by -Q used it */
+  int sketched;         /* the field of the slot is selected by -Q */
+} window_field_t;
+
+#define SKETCH_KEYS_MAX 16
+
+/* Threshold rule of the burst mode, while active the groups of the rule are
+ * collected at the period of the rule. It trips when a matching field goes
+ * beyond on and is released when all of them are back within off.
+ */
+typedef struct {
+  const char *text;     /* the rule as given, for the logs */
+  char *pattern;
+  int op;               /* 1 for '>', -1 for '<' */
+  double on;
+  double off;
+  uint32_t groups;      /* 1 << GROUP_e */
+  TYPE_ULL period_ms;
+  int seen;             /* evaluation of the current tick */
+  int beyond_on;
+  int beyond_off;
+  int active;
+  int latched;          /* the max duration was reached, wait for the release */
+  uint64_t since_ms;
+} burst_rule_t;
+
+#define BURST_RULES_MAX 16
+
+#define BUDGET_SLOTS 300   /* max window of the cpu budget in seconds */
+#define BUDGET_LEVELS 5
+
 /* Main structure, it contains for must groups an array of 2 storages
  * one contains the previous collect one the current then methods can
  * subtract between the two collects. Pointers on current and previous
@@ -82,10 +167,13 @@ struct modPerf_stats_s {
   char hostname[256];
 
   GString *out;
+  char *sep;            /* after each json, "\n" for -R */
+  history_t *history;
+  FILE *stream;         /* output of the replay instead of syslog */
+  uint64_t clock_ns;    /* time of the replayed tick, 0 on a live host */
 
   int n100cpus;
-  TYPE_ULL mask_freq;
-  TYPE_ULL mask_freq_std;
+  TYPE_ULL tick_ms;     /* greatest common divisor of the periods */
 
   struct {
     STRUCT_PREFIX(cpu_total_t) data[2];
@@ -101,28 +189,45 @@ struct modPerf_stats_s {
 #   define GROUP_cpu CPUS_GROUP
   } cpu;
 
+  /* -C, cpu_total against the quota of the cgroup of jsonperfmon and cpus
+   * restricted to its cpuset */
+  struct {
+    int enabled;
+    cgroup_self_t cgroup;
+    cgroup_stat_t data[2];
+    uchar_t odd;
+  } container;
+
   struct  {
     STRUCT_PREFIX(memory_total_t) data[2];
     STRUCT_PREFIX(memory_total_t) *current_snapshot;
     STRUCT_PREFIX(memory_total_t) *previous_snapshot;
+    short keys[MEMKEY_MAX];   /* -M, the keys of meminfo and vmstat given */
+    int nkeys;
 #   define GROUP_memory_total MEMORY_GROUP
   } memory_total;
 
   struct {
     STRUCT_PREFIX(disk_t) *previous;
+    STRUCT_PREFIX(disk_t) *next;     /* rebuilt at each collect, then swapped */
     int nb;
+    int max;                        /* of previous and next */
 #   define GROUP_disk DISKS_GROUP
   } disk;
 
   struct {
     STRUCT_PREFIX(fcstat_t) *previous;
+    STRUCT_PREFIX(fcstat_t) *next;     /* rebuilt at each collect, then swapped */
     int nb;
+    int max;                        /* of previous and next */
 #   define GROUP_fcstat ADAPTERS_GROUP
   } fcstat;
 
   struct {
     STRUCT_PREFIX(netinterface_t) *previous;
+    STRUCT_PREFIX(netinterface_t) *next;     /* rebuilt at each collect, then swapped */
     int nb;
+    int max;                        /* of previous and next */
 #   define GROUP_netinterface ADAPTERS_GROUP
   } netinterface;
 
@@ -142,22 +247,104 @@ struct modPerf_stats_s {
 
  struct {
     process_t *str_procs_first;
+    process_t *free;             /* processes gone, reused for the new ones */
+    struct procentry64 *entries; /* process table, kept between the collects */
+    int nb_entries;
     uchar_t odd;
 #   define GROUP_processes PROCESSES_GROUP
   } processes;
 
+  struct {
+    pressure_t res[PRESSURE_MAX];
+    const char *triggers[PRESSURE_MAX];
+    pressure_stat_t data[PRESSURE_MAX][2];
+    uchar_t odd;
+#   define GROUP_pressure PRESSURE_GROUP
+  } pressure;
+
+  struct {
+    cgroup_tree_t tree;
+    uchar_t odd;
+    evloop_t *loop;     /* reads the inotify fd, NULL in a replay */
+#   define GROUP_cgroups CGROUPS_GROUP
+  } cgroups;
+
+  struct {
+    irq_table_t interrupts;
+    irq_table_t softirqs;
+#   define GROUP_irq IRQ_GROUP
+  } irq;
+
+  struct {
+    schedstat_t stat;
+#   define GROUP_sched SCHED_GROUP
+  } sched;
+
+  struct {
+    numa_t nodes;
+    uchar_t odd;
+#   define GROUP_numa NUMA_GROUP
+  } numa;
+
+  struct {
+    selfstat_t stats[SELF_MAX];
+    uint64_t ticks;       /* scheduler counters at the previous output */
+    uint64_t overruns;
+    uint64_t skipped;
+    TYPE_ULL emitted;     /* bytes since the previous output */
+#   define GROUP_selfstat SELF_GROUP
+  } selfstat;
+
 #   define GROUP_filesystems DISKS_GROUP
 #   define GROUP_pagingspace MEMORY_GROUP
 
   struct {
     int type;
-    unsigned int shift;
-    TYPE_ULL mask;
+    TYPE_ULL period_ms;
+    TYPE_ULL phase_ms;    /* the collects happen when (t - phase) % period == 0 */
+    TYPE_ULL burst_ms;    /* shorter period while a burst rule is active */
+    unsigned int stretch; /* period multiplier while the cpu budget is exceeded */
     int setted;
+    int initialized;      /* init_* called, the next collect has a previous snapshot */
+    uint64_t collect_ns;  /* cost of the last collect */
+    uint64_t last_ns;     /* monotonic time of the previous collect */
+    TYPE_ULL elapsed_us;  /* measured interval used by the rates */
   } freq_data[GROUP_MAX];
 
+  scheduler_t scheduler;
+  control_t control;
+
+  unsigned int window;  /* output window in seconds, 0 means each collect */
+  GString *window_out;
+  size_t window_extra;  /* bytes of the json of the tick if the window ended */
+  struct {
+    window_field_t *fields;
+    int nb;
+  } windows[GROUP_MAX];
+  char *sketch_keys[SKETCH_KEYS_MAX];
+  int nsketch_keys;
+
+  burst_rule_t burst_rules[BURST_RULES_MAX];
+  int nburst_rules;
+  unsigned int burst_max;  /* max duration of a burst in seconds */
+
+  /* cpu time of the ticks over a sliding window, beyond the limit the groups
+   * are degraded one level at a time (see budget_levels) */
+  struct {
+    uint64_t limit_ns;         /* average per tick, 0 disables */
+    unsigned int window;       /* seconds */
+    uint64_t cpu_ns[BUDGET_SLOTS];
+    uint32_t ticks[BUDGET_SLOTS];
+    uint64_t slot;             /* second of the last slot */
+    uint64_t avg_ns;
+    uint64_t since_ms;         /* last change of level */
+    int level;
+  } budget;
+
 };
 
 typedef struct modPerf_stats_s modPerf_stats_t;
 
+#define GROUP_PERIOD(s, g) (((s)->freq_data[g].burst_ms ? (s)->freq_data[g].burst_ms : (s)->freq_data[g].period_ms) * (s)->freq_data[g].stretch)
+
 #endif
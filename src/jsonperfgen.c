@@ -0,0 +1,634 @@
+/* jsonperfgen.c
+ *
+ * Generator of a synthetic large host in the layout of jsonperfmon-capture.
+ *
+ * Each tick is a directory holding a fake /proc and /etc/mtab of a host with
+ * the requested number of cpus, disks, interfaces and tasks, whose counters
+ * advance by a fixed rate per component between the ticks. The rates come
+ * from a hash of the component index so the output only depends on the
+ * arguments. The tree is replayed with jsonperfmon -A 1 -X <dir> to measure
+ * the cost of the collectors at a scale no test host has.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "jsonperfmon"
+#endif
+
+#define USER_HZ     100
+#define START_MS    UINT64_C(1577836800000) /* fixed so two trees are identical */
+#define SD_DISKS    16               /* sda..sdp on major 8, dm-<n> beyond */
+#define PHYS_INTFS  4                /* eth<n>, veth<n> beyond */
+#define NIC_QUEUES  64               /* irqs of a physical interface, one per cpu up to it */
+#define NODE_CPUS   56               /* cpus of a numa node */
+#define FIRST_PID   300
+
+typedef struct {
+  int cpus;
+  int disks;
+  int intfs;
+  int tasks;
+  int ticks;
+  uint64_t interval_ms;
+} gen_t;
+
+static const char *task_names[] = {
+  "java", "postgres", "nginx", "python3", "containerd-shim", "sshd", "bash", "kworker"
+};
+
+/* rate of the counter k of the component i, stable between the ticks */
+static inline uint32_t rate(uint32_t i, uint32_t k, uint32_t max)
+{
+  uint32_t h = (i * 16 + k) * 2654435761U;
+  h ^= h >> 15;
+  h *= 2246822519U;
+  h ^= h >> 13;
+  return max ? h % max : h;
+}
+
+/* the length returned by snprintf did not fit in size */
+static int toolong(int len, size_t size)
+{
+  if (len >= 0 && (size_t)len < size)
+    return 0;
+  errno = ENAMETOOLONG;
+  return 1;
+}
+
+static int mkdirs(char *path)
+{
+  char *p;
+
+  for (p = path + 1; *p; p++)
+    if (*p == '/')
+    {
+      *p = '\0';
+      if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+      *p = '/';
+    }
+  return (mkdir(path, 0755) && errno != EEXIST) ? -1 : 0;
+}
+
+static FILE *create(const char *root, const char *name)
+{
+  char path[PATH_MAX];
+  FILE *f = NULL;
+
+  if (toolong(snprintf(path, sizeof(path), "%s/%s", root, name), sizeof(path)) ||
+      (f = fopen(path, "w")) == NULL)
+    perror(path);
+  return f;
+}
+
+/* user, nice, system, idle, iowait, irq, softirq, steal, guest, guest_nice
+ * jiffies of the cpu c at the tick */
+static void cpu_columns(const gen_t *g, int c, int tick, uint64_t *col)
+{
+  uint64_t busy = rate(c, 0, 100), left = 100, jiffies = g->interval_ms * USER_HZ / 1000;
+  int k;
+
+  col[0] = busy * 6 / 10;
+  col[1] = busy / 20;
+  col[2] = busy * 3 / 10;
+  col[4] = rate(c, 1, 3);
+  col[5] = rate(c, 2, 2);
+  col[6] = rate(c, 3, 3);
+  col[7] = col[8] = col[9] = 0;
+  for (k = 0; k < 10; k++)
+    if (k != 3)
+      left -= (col[k] < left) ? col[k] : left;
+  col[3] = left;
+  for (k = 0; k < 10; k++)
+    col[k] = 1000000 + col[k] * jiffies * tick / 100;
+}
+
+/* /proc/stat, /proc/cpuinfo and /proc/loadavg, the cpu line is the sum of
+ * the cpus */
+static int gen_cpu(const gen_t *g, const char *root, int tick)
+{
+  uint64_t total[10] = { 0 }, col[10];
+  FILE *f;
+  int c, k;
+
+  if ((f = create(root, "proc/stat")) == NULL)
+    return -1;
+
+  for (c = 0; c < g->cpus; c++)
+  {
+    cpu_columns(g, c, tick, col);
+    for (k = 0; k < 10; k++)
+      total[k] += col[k];
+  }
+  fprintf(f, "cpu ");
+  for (k = 0; k < 10; k++)
+    fprintf(f, " %" PRIu64, total[k]);
+  fprintf(f, "\n");
+  for (c = 0; c < g->cpus; c++)
+  {
+    cpu_columns(g, c, tick, col);
+    fprintf(f, "cpu%d", c);
+    for (k = 0; k < 10; k++)
+      fprintf(f, " %" PRIu64, col[k]);
+    fprintf(f, "\n");
+  }
+  fprintf(f, "intr %" PRIu64 " 0 9 0 0 0\n"
+             "ctxt %" PRIu64 "\n"
+             "btime %" PRIu64 "\n"
+             "processes %" PRIu64 "\n"
+             "procs_running %d\n"
+             "procs_blocked %d\n"
+             "softirq %" PRIu64 " 0 0 0 0 0 0 0 0 0 0\n",
+          UINT64_C(100000000) + (uint64_t)g->cpus * 1000 * tick,
+          UINT64_C(200000000) + (uint64_t)g->cpus * 5000 * tick,
+          (uint64_t)(START_MS / 1000) - 86400,
+          UINT64_C(1000000) + (uint64_t)tick * 50,
+          g->cpus / 4 + 1,
+          g->cpus / 100,
+          UINT64_C(50000000) + (uint64_t)g->cpus * 800 * tick);
+  fclose(f);
+
+  if ((f = create(root, "proc/cpuinfo")) == NULL)
+    return -1;
+  for (c = 0; c < g->cpus; c++)
+    fprintf(f, "processor\t: %d\n"
+               "vendor_id\t: GenuineIntel\n"
+               "model name\t: Synthetic CPU @ 2.60GHz\n"
+               "cpu MHz\t\t: 2600.000\n"
+               "physical id\t: %d\n"
+               "core id\t\t: %d\n\n",
+            c, c / 56, c % 56);
+  fclose(f);
+
+  if ((f = create(root, "proc/loadavg")) == NULL)
+    return -1;
+  fprintf(f, "%.2f %.2f %.2f %d/%d %d\n", g->cpus * 0.40, g->cpus * 0.38, g->cpus * 0.35,
+          g->cpus / 4 + 1, g->tasks, FIRST_PID + g->tasks * 2);
+  fclose(f);
+  return 0;
+}
+
+/* /proc/meminfo, /proc/vmstat and /proc/swaps, 8GB per cpu */
+static int gen_memory(const gen_t *g, const char *root, int tick)
+{
+  uint64_t total_kb = (uint64_t)g->cpus * 8 * 1024 * 1024, free_kb = total_kb / 4 - (tick % 7) * 1024;
+  FILE *f;
+
+  if ((f = create(root, "proc/meminfo")) == NULL)
+    return -1;
+  fprintf(f, "MemTotal:       %8" PRIu64 " kB\n"
+             "MemFree:        %8" PRIu64 " kB\n"
+             "MemAvailable:   %8" PRIu64 " kB\n"
+             "Buffers:        %8" PRIu64 " kB\n"
+             "Cached:         %8" PRIu64 " kB\n"
+             "SwapCached:            0 kB\n"
+             "Active:         %8" PRIu64 " kB\n"
+             "Inactive:       %8" PRIu64 " kB\n"
+             "SwapTotal:      %8d kB\n"
+             "SwapFree:       %8d kB\n"
+             "Dirty:              %4d kB\n"
+             "AnonPages:      %8" PRIu64 " kB\n"
+             "Shmem:          %8" PRIu64 " kB\n"
+             "HugePages_Total:       0\n"
+             "HugePages_Free:        0\n"
+             "Hugepagesize:       2048 kB\n",
+          total_kb, free_kb, free_kb * 2, total_kb / 64, total_kb / 4,
+          total_kb / 2, total_kb / 4, 8388604, 8388604 - tick * 4, tick % 1000,
+          total_kb / 2, total_kb / 128);
+  fclose(f);
+
+  if ((f = create(root, "proc/vmstat")) == NULL)
+    return -1;
+  fprintf(f, "nr_free_pages %" PRIu64 "\n"
+             "pgpgin %" PRIu64 "\n"
+             "pgpgout %" PRIu64 "\n"
+             "pswpin %d\n"
+             "pswpout %d\n"
+             "pgfault %" PRIu64 "\n"
+             "pgmajfault %" PRIu64 "\n",
+          free_kb / 4,
+          UINT64_C(10000000) + (uint64_t)g->disks * 100 * tick,
+          UINT64_C(20000000) + (uint64_t)g->disks * 300 * tick,
+          tick, tick * 2,
+          UINT64_C(500000000) + (uint64_t)g->tasks * 10 * tick,
+          UINT64_C(100000) + (uint64_t)tick * 3);
+  fclose(f);
+
+  if ((f = create(root, "proc/swaps")) == NULL)
+    return -1;
+  fprintf(f, "Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+             "/dev/sda2                               partition\t8388604\t\t%d\t\t-2\n",
+          tick * 4);
+  fclose(f);
+  return 0;
+}
+
+/* /proc/diskstats, a partition after each sd disk like on a real host */
+static int gen_disks(const gen_t *g, const char *root, int tick)
+{
+  FILE *f;
+  int d, major, minor;
+  char name[32];
+
+  if ((f = create(root, "proc/diskstats")) == NULL)
+    return -1;
+  for (d = 0; d < g->disks; d++)
+  {
+    uint64_t rio = (uint64_t)rate(d, 0, 200) * tick, wio = (uint64_t)rate(d, 1, 400) * tick;
+    uint64_t busy = (uint64_t)rate(d, 3, g->interval_ms) * tick, dio = (uint64_t)rate(d, 4, 20) * tick;
+
+    if (d < SD_DISKS)
+    {
+      major = 8;
+      minor = d * 16;
+      snprintf(name, sizeof(name), "sd%c", 'a' + d);
+    }
+    else
+    {
+      major = 253;
+      minor = d - SD_DISKS;
+      snprintf(name, sizeof(name), "dm-%d", minor);
+    }
+    fprintf(f, "%4d %7d %s %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+               " %" PRIu64 " %" PRIu64 " %d %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+               " %d %d\n",
+            major, minor, name,
+            1000 + rio, rio / 8, 8000 + rio * 16, 500 + rio / 2,
+            2000 + wio, wio / 4, 16000 + wio * 24, 900 + wio,
+            (int)rate(d, 2, 4), 1000 + busy, 1400 + busy * 2,
+            dio, dio / 4, dio * 2048, dio / 8,
+            tick * 10, tick);
+    if (d < SD_DISKS)
+      fprintf(f, "%4d %7d %s1 %" PRIu64 " 0 %" PRIu64 " 0 %" PRIu64 " 0 %" PRIu64 " 0 0 %" PRIu64 " %" PRIu64
+                 " 0 0 0 0 0 0\n",
+              major, minor + 1, name, 10 + rio, 80 + rio * 16, 20 + wio, 160 + wio * 24,
+              10 + (rio + wio) / 3, 14 + (rio + wio) * 2 / 3);
+  }
+  fclose(f);
+  return 0;
+}
+
+/* /proc/net/dev, with the column widths of the kernel */
+static int gen_intfs(const gen_t *g, const char *root, int tick)
+{
+  FILE *f;
+  int n;
+  char name[32];
+
+  if ((f = create(root, "proc/net/dev")) == NULL)
+    return -1;
+  fprintf(f, "Inter-|   Receive                                                |  Transmit\n"
+             " face |bytes    packets errs drop fifo frame compressed multicast|"
+             "bytes    packets errs drop fifo colls carrier compressed\n");
+  for (n = -1; n < g->intfs; n++)
+  {
+    uint64_t ip = (uint64_t)rate(n + 1, 0, 5000) * tick, op = (uint64_t)rate(n + 1, 1, 5000) * tick;
+
+    if (n < 0)
+      snprintf(name, sizeof(name), "lo");
+    else if (n < PHYS_INTFS)
+      snprintf(name, sizeof(name), "eth%d", n);
+    else
+      snprintf(name, sizeof(name), "veth%d", n - PHYS_INTFS);
+    fprintf(f, "%6s: %7" PRIu64 " %7" PRIu64 " %4d %4d %4d %5d %10d %9d %8" PRIu64 " %7" PRIu64
+               " %4d %4d %4d %5d %7d %10d\n",
+            name, 1000 + ip * 800, 10 + ip, 0, tick / 10, 0, 0, 0, 0,
+            1000 + op * 600, 10 + op, 0, 0, 0, 0, 0, 0);
+  }
+  fclose(f);
+  return 0;
+}
+
+static int gen_pressure(const char *root, int tick)
+{
+  static const char *names[] = { "proc/pressure/cpu", "proc/pressure/memory", "proc/pressure/io" };
+  FILE *f;
+  int r;
+
+  for (r = 0; r < 3; r++)
+  {
+    if ((f = create(root, names[r])) == NULL)
+      return -1;
+    fprintf(f, "some avg10=%.2f avg60=%.2f avg300=%.2f total=%" PRIu64 "\n"
+               "full avg10=%.2f avg60=%.2f avg300=%.2f total=%" PRIu64 "\n",
+            1.5 * (r + 1), 1.2 * (r + 1), 1.0 * (r + 1), (uint64_t)(r + 1) * 15000 * tick,
+            0.5 * r, 0.4 * r, 0.3 * r, (uint64_t)r * 5000 * tick);
+    fclose(f);
+  }
+  return 0;
+}
+
+/* /proc/interrupts and /proc/softirqs with the column widths of the kernel,
+ * each queue of a physical interface has its irq on a single cpu */
+static int gen_irq(const gen_t *g, const char *root, int tick)
+{
+  static const char *arch[] = { "NMI", "LOC", "RES", "CAL", "TLB" };
+  static const char *softirqs[] = { "HI", "TIMER", "NET_TX", "NET_RX", "BLOCK", "IRQ_POLL",
+                                    "TASKLET", "SCHED", "HRTIMER", "RCU" };
+  int queues = (g->cpus < NIC_QUEUES) ? g->cpus : NIC_QUEUES;
+  int c, n, q, k;
+  FILE *f;
+
+  if ((f = create(root, "proc/interrupts")) == NULL)
+    return -1;
+  fprintf(f, "%*s", 12, "");
+  for (c = 0; c < g->cpus; c++)
+    fprintf(f, "CPU%-8d", c);
+  fprintf(f, "\n");
+  for (n = 0; n < PHYS_INTFS; n++)
+    for (q = 0; q < queues; q++)
+    {
+      int irq = 24 + n * queues + q;
+      fprintf(f, "%4d: ", irq);
+      for (c = 0; c < g->cpus; c++)
+        fprintf(f, "%10" PRIu64 " ", (c == q) ? (uint64_t)rate(irq, 0, 20000) * tick : (uint64_t)rate(irq, c, 3));
+      fprintf(f, " PCI-MSI %d-edge      eth%d-TxRx-%d\n", 524288 + n * 2048 + q, n, q);
+    }
+  for (k = 0; k < (int)(sizeof(arch) / sizeof(*arch)); k++)
+  {
+    fprintf(f, "%4s: ", arch[k]);
+    for (c = 0; c < g->cpus; c++)
+      fprintf(f, "%10" PRIu64 " ", (uint64_t)rate(c, k + 4, 1000) * tick);
+    fprintf(f, "  %s interrupts\n", arch[k]);
+  }
+  fprintf(f, " ERR:          0\n MIS:          0\n");
+  fclose(f);
+
+  if ((f = create(root, "proc/softirqs")) == NULL)
+    return -1;
+  fprintf(f, "%*s", 20, "");
+  for (c = 0; c < g->cpus; c++)
+    fprintf(f, "CPU%-8d", c);
+  fprintf(f, "\n");
+  for (k = 0; k < (int)(sizeof(softirqs) / sizeof(*softirqs)); k++)
+  {
+    fprintf(f, "%12s:", softirqs[k]);
+    for (c = 0; c < g->cpus; c++)
+      fprintf(f, " %10" PRIu64, (c < queues || k < 2 || k > 3) ? (uint64_t)rate(c, k + 10, 4000) * tick : 0);
+    fprintf(f, "\n");
+  }
+  fclose(f);
+  return 0;
+}
+
+/* /proc/schedstat version 15, a domain line per cpu */
+static int gen_sched(const gen_t *g, const char *root, int tick)
+{
+  uint64_t ns = g->interval_ms * UINT64_C(1000000) * tick;
+  FILE *f;
+  int c, k;
+
+  if ((f = create(root, "proc/schedstat")) == NULL)
+    return -1;
+  fprintf(f, "version 15\ntimestamp %" PRIu64 "\n", UINT64_C(4294937296) + (uint64_t)tick * g->interval_ms / 10);
+  for (c = 0; c < g->cpus; c++)
+  {
+    uint64_t busy = rate(c, 0, 100);
+
+    fprintf(f, "cpu%d 0 0 %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+            c, UINT64_C(5000) * tick, UINT64_C(2000) * tick, UINT64_C(3000) * tick, UINT64_C(1000) * tick,
+            UINT64_C(1000000000) + ns * busy / 100, UINT64_C(100000000) + ns * busy / 100 * rate(c, 1, 30) / 100,
+            UINT64_C(1000) + (uint64_t)rate(c, 2, 2000) * tick);
+    fprintf(f, "domain0 %08x", 1U << (c % 32));
+    for (k = 0; k < 45; k++)
+      fprintf(f, " %d", (k % 7) ? 0 : tick);
+    fprintf(f, "\n");
+  }
+  fclose(f);
+  return 0;
+}
+
+/* /sys/devices/system/node, a node per NODE_CPUS cpus with 8GB per cpu as
+ * /proc/meminfo, the last node has its allocations missed */
+static int gen_numa(const gen_t *g, const char *root, int tick)
+{
+  int nodes = (g->cpus + NODE_CPUS - 1) / NODE_CPUS, n, last;
+  char path[PATH_MAX];
+  FILE *f;
+
+  for (n = 0; n < nodes; n++)
+  {
+    int cpus = (n < nodes - 1) ? NODE_CPUS : g->cpus - n * NODE_CPUS;
+    uint64_t total = (uint64_t)cpus * 8 << 20, free = total / 4 + rate(n, tick, 1024) * 1024;
+    uint64_t hit = (uint64_t)rate(n + 1, 0, 100000) * tick, miss = (n == nodes - 1) ? hit / 10 : 0;
+
+    if (toolong(snprintf(path, sizeof(path), "%s/sys/devices/system/node/node%d", root, n), sizeof(path)) ||
+        mkdirs(path))
+    {
+      perror(path);
+      return -1;
+    }
+    snprintf(path, sizeof(path), "sys/devices/system/node/node%d/meminfo", n);
+    if ((f = create(root, path)) == NULL)
+      return -1;
+    fprintf(f, "Node %d MemTotal:       %8" PRIu64 " kB\nNode %d MemFree:        %8" PRIu64 " kB\n"
+               "Node %d MemUsed:        %8" PRIu64 " kB\nNode %d Active:         %8" PRIu64 " kB\n"
+               "Node %d FilePages:      %8" PRIu64 " kB\nNode %d AnonPages:      %8" PRIu64 " kB\n"
+               "Node %d HugePages_Total:     0\n",
+            n, total, n, free, n, total - free, n, (total - free) / 2, n, (total - free) / 3,
+            n, (total - free) / 2, n);
+    fclose(f);
+
+    snprintf(path, sizeof(path), "sys/devices/system/node/node%d/numastat", n);
+    if ((f = create(root, path)) == NULL)
+      return -1;
+    fprintf(f, "numa_hit %" PRIu64 "\nnuma_miss %" PRIu64 "\nnuma_foreign %" PRIu64 "\n"
+               "interleave_hit %d\nlocal_node %" PRIu64 "\nother_node %" PRIu64 "\n",
+            1000000 + hit, miss, (n == 0) ? miss : 0, 1024, 1000000 + hit - miss, miss);
+    fclose(f);
+
+    snprintf(path, sizeof(path), "sys/devices/system/node/node%d/cpulist", n);
+    if ((f = create(root, path)) == NULL)
+      return -1;
+    last = n * NODE_CPUS + cpus - 1;
+    if (last > n * NODE_CPUS)
+      fprintf(f, "%d-%d\n", n * NODE_CPUS, last);
+    else
+      fprintf(f, "%d\n", last);
+    fclose(f);
+  }
+  return 0;
+}
+
+/* /proc/<pid>/stat and status, one task in twenty uses some cpu */
+static int gen_tasks(const gen_t *g, const char *root, int tick)
+{
+  char path[PATH_MAX];
+  FILE *f;
+  int t;
+
+  for (t = 0; t < g->tasks; t++)
+  {
+    int pid = FIRST_PID + t * 2;
+    const char *comm = task_names[rate(t, 0, sizeof(task_names) / sizeof(*task_names))];
+    uint32_t busy = (rate(t, 1, 20) == 0) ? rate(t, 2, g->interval_ms * USER_HZ / 1000 + 1) : 0;
+    uint64_t vsize = ((uint64_t)rate(t, 3, 4096) + 16) << 20;
+
+    if (toolong(snprintf(path, sizeof(path), "%s/proc/%d", root, pid), sizeof(path)) || mkdirs(path))
+    {
+      perror(path);
+      return -1;
+    }
+
+    snprintf(path, sizeof(path), "proc/%d/stat", pid);
+    if ((f = create(root, path)) == NULL)
+      return -1;
+    fprintf(f, "%d (%s) S 1 %d %d 0 -1 4194560 %" PRIu64 " 0 0 0 %" PRIu64 " %" PRIu64
+               " 0 0 20 0 %d 0 %d %" PRIu64 " %" PRIu64 " 18446744073709551615 0 0 0 0 0 0 0 0 0 0 0 0 17 %d 0 0 0 0 0\n",
+            pid, comm, pid, pid, UINT64_C(1000) + (uint64_t)tick * 10,
+            UINT64_C(100) + (uint64_t)busy * 2 / 3 * tick, UINT64_C(50) + (uint64_t)(busy - busy * 2 / 3) * tick,
+            1 + (int)rate(t, 4, 8), 1000 + t, vsize, vsize / 4096 / 4, t % g->cpus);
+    fclose(f);
+
+    snprintf(path, sizeof(path), "proc/%d/status", pid);
+    if ((f = create(root, path)) == NULL)
+      return -1;
+    fprintf(f, "Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%d\nPid:\t%d\nPPid:\t1\n"
+               "VmSize:\t%8" PRIu64 " kB\n",
+            comm, pid, pid, vsize >> 10);
+    fclose(f);
+  }
+  return 0;
+}
+
+static int gen_tick(const gen_t *g, const char *dir, int tick)
+{
+  char root[PATH_MAX], path[PATH_MAX];
+  static const char *dirs[] = { "proc/net", "proc/pressure", "etc" };
+  FILE *f;
+  unsigned int i;
+
+  if (toolong(snprintf(root, sizeof(root), "%s/%d", dir, tick), sizeof(root)))
+  {
+    perror(dir);
+    return -1;
+  }
+  for (i = 0; i < sizeof(dirs) / sizeof(*dirs); i++)
+  {
+    if (toolong(snprintf(path, sizeof(path), "%s/%s", root, dirs[i]), sizeof(path)) || mkdirs(path))
+    {
+      perror(path);
+      return -1;
+    }
+  }
+
+  if ((f = create(root, "time_ms")) == NULL)
+    return -1;
+  fprintf(f, "%" PRIu64 "\n", START_MS + tick * g->interval_ms);
+  fclose(f);
+
+  if ((f = create(root, "etc/mtab")) == NULL)
+    return -1;
+  fprintf(f, "/dev/sda1 / ext4 rw,relatime 0 0\n"
+             "proc /proc proc rw,nosuid,nodev,noexec,relatime 0 0\n");
+  fclose(f);
+
+  if (gen_cpu(g, root, tick) || gen_memory(g, root, tick) || gen_disks(g, root, tick) ||
+      gen_intfs(g, root, tick) || gen_pressure(root, tick) || gen_irq(g, root, tick) ||
+      gen_sched(g, root, tick) || gen_numa(g, root, tick) || gen_tasks(g, root, tick))
+    return -1;
+  return 0;
+}
+
+static void usage()
+{
+  printf("Usage : " PACKAGE_NAME "-gen [-c <cpus>] [-d <disks>] [-n <intfs>] [-p <tasks>] [-t <ticks>] [-i <ms>] <dir>\n\n"
+      " -c    Number of cpus (448)\n"
+      " -d    Number of disks, sd<x> then dm-<n> (3000)\n"
+      " -n    Number of network interfaces, eth<n> then veth<n> (10000)\n"
+      " -p    Number of tasks (150000)\n"
+      " -t    Number of ticks, the first one only initializes the groups (3)\n"
+      " -i    Interval between the ticks in milliseconds (1000)\n\n"
+      "The tree is replayed with " PACKAGE_NAME " -A 1 -X <dir>\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+  gen_t g = { 448, 3000, 10000, 150000, 3, 1000 };
+  char path[PATH_MAX];
+  FILE *f;
+  int opt, t;
+
+  while ((opt = getopt(argc, argv, "c:d:n:p:t:i:h?")) != -1)
+  {
+    switch (opt) {
+    case 'c':
+      g.cpus = atoi(optarg);
+      break;
+    case 'd':
+      g.disks = atoi(optarg);
+      break;
+    case 'n':
+      g.intfs = atoi(optarg);
+      break;
+    case 'p':
+      g.tasks = atoi(optarg);
+      break;
+    case 't':
+      g.ticks = atoi(optarg);
+      break;
+    case 'i':
+      g.interval_ms = strtoull(optarg, NULL, 10);
+      break;
+    case 'h':
+    case '?':
+    default:
+      usage();
+      return 0;
+    }
+  }
+
+  if (optind != argc - 1 || g.cpus < 1 || g.disks < 0 || g.intfs < 0 || g.tasks < 0 ||
+      g.ticks < 2 || !g.interval_ms)
+  {
+    usage();
+    return 1;
+  }
+
+  if (toolong(snprintf(path, sizeof(path), "%s", argv[optind]), sizeof(path)) || mkdirs(path))
+  {
+    perror(path);
+    return 1;
+  }
+  if (toolong(snprintf(path, sizeof(path), "%s/hostname", argv[optind]), sizeof(path)) ||
+      (f = fopen(path, "w")) == NULL)
+  {
+    perror(path);
+    return 1;
+  }
+  fprintf(f, "synthetic-%dc\n", g.cpus);
+  fclose(f);
+
+  for (t = 0; t < g.ticks; t++)
+    if (gen_tick(&g, argv[optind], t))
+      return 1;
+  return 0;
+}
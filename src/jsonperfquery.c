@@ -0,0 +1,716 @@
+/* jsonperfquery.c
+ *
+ * Query tool over the history store written by jsonperfmon -H.
+ *
+ * The segments are mapped read only, the time range is found by a binary
+ * search on the time index then each selected column slice is scanned with
+ * vector operations to compute min/max/avg/count. The percentiles need the
+ * values themselves so they are gathered and selected in place. With -s the
+ * sketches of a json stream are merged instead.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "glib_compat.h"
+#include "history.h"
+#include "jsonscan.h"
+#include "sketch.h"
+
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "jsonperfmon"
+#endif
+
+#define MAX_PATTERNS 32
+#define MAX_AGGS     16
+
+typedef enum { AGG_MIN, AGG_MAX, AGG_AVG, AGG_LAST, AGG_COUNT, AGG_RATE, AGG_PCT } agg_e;
+
+typedef struct {
+  agg_e type;
+  int pct;
+  char suffix[8];
+} agg_t;
+
+typedef struct {
+  char name[HISTORY_NAME_MAX];
+  double min, max, sum;
+  uint64_t count;
+  double first, last;
+  int64_t first_ms, last_ms;
+  double *values;
+  size_t nvalues, values_alloc;
+  sketch_t *sketch;      /* merged sketches of the -s mode */
+} series_t;
+
+typedef struct {
+  series_t *tab;
+  size_t nb, alloc;
+  uint32_t *hash;
+  uint32_t hashmask;
+} series_set_t;
+
+/******************************************************************************************************************
+ * vector scan of a column slice
+ *****************************************************************************************************************/
+typedef float   v8sf __attribute__((vector_size(32)));
+typedef int32_t v8si __attribute__((vector_size(32)));
+typedef double  v4df __attribute__((vector_size(32)));
+typedef int64_t v4di __attribute__((vector_size(32)));
+
+#define V8SELECT(m, a, b) ((v8sf)(((v8si)(a) & (m)) | ((v8si)(b) & ~(m))))
+#define V4SELECT(m, a, b) ((v4df)(((v4di)(a) & (m)) | ((v4di)(b) & ~(m))))
+/* float partial sums are folded in a double every SCAN_BLOCK vectors */
+#define SCAN_BLOCK 1024
+
+/* the gauges, returns the index of the first value left to the scalar loop */
+static uint32_t scan_float(series_t *s, const float *col, uint32_t n, double *sum)
+{
+  const v8sf inf = { INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY };
+  v8sf vmin = inf, vmax = -inf, vsum = { 0 };
+  v8si vcnt = { 0 };
+  uint32_t i = 0, j, block = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    v8sf v;
+    memcpy(&v, col + i, sizeof(v));
+    v8si valid = (v == v);                 /* false on NaN */
+    vsum += (v8sf)((v8si)v & valid);
+    vcnt -= valid;
+    vmin = V8SELECT(v < vmin, v, vmin);    /* NaN compare is false */
+    vmax = V8SELECT(v > vmax, v, vmax);
+    if (++block == SCAN_BLOCK)
+    {
+      for (j = 0; j < 8; j++)
+        *sum += vsum[j];
+      vsum = (v8sf){ 0 };
+      block = 0;
+    }
+  }
+
+  for (j = 0; j < 8; j++)
+  {
+    *sum += vsum[j];
+    s->count += (uint64_t)vcnt[j];
+    if (vmin[j] < s->min) s->min = vmin[j];
+    if (vmax[j] > s->max) s->max = vmax[j];
+  }
+  return i;
+}
+
+/* the counters, exact up to 2^53 */
+static uint32_t scan_double(series_t *s, const double *col, uint32_t n, double *sum)
+{
+  const v4df inf = { INFINITY, INFINITY, INFINITY, INFINITY };
+  v4df vmin = inf, vmax = -inf, vsum = { 0 };
+  v4di vcnt = { 0 };
+  uint32_t i = 0, j;
+
+  for (; i + 4 <= n; i += 4)
+  {
+    v4df v;
+    memcpy(&v, col + i, sizeof(v));
+    v4di valid = (v == v);
+    vsum += (v4df)((v4di)v & valid);
+    vcnt -= valid;
+    vmin = V4SELECT(v < vmin, v, vmin);
+    vmax = V4SELECT(v > vmax, v, vmax);
+  }
+
+  for (j = 0; j < 4; j++)
+  {
+    *sum += vsum[j];
+    s->count += (uint64_t)vcnt[j];
+    if (vmin[j] < s->min) s->min = vmin[j];
+    if (vmax[j] > s->max) s->max = vmax[j];
+  }
+  return i;
+}
+
+static inline double column_value(const void *col, uint32_t type, uint32_t i)
+{
+  return (type == HISTORY_DOUBLE) ? ((const double *)col)[i] : (double)((const float *)col)[i];
+}
+
+static void scan_column(series_t *s, const void *col, uint32_t type, const int64_t *times, uint32_t lo, uint32_t hi)
+{
+  double sum = 0, v;
+  uint32_t i;
+
+  if (type == HISTORY_DOUBLE)
+    i = lo + scan_double(s, (const double *)col + lo, hi - lo, &sum);
+  else
+    i = lo + scan_float(s, (const float *)col + lo, hi - lo, &sum);
+
+  for (; i < hi; i++)
+  {
+    v = column_value(col, type, i);
+    if (v == v)
+    {
+      sum += v;
+      s->count++;
+      if (v < s->min) s->min = v;
+      if (v > s->max) s->max = v;
+    }
+  }
+  s->sum += sum;
+
+  /* segments are scanned in time order */
+  for (i = lo; i < hi && isnan(column_value(col, type, i)); i++)
+    ;
+  if (i < hi && s->first_ms == INT64_MIN)
+  {
+    s->first = column_value(col, type, i);
+    s->first_ms = times[i];
+  }
+  for (i = hi; i > lo && isnan(column_value(col, type, i-1)); i--)
+    ;
+  if (i > lo)
+  {
+    s->last = column_value(col, type, i-1);
+    s->last_ms = times[i-1];
+  }
+}
+
+static int gather_column(series_t *s, const void *col, uint32_t type, uint32_t lo, uint32_t hi)
+{
+  uint32_t i;
+  double v;
+
+  if (s->nvalues + (hi - lo) > s->values_alloc)
+  {
+    size_t alloc = s->values_alloc ? s->values_alloc : 4096;
+    double *values;
+    while (alloc < s->nvalues + (hi - lo))
+      alloc <<= 1;
+    if (!(values = (double *)realloc(s->values, alloc*sizeof(double))))
+      return -1;
+    s->values = values;
+    s->values_alloc = alloc;
+  }
+  for (i = lo; i < hi; i++)
+  {
+    v = column_value(col, type, i);
+    if (v == v)
+      s->values[s->nvalues++] = v;
+  }
+  return 0;
+}
+
+/* Hoare selection, the array is partially reordered so successive calls
+ * stay valid */
+static double select_nth(double *v, size_t n, size_t k)
+{
+  size_t lo = 0, hi = n - 1;
+
+  while (lo < hi)
+  {
+    size_t i = lo, j = hi;
+    double pivot = v[lo + (hi - lo) / 2];
+    while (i <= j)
+    {
+      while (v[i] < pivot) i++;
+      while (v[j] > pivot) j--;
+      if (i <= j)
+      {
+        double t = v[i]; v[i] = v[j]; v[j] = t;
+        i++;
+        if (j == 0)
+          break;
+        j--;
+      }
+    }
+    if (k <= j)
+      hi = j;
+    else if (k >= i)
+      lo = i;
+    else
+      break;
+  }
+  return v[k];
+}
+
+/******************************************************************************************************************
+ * series set
+ *****************************************************************************************************************/
+
+static series_t *series_get(series_set_t *set, const char *name, int create)
+{
+  uint32_t i;
+
+  if (set->hash)
+    for (i = jsonscan_hash(name, strlen(name)) & set->hashmask; set->hash[i]; i = (i + 1) & set->hashmask)
+      if (!strcmp(set->tab[set->hash[i]-1].name, name))
+        return set->tab + set->hash[i] - 1;
+
+  if (!create)
+    return NULL;
+
+  if (set->nb == set->alloc || !set->hash)
+  {
+    size_t alloc = set->alloc ? 2*set->alloc : 256, k;
+    series_t *tab = (series_t *)realloc(set->tab, alloc*sizeof(series_t));
+    uint32_t *hash = (uint32_t *)calloc(2*alloc, sizeof(uint32_t));
+    if (!tab || !hash)
+    {
+      free(hash);
+      return NULL;
+    }
+    set->tab = tab;
+    set->alloc = alloc;
+    free(set->hash);
+    set->hash = hash;
+    set->hashmask = (uint32_t)(2*alloc - 1);
+    for (k = 0; k < set->nb; k++)
+    {
+      for (i = jsonscan_hash(set->tab[k].name, strlen(set->tab[k].name)) & set->hashmask; set->hash[i]; i = (i + 1) & set->hashmask)
+        ;
+      set->hash[i] = (uint32_t)k + 1;
+    }
+  }
+
+  series_t *s = set->tab + set->nb;
+  memset(s, 0, sizeof(*s));
+  strncpy(s->name, name, sizeof(s->name) - 1);
+  s->min = INFINITY;
+  s->max = -INFINITY;
+  s->first_ms = INT64_MIN;
+  for (i = jsonscan_hash(name, strlen(name)) & set->hashmask; set->hash[i]; i = (i + 1) & set->hashmask)
+    ;
+  set->hash[i] = (uint32_t)++set->nb;
+  return s;
+}
+
+static int compare_series(const void *a, const void *b)
+{
+  /* all the paths sharing a prefix stay contiguous in this order */
+  return strcmp(((const series_t *)a)->name, ((const series_t *)b)->name);
+}
+
+/******************************************************************************************************************
+ * output
+ *****************************************************************************************************************/
+
+static void append_value(GString *out, const char *key, size_t lkey, const agg_t *agg, series_t *s)
+{
+  double v = 0;
+
+  switch (agg->type)
+  {
+  case AGG_MIN:   v = s->min; break;
+  case AGG_MAX:   v = s->max; break;
+  case AGG_AVG:   v = s->sum / s->count; break;
+  case AGG_LAST:  v = s->last; break;
+  case AGG_COUNT:
+    g_string_append_printf(out, "\"%.*s_count\":%" PRIu64, (int)lkey, key, s->count);
+    return;
+  case AGG_RATE:
+    v = (s->last_ms > s->first_ms) ? (s->last - s->first) * 1000.0 / (double)(s->last_ms - s->first_ms) : 0;
+    break;
+  case AGG_PCT:
+    {
+      size_t k = (size_t)ceil(agg->pct * (double)s->nvalues / 100.0);
+      v = (s->sketch) ? sketch_quantile(s->sketch, agg->pct / 100.0) : select_nth(s->values, s->nvalues, k ? k - 1 : 0);
+    }
+    break;
+  }
+  g_string_append_printf(out, "\"%.*s_%s\":%.1f", (int)lkey, key, agg->suffix, v);
+}
+
+static void append_series(GString *out, series_set_t *set, agg_t *aggs, int naggs)
+{
+  const char *open[JSONSCAN_DEPTH_MAX];
+  size_t lopen[JSONSCAN_DEPTH_MAX];
+  int depth = 0, first = 1, emitted = 0;
+  size_t n;
+  int a;
+
+  for (n = 0; n < set->nb; n++)
+  {
+    series_t *s = set->tab + n;
+    const char *seg[JSONSCAN_DEPTH_MAX], *p, *q;
+    size_t lseg[JSONSCAN_DEPTH_MAX];
+    int nseg = 0, common;
+
+    if (!s->count)
+      continue;
+
+    for (p = s->name; nseg < JSONSCAN_DEPTH_MAX; p = q + 1)
+    {
+      q = strchr(p, '.');
+      seg[nseg] = p;
+      lseg[nseg++] = q ? (size_t)(q - p) : strlen(p);
+      if (!q)
+        break;
+    }
+
+    /* the last element is the leaf key */
+    for (common = 0; common < depth && common < nseg - 1
+         && lopen[common] == lseg[common] && !memcmp(open[common], seg[common], lseg[common]); common++)
+      ;
+    for (; depth > common; depth--)
+    {
+      g_string_append(out, "}");
+      first = 0;
+    }
+    for (; depth < nseg - 1; depth++)
+    {
+      g_string_append_printf(out, "%s\"%.*s\":{", first ? "" : ",", (int)lseg[depth], seg[depth]);
+      open[depth] = seg[depth];
+      lopen[depth] = lseg[depth];
+      first = 1;
+    }
+    for (a = 0; a < naggs; a++)
+    {
+      if (!first)
+        g_string_append(out, ",");
+      append_value(out, seg[nseg-1], lseg[nseg-1], aggs + a, s);
+      first = 0;
+    }
+    emitted = 1;
+  }
+  for (; depth > 0; depth--)
+    g_string_append(out, "}");
+  if (emitted)
+    g_string_append(out, ",");
+}
+
+/******************************************************************************************************************
+ * main
+ *****************************************************************************************************************/
+
+static int parse_aggs(char *list, agg_t *aggs)
+{
+  int n = 0;
+  char *tok, *save = NULL;
+
+  for (tok = strtok_r(list, ",", &save); tok && n < MAX_AGGS; tok = strtok_r(NULL, ",", &save))
+  {
+    agg_t *agg = aggs + n;
+    agg->pct = 0;
+    if (!strcmp(tok, "min"))        agg->type = AGG_MIN;
+    else if (!strcmp(tok, "max"))   agg->type = AGG_MAX;
+    else if (!strcmp(tok, "avg"))   agg->type = AGG_AVG;
+    else if (!strcmp(tok, "last"))  agg->type = AGG_LAST;
+    else if (!strcmp(tok, "count")) agg->type = AGG_COUNT;
+    else if (!strcmp(tok, "rate"))  agg->type = AGG_RATE;
+    else if (*tok == 'p' && atoi(tok+1) > 0 && atoi(tok+1) <= 100)
+    {
+      agg->type = AGG_PCT;
+      agg->pct = atoi(tok+1);
+    }
+    else
+      return -1;
+    if (agg->type == AGG_RATE)
+      strcpy(agg->suffix, "rate_s");
+    else
+      snprintf(agg->suffix, sizeof(agg->suffix), "%s", tok);
+    n++;
+  }
+  return n;
+}
+
+/******************************************************************************************************************
+ * merge of the sketches of a json stream
+ *****************************************************************************************************************/
+
+typedef struct {
+  series_set_t set;
+  char **patterns;
+  int npatterns;
+  sketch_t sketch;
+  char host[HISTORY_NAME_MAX];
+  int64_t from, to;
+  uint64_t invalid;
+} sketches_t;
+
+/* each "<key>_sk" adds its counts to the series of "<path>.<key>" */
+static int sketch_field(const jsonscan_field_t *field, void *data)
+{
+  sketches_t *ctx = (sketches_t *)data;
+  char name[HISTORY_NAME_MAX];
+  int p, match = !ctx->npatterns;
+  series_t *s;
+
+  if (!strcmp(field->path, "server"))
+  {
+    if (!*ctx->host && field->lvalue < sizeof(ctx->host))
+      memcpy(ctx->host, field->value, field->lvalue);
+    return 0;
+  }
+  if (!strcmp(field->path, "timestamp"))
+  {
+    int64_t t = strtoll(field->value, NULL, 10);
+    if (t < ctx->from) ctx->from = t;
+    if (t > ctx->to) ctx->to = t;
+    return 0;
+  }
+  if (field->lkey <= 3 || memcmp(field->key + field->lkey - 3, "_sk", 3) || field->lpath - 3 >= sizeof(name))
+    return 0;
+
+  memcpy(name, field->path, field->lpath - 3);
+  name[field->lpath - 3] = '\0';
+  for (p = 0; p < ctx->npatterns && !match; p++)
+    match = jsonscan_match(ctx->patterns[p], name);
+  if (!match)
+    return 0;
+
+  if (sketch_parse(&ctx->sketch, field->value))
+  {
+    ctx->invalid++;
+    return 0;
+  }
+  if (!(s = series_get(&ctx->set, name, 1)) || (!s->sketch && !(s->sketch = (sketch_t *)calloc(1, sizeof(sketch_t)))))
+    return 1;
+  sketch_merge(s->sketch, &ctx->sketch);
+  s->count = s->sketch->count;
+  s->max = s->sketch->max;
+  return 0;
+}
+
+/* The json lines of stdin, ie the syslog of several hosts, the text before
+ * the json is skipped. The lines out of the window are ignored.
+ */
+static int query_sketches(char **patterns, int npatterns, int64_t from_ms, int64_t to_ms,
+                          agg_t *aggs, int naggs, const char *sep)
+{
+  sketches_t ctx;
+  char *line = NULL, *json, *ts;
+  size_t alloc = 0;
+  ssize_t len;
+  size_t n;
+  int ret = 0;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.patterns = patterns;
+  ctx.npatterns = npatterns;
+  ctx.from = INT64_MAX;
+  ctx.to = INT64_MIN;
+
+  while (!ret && (len = getline(&line, &alloc, stdin)) > 0)
+  {
+    if (!(json = memchr(line, '{', (size_t)len)))
+      continue;
+    if ((ts = strstr(json, "\"timestamp\":")) != NULL)
+    {
+      int64_t t = strtoll(ts + 12, NULL, 10) * 1000;
+      if (t < from_ms || t > to_ms)
+        continue;
+    }
+    if (jsonscan_strings(json, (size_t)(line + len - json), sketch_field, &ctx) > 0)
+      ret = 1;
+  }
+  free(line);
+  if (ret)
+    fprintf(stderr, "out of memory\n");
+  if (ctx.invalid)
+    fprintf(stderr, "%" PRIu64 " sketches of another layout ignored\n", ctx.invalid);
+
+  qsort(ctx.set.tab, ctx.set.nb, sizeof(series_t), compare_series);
+
+  GString *out = g_string_sized_new(4096);
+  g_string_assign(out, "{");
+  append_series(out, &ctx.set, aggs, naggs);
+  g_string_append_printf(out, "\"server\":\"%s\",\"from\":%" PRId64 ",\"to\":%" PRId64 "}%s\n",
+                         ctx.host, (ctx.from == INT64_MAX) ? 0 : ctx.from, (ctx.to == INT64_MIN) ? 0 : ctx.to, sep);
+  fwrite(out->str, 1, out->len, stdout);
+  g_string_free(out, 1);
+
+  for (n = 0; n < ctx.set.nb; n++)
+    free(ctx.set.tab[n].sketch);
+  free(ctx.set.tab);
+  free(ctx.set.hash);
+  return ret;
+}
+
+static void usage()
+{
+  printf("Usage : " PACKAGE_NAME "-query {-d <dir> | -s} [-f <field>]... [-l <n>] [-b <t>] [-e <t>] [-a <aggs>] [-R]\n\n"
+      " -d    History directory written by " PACKAGE_NAME " -H\n"
+      " -s    Merge the sketches (_sk) of the json lines of stdin instead, ie the syslog\n"
+      "       of several hosts, only max, count and p<n> apply\n"
+      " -f    Field path, '*' and '?' match inside one level, ie disks.*.busy_pct\n"
+      "       (all fields when omitted, may be repeated)\n"
+      " -l    Last <n> seconds\n"
+      " -b    Begin of the window (epoch seconds)\n"
+      " -e    End of the window (epoch seconds)\n"
+      " -a    Aggregates among min,max,avg,last,count,rate,p<n> (default min,max,avg)\n"
+      " -R    More human Readable output\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+  char *dir = NULL, *patterns[MAX_PATTERNS];
+  char aggsopt[256] = "min,max,avg", *sep = "";
+  agg_t aggs[MAX_AGGS];
+  int npatterns = 0, naggs, opt, i, gather = 0, sketches = 0;
+  int64_t from_ms = INT64_MIN, to_ms = INT64_MAX;
+  struct dirent **dents = NULL;
+  history_segment_t *segs;
+  series_set_t set = { NULL, 0, 0, NULL, 0 };
+  char host[sizeof(((history_header_t *)0)->host) + 1] = "";
+  int nsegs, ndents;
+
+  while ((opt = getopt(argc, argv, "d:sf:l:b:e:a:Rh?")) != -1)
+  {
+    switch (opt) {
+    case 'd':
+      dir = optarg;
+      break;
+    case 's':
+      sketches = 1;
+      break;
+    case 'f':
+      if (npatterns < MAX_PATTERNS)
+        patterns[npatterns++] = optarg;
+      break;
+    case 'l':
+      to_ms = (int64_t)time(NULL) * 1000;
+      from_ms = to_ms - (int64_t)atoll(optarg) * 1000;
+      break;
+    case 'b':
+      from_ms = (int64_t)atoll(optarg) * 1000;
+      break;
+    case 'e':
+      to_ms = (int64_t)atoll(optarg) * 1000;
+      break;
+    case 'a':
+      snprintf(aggsopt, sizeof(aggsopt), "%s", optarg);
+      break;
+    case 'R':
+      sep = "\n";
+      break;
+    case 'h':
+    case '?':
+    default:
+      usage();
+      return 0;
+    }
+  }
+
+  if ((!dir && !sketches) || (naggs = parse_aggs(aggsopt, aggs)) <= 0)
+  {
+    usage();
+    return 1;
+  }
+  for (i = 0; i < naggs; i++)
+  {
+    gather |= (aggs[i].type == AGG_PCT);
+    if (sketches && aggs[i].type != AGG_MAX && aggs[i].type != AGG_COUNT && aggs[i].type != AGG_PCT)
+    {
+      fprintf(stderr, "only max, count and p<n> apply to the sketches\n");
+      return 1;
+    }
+  }
+  if (sketches)
+    return query_sketches(patterns, npatterns, from_ms, to_ms, aggs, naggs, sep);
+
+  if ((ndents = scandir(dir, &dents, history_segment_filter, alphasort)) < 0)
+  {
+    perror(dir);
+    return 1;
+  }
+
+  segs = (history_segment_t *)calloc(ndents ? ndents : 1, sizeof(history_segment_t));
+  for (i = 0, nsegs = 0; i < ndents; i++)
+  {
+    char path[PATH_MAX];
+    history_segment_t *seg = segs + nsegs;
+    snprintf(path, sizeof(path), "%s/%s", dir, dents[i]->d_name);
+    free(dents[i]);
+    if (history_segment_map(seg, path))
+      continue;
+    if (!seg->hdr->count || seg->hdr->last_ms < from_ms || seg->hdr->first_ms > to_ms)
+    {
+      history_segment_unmap(seg);
+      continue;
+    }
+    if (!*host)
+      memcpy(host, seg->hdr->host, sizeof(seg->hdr->host));
+    nsegs++;
+  }
+  free(dents);
+
+  for (i = 0; i < nsegs; i++)
+  {
+    history_segment_t *seg = segs + i;
+    uint32_t c, lo = history_segment_lower_bound(seg, from_ms);
+    uint32_t hi = (to_ms == INT64_MAX) ? seg->hdr->count : history_segment_lower_bound(seg, to_ms + 1);
+
+    if (lo >= hi)
+      continue;
+
+    for (c = 0; c < seg->hdr->nfields; c++)
+    {
+      const char *name = HISTORY_NAME(seg, c);
+      uint32_t from = (lo > HISTORY_DIR(seg, c)->first) ? lo : HISTORY_DIR(seg, c)->first;
+      int p, match = !npatterns;
+      series_t *s;
+
+      /* the column was added after the range */
+      if (from >= hi)
+        continue;
+
+      for (p = 0; p < npatterns && !match; p++)
+        match = jsonscan_match(patterns[p], name);
+      if (!match || !(s = series_get(&set, name, 1)))
+        continue;
+
+      scan_column(s, HISTORY_COLUMN(seg, c), HISTORY_DIR(seg, c)->type, seg->times, from, hi);
+      if (gather && gather_column(s, HISTORY_COLUMN(seg, c), HISTORY_DIR(seg, c)->type, from, hi))
+      {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+      }
+    }
+  }
+
+  qsort(set.tab, set.nb, sizeof(series_t), compare_series);
+
+  GString *out = g_string_sized_new(4096);
+  g_string_assign(out, "{");
+  append_series(out, &set, aggs, naggs);
+  g_string_append_printf(out, "\"server\":\"%s\",\"from\":%" PRId64 ",\"to\":%" PRId64 "}%s\n",
+                         host,
+                         (from_ms == INT64_MIN) ? (nsegs ? segs[0].hdr->first_ms/1000 : 0) : from_ms/1000,
+                         (to_ms == INT64_MAX) ? (nsegs ? segs[nsegs-1].hdr->last_ms/1000 : 0) : to_ms/1000,
+                         sep);
+  fwrite(out->str, 1, out->len, stdout);
+  g_string_free(out, 1);
+
+  for (i = 0; i < nsegs; i++)
+    history_segment_unmap(segs + i);
+  free(segs);
+  for (i = 0; i < (int)set.nb; i++)
+    free(set.tab[i].values);
+  free(set.tab);
+  free(set.hash);
+  return 0;
+}
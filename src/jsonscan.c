@@ -0,0 +1,178 @@
+/* jsonscan.c
+ *
+ * Flat scanner over the json produced by jsonperfmon.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <string.h>
+
+#include "jsonscan.h"
+
+#define ISNUMCHAR(c) (((c) >= '0' && (c) <= '9') || (c) == '-' || (c) == '+' || (c) == '.' || (c) == 'e' || (c) == 'E')
+
+/* the key is appended to the path of its object, an oversized path is ignored */
+static int jsonscan_field(char *path, size_t lpath, const char *key, size_t lkey,
+                          const char *value, size_t lvalue, jsonscan_cb_t cb, void *data)
+{
+  jsonscan_field_t field;
+  size_t l = lpath;
+
+  if (lpath + lkey + 1 >= JSONSCAN_PATH_MAX)
+    return 0;
+  if (l)
+    path[l++] = '.';
+  memcpy(path + l, key, lkey);
+  path[l + lkey] = '\0';
+
+  field.path = path;
+  field.lpath = l + lkey;
+  field.key = path + l;
+  field.lkey = lkey;
+  field.value = value;
+  field.lvalue = lvalue;
+  return (*cb)(&field, data);
+}
+
+static int jsonscan_run(const char *json, size_t len, jsonscan_cb_t cb, void *data, int strings)
+{
+  char path[JSONSCAN_PATH_MAX];
+  size_t stack[JSONSCAN_DEPTH_MAX];
+  int depth = 0;
+  size_t lpath = 0;
+  const char *p = json, *end = json + len, *key = NULL, *s;
+  size_t lkey = 0;
+
+  while (p < end)
+  {
+    switch (*p)
+    {
+    case '{':
+      if (depth == JSONSCAN_DEPTH_MAX)
+        return -1;
+      stack[depth++] = lpath;
+      if (key)
+      {
+        /* an oversized path is kept truncated, its fields are ignored */
+        if (lpath + lkey + 1 < sizeof(path))
+        {
+          if (lpath)
+            path[lpath++] = '.';
+          memcpy(path + lpath, key, lkey);
+          lpath += lkey;
+        }
+        else
+          lpath = sizeof(path);
+        key = NULL;
+      }
+      p++;
+      break;
+
+    case '}':
+      if (depth)
+        lpath = stack[--depth];
+      key = NULL;
+      p++;
+      break;
+
+    case '"':
+      for (s = ++p; p < end && *p != '"'; p++)
+        if (*p == '\\' && p + 1 < end)
+          p++;
+      /* the string value of a key, as is between its quotes */
+      if (strings && key)
+      {
+        if (jsonscan_field(path, lpath, key, lkey, s, p - s, cb, data))
+          return 1;
+        key = NULL;
+        p++;
+        break;
+      }
+      lkey = p - s;
+      for (p++; p < end && (*p == ' ' || *p == '\t'); p++)
+        ;
+      if (p < end && *p == ':')
+      {
+        key = s;
+        p++;
+      }
+      else
+        key = NULL;
+      break;
+
+    default:
+      if ((*p >= '0' && *p <= '9') || *p == '-')
+      {
+        for (s = p; p < end && ISNUMCHAR(*p); p++)
+          ;
+        if (key && jsonscan_field(path, lpath, key, lkey, s, p - s, cb, data))
+          return 1;
+        key = NULL;
+      }
+      else
+      {
+        /* separators, spaces and the true/false/null litterals */
+        if (*p != ' ' && *p != ',' && *p != '\n' && *p != '\t')
+          key = NULL;
+        p++;
+      }
+    }
+  }
+  return 0;
+}
+
+int jsonscan(const char *json, size_t len, jsonscan_cb_t cb, void *data)
+{
+  return jsonscan_run(json, len, cb, data, 0);
+}
+
+int jsonscan_strings(const char *json, size_t len, jsonscan_cb_t cb, void *data)
+{
+  return jsonscan_run(json, len, cb, data, 1);
+}
+
+int jsonscan_match(const char *pattern, const char *path)
+{
+  for (; *pattern; pattern++, path++)
+  {
+    if (*pattern == '*')
+    {
+      /* try every length not crossing a separator */
+      for (;; path++)
+      {
+        if (jsonscan_match(pattern + 1, path))
+          return 1;
+        if (!*path || *path == '.')
+          return 0;
+      }
+    }
+    if (!*path || (*pattern == '?' ? *path == '.' : *pattern != *path))
+      return 0;
+  }
+  return !*path;
+}
+
+uint32_t jsonscan_hash(const char *str, size_t len)
+{
+  uint32_t h = 2166136261U;
+  for (; len; str++, len--)
+    h = (h ^ (unsigned char)*str) * 16777619U;
+  return h;
+}
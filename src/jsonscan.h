@@ -0,0 +1,62 @@
+/* jsonscan.h
+ *
+ * Flat scanner over the json produced by jsonperfmon.
+ *
+ * The collectors build their json with printf like formats, so the only way
+ * to get back the numeric values (history, windows, rules...) is to walk the
+ * produced text. The output is known to be simple: objects, strings and
+ * numbers without any array, so a single pass without allocation is enough.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _JSONSCAN_H
+#define _JSONSCAN_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define JSONSCAN_PATH_MAX  256
+#define JSONSCAN_DEPTH_MAX 16
+
+typedef struct {
+  const char *path;    /* dotted path of the field, ie "disks.sda.busy_pct" */
+  size_t lpath;
+  const char *key;     /* last element of the path */
+  size_t lkey;
+  const char *value;   /* numeric token as printed */
+  size_t lvalue;
+} jsonscan_field_t;
+
+/* called for each numeric field, a non zero return stops the scan */
+typedef int (*jsonscan_cb_t)(const jsonscan_field_t *field, void *data);
+
+int jsonscan(const char *json, size_t len, jsonscan_cb_t cb, void *data);
+/* the same with the string fields too, their value is the text between the quotes */
+int jsonscan_strings(const char *json, size_t len, jsonscan_cb_t cb, void *data);
+
+/* '*' and '?' never match the '.' separator so "disks.*.busy_pct" selects
+ * one level only */
+int jsonscan_match(const char *pattern, const char *path);
+
+/* FNV-1a of a path, used to key the fields by name */
+uint32_t jsonscan_hash(const char *str, size_t len);
+
+#endif /* _JSONSCAN_H */
@@ -0,0 +1,112 @@
+/* memkeys.c
+ *
+ * Keys of /proc/meminfo and /proc/vmstat of Linux.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <string.h>
+
+#include "memkeys.h"
+
+/* FNV-1a of the name from the seed, the top bits give the slot. The offset
+ * basis of FNV is 0x811c9dc5, 0x811c9de8 is the first without a collision */
+#define MEMKEYS_BITS 13
+#define MEMKEYS_SEED 0x811c9de8u
+#define MEMKEYS_PRIME 0x01000193u
+#define MEMKEYS_SLOT(h) ((h) >> (32 - MEMKEYS_BITS))
+
+const memkey_t memkeys[MEMKEY_MAX] = {
+#define MEMKEY_ENTRY(id, name, kind) { name, sizeof(name) - 1, kind },
+  MEMKEYS_MEMINFO_LIST(MEMKEY_ENTRY)
+  MEMKEYS_VMSTAT_LIST(MEMKEY_ENTRY)
+#undef MEMKEY_ENTRY
+};
+
+/* key + 1 of each slot, 0 for none */
+static uint16_t memkeys_slots[1 << MEMKEYS_BITS];
+static uint32_t memkeys_seed;
+
+static uint32_t memkeys_hash(uint32_t h, const char *s, int len)
+{
+  while (len--)
+    h = (h ^ (unsigned char)*s++) * MEMKEYS_PRIME;
+  return h;
+}
+
+/* the seed gives no collision for the list above, the next ones are tried
+ * only if the list changes and it does not anymore */
+static void memkeys_build(void)
+{
+  uint32_t seed, slot;
+  int k;
+
+  for (seed = MEMKEYS_SEED; ; seed++)
+  {
+    memset(memkeys_slots, 0, sizeof(memkeys_slots));
+    for (k = 0; k < MEMKEY_MAX; k++)
+    {
+      slot = MEMKEYS_SLOT(memkeys_hash(seed, memkeys[k].name, memkeys[k].len));
+      if (memkeys_slots[slot])
+        break;
+      memkeys_slots[slot] = k + 1;
+    }
+    if (k == MEMKEY_MAX)
+      break;
+  }
+  memkeys_seed = seed;
+}
+
+int memkeys_find(const char *name)
+{
+  int len = strlen(name), k;
+
+  if (!memkeys_seed)
+    memkeys_build();
+  k = memkeys_slots[MEMKEYS_SLOT(memkeys_hash(memkeys_seed, name, len))] - 1;
+  return (k >= 0 && memkeys[k].len == len && !memcmp(memkeys[k].name, name, len)) ? k : -1;
+}
+
+void memkeys_parse(const char *buf, uint64_t keys[MEMKEY_MAX])
+{
+  const char *p, *key;
+  uint32_t h;
+  uint64_t v;
+  int k;
+
+  if (!memkeys_seed)
+    memkeys_build();
+  for (p = buf; *p; p += (*p == '\n'))
+  {
+    for (key = p, h = memkeys_seed; *p && *p != ':' && *p != ' ' && *p != '\n'; p++)
+      h = (h ^ (unsigned char)*p) * MEMKEYS_PRIME;
+    k = memkeys_slots[MEMKEYS_SLOT(h)] - 1;
+    if (k >= 0 && memkeys[k].len == p - key && !memcmp(memkeys[k].name, key, p - key))
+    {
+      while (*p == ':' || *p == ' ')
+        p++;
+      for (v = 0; *p >= '0' && *p <= '9'; p++)
+        v = v * 10 + (*p - '0');
+      keys[k] = v;
+    }
+    while (*p && *p != '\n')
+      p++;
+  }
+}
@@ -0,0 +1,329 @@
+/* memkeys.h
+ *
+ * Keys of /proc/meminfo and /proc/vmstat of Linux.
+ *
+ * The known keys of both files are listed once below and each gets a slot of
+ * a flat array of counters. The lines are matched through a perfect hash of
+ * the key names, computed while the key is scanned, so that a line costs one
+ * lookup whatever the number of keys. A key the list ignores is skipped, a
+ * key the kernel lacks stays at 0.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _MEMKEYS_H
+#define _MEMKEYS_H
+
+#include <inttypes.h>
+
+#define MEMKEYS_MEMINFO "/proc/meminfo"
+#define MEMKEYS_VMSTAT "/proc/vmstat"
+
+typedef enum {
+  MEMKIND_KB,           /* size in kB */
+  MEMKIND_GAUGE,        /* current number */
+  MEMKIND_EVENTS        /* counter since the boot */
+} MEMKIND_e;
+
+/* X(id, name, kind) */
+#define MEMKEYS_MEMINFO_LIST(X) \
+  X(MemTotal, "MemTotal", MEMKIND_KB) \
+  X(MemFree, "MemFree", MEMKIND_KB) \
+  X(MemAvailable, "MemAvailable", MEMKIND_KB) \
+  X(Buffers, "Buffers", MEMKIND_KB) \
+  X(Cached, "Cached", MEMKIND_KB) \
+  X(SwapCached, "SwapCached", MEMKIND_KB) \
+  X(Active, "Active", MEMKIND_KB) \
+  X(Inactive, "Inactive", MEMKIND_KB) \
+  X(Active_anon, "Active(anon)", MEMKIND_KB) \
+  X(Inactive_anon, "Inactive(anon)", MEMKIND_KB) \
+  X(Active_file, "Active(file)", MEMKIND_KB) \
+  X(Inactive_file, "Inactive(file)", MEMKIND_KB) \
+  X(Unevictable, "Unevictable", MEMKIND_KB) \
+  X(Mlocked, "Mlocked", MEMKIND_KB) \
+  X(SwapTotal, "SwapTotal", MEMKIND_KB) \
+  X(SwapFree, "SwapFree", MEMKIND_KB) \
+  X(Zswap, "Zswap", MEMKIND_KB) \
+  X(Zswapped, "Zswapped", MEMKIND_KB) \
+  X(Dirty, "Dirty", MEMKIND_KB) \
+  X(Writeback, "Writeback", MEMKIND_KB) \
+  X(AnonPages, "AnonPages", MEMKIND_KB) \
+  X(Mapped, "Mapped", MEMKIND_KB) \
+  X(Shmem, "Shmem", MEMKIND_KB) \
+  X(KReclaimable, "KReclaimable", MEMKIND_KB) \
+  X(Slab, "Slab", MEMKIND_KB) \
+  X(SReclaimable, "SReclaimable", MEMKIND_KB) \
+  X(SUnreclaim, "SUnreclaim", MEMKIND_KB) \
+  X(KernelStack, "KernelStack", MEMKIND_KB) \
+  X(PageTables, "PageTables", MEMKIND_KB) \
+  X(SecPageTables, "SecPageTables", MEMKIND_KB) \
+  X(NFS_Unstable, "NFS_Unstable", MEMKIND_KB) \
+  X(Bounce, "Bounce", MEMKIND_KB) \
+  X(WritebackTmp, "WritebackTmp", MEMKIND_KB) \
+  X(CommitLimit, "CommitLimit", MEMKIND_KB) \
+  X(Committed_AS, "Committed_AS", MEMKIND_KB) \
+  X(VmallocTotal, "VmallocTotal", MEMKIND_KB) \
+  X(VmallocUsed, "VmallocUsed", MEMKIND_KB) \
+  X(VmallocChunk, "VmallocChunk", MEMKIND_KB) \
+  X(Percpu, "Percpu", MEMKIND_KB) \
+  X(AnonHugePages, "AnonHugePages", MEMKIND_KB) \
+  X(ShmemHugePages, "ShmemHugePages", MEMKIND_KB) \
+  X(ShmemPmdMapped, "ShmemPmdMapped", MEMKIND_KB) \
+  X(FileHugePages, "FileHugePages", MEMKIND_KB) \
+  X(FilePmdMapped, "FilePmdMapped", MEMKIND_KB) \
+  X(Balloon, "Balloon", MEMKIND_KB) \
+  X(HugePages_Total, "HugePages_Total", MEMKIND_GAUGE) \
+  X(HugePages_Free, "HugePages_Free", MEMKIND_GAUGE) \
+  X(HugePages_Rsvd, "HugePages_Rsvd", MEMKIND_GAUGE) \
+  X(HugePages_Surp, "HugePages_Surp", MEMKIND_GAUGE) \
+  X(Hugepagesize, "Hugepagesize", MEMKIND_KB) \
+  X(Hugetlb, "Hugetlb", MEMKIND_KB) \
+  X(DirectMap4k, "DirectMap4k", MEMKIND_KB) \
+  X(DirectMap2M, "DirectMap2M", MEMKIND_KB) \
+  X(DirectMap1G, "DirectMap1G", MEMKIND_KB) \
+  X(CmaTotal, "CmaTotal", MEMKIND_KB) \
+  X(CmaFree, "CmaFree", MEMKIND_KB) \
+  X(HardwareCorrupted, "HardwareCorrupted", MEMKIND_KB) \
+  X(Unaccepted, "Unaccepted", MEMKIND_KB) \
+  X(ShadowCallStack, "ShadowCallStack", MEMKIND_KB) \
+  X(Quicklists, "Quicklists", MEMKIND_KB) \
+  X(DirectMap4M, "DirectMap4M", MEMKIND_KB)
+
+#define MEMKEYS_VMSTAT_LIST(X) \
+  X(nr_free_pages, "nr_free_pages", MEMKIND_GAUGE) \
+  X(nr_free_pages_blocks, "nr_free_pages_blocks", MEMKIND_GAUGE) \
+  X(nr_zone_inactive_anon, "nr_zone_inactive_anon", MEMKIND_GAUGE) \
+  X(nr_zone_active_anon, "nr_zone_active_anon", MEMKIND_GAUGE) \
+  X(nr_zone_inactive_file, "nr_zone_inactive_file", MEMKIND_GAUGE) \
+  X(nr_zone_active_file, "nr_zone_active_file", MEMKIND_GAUGE) \
+  X(nr_zone_unevictable, "nr_zone_unevictable", MEMKIND_GAUGE) \
+  X(nr_zone_write_pending, "nr_zone_write_pending", MEMKIND_GAUGE) \
+  X(nr_mlock, "nr_mlock", MEMKIND_GAUGE) \
+  X(nr_zspages, "nr_zspages", MEMKIND_GAUGE) \
+  X(nr_free_cma, "nr_free_cma", MEMKIND_GAUGE) \
+  X(numa_hit, "numa_hit", MEMKIND_EVENTS) \
+  X(numa_miss, "numa_miss", MEMKIND_EVENTS) \
+  X(numa_foreign, "numa_foreign", MEMKIND_EVENTS) \
+  X(numa_interleave, "numa_interleave", MEMKIND_EVENTS) \
+  X(numa_local, "numa_local", MEMKIND_EVENTS) \
+  X(numa_other, "numa_other", MEMKIND_EVENTS) \
+  X(nr_inactive_anon, "nr_inactive_anon", MEMKIND_GAUGE) \
+  X(nr_active_anon, "nr_active_anon", MEMKIND_GAUGE) \
+  X(nr_inactive_file, "nr_inactive_file", MEMKIND_GAUGE) \
+  X(nr_active_file, "nr_active_file", MEMKIND_GAUGE) \
+  X(nr_unevictable, "nr_unevictable", MEMKIND_GAUGE) \
+  X(nr_slab_reclaimable, "nr_slab_reclaimable", MEMKIND_GAUGE) \
+  X(nr_slab_unreclaimable, "nr_slab_unreclaimable", MEMKIND_GAUGE) \
+  X(nr_isolated_anon, "nr_isolated_anon", MEMKIND_GAUGE) \
+  X(nr_isolated_file, "nr_isolated_file", MEMKIND_GAUGE) \
+  X(workingset_nodes, "workingset_nodes", MEMKIND_GAUGE) \
+  X(workingset_refault_anon, "workingset_refault_anon", MEMKIND_EVENTS) \
+  X(workingset_refault_file, "workingset_refault_file", MEMKIND_EVENTS) \
+  X(workingset_activate_anon, "workingset_activate_anon", MEMKIND_EVENTS) \
+  X(workingset_activate_file, "workingset_activate_file", MEMKIND_EVENTS) \
+  X(workingset_restore_anon, "workingset_restore_anon", MEMKIND_EVENTS) \
+  X(workingset_restore_file, "workingset_restore_file", MEMKIND_EVENTS) \
+  X(workingset_nodereclaim, "workingset_nodereclaim", MEMKIND_EVENTS) \
+  X(nr_anon_pages, "nr_anon_pages", MEMKIND_GAUGE) \
+  X(nr_mapped, "nr_mapped", MEMKIND_GAUGE) \
+  X(nr_file_pages, "nr_file_pages", MEMKIND_GAUGE) \
+  X(nr_dirty, "nr_dirty", MEMKIND_GAUGE) \
+  X(nr_writeback, "nr_writeback", MEMKIND_GAUGE) \
+  X(nr_shmem, "nr_shmem", MEMKIND_GAUGE) \
+  X(nr_shmem_hugepages, "nr_shmem_hugepages", MEMKIND_GAUGE) \
+  X(nr_shmem_pmdmapped, "nr_shmem_pmdmapped", MEMKIND_GAUGE) \
+  X(nr_file_hugepages, "nr_file_hugepages", MEMKIND_GAUGE) \
+  X(nr_file_pmdmapped, "nr_file_pmdmapped", MEMKIND_GAUGE) \
+  X(nr_anon_transparent_hugepages, "nr_anon_transparent_hugepages", MEMKIND_GAUGE) \
+  X(nr_vmscan_write, "nr_vmscan_write", MEMKIND_EVENTS) \
+  X(nr_vmscan_immediate_reclaim, "nr_vmscan_immediate_reclaim", MEMKIND_EVENTS) \
+  X(nr_dirtied, "nr_dirtied", MEMKIND_EVENTS) \
+  X(nr_written, "nr_written", MEMKIND_EVENTS) \
+  X(nr_throttled_written, "nr_throttled_written", MEMKIND_EVENTS) \
+  X(nr_kernel_misc_reclaimable, "nr_kernel_misc_reclaimable", MEMKIND_GAUGE) \
+  X(nr_foll_pin_acquired, "nr_foll_pin_acquired", MEMKIND_EVENTS) \
+  X(nr_foll_pin_released, "nr_foll_pin_released", MEMKIND_EVENTS) \
+  X(nr_kernel_stack, "nr_kernel_stack", MEMKIND_GAUGE) \
+  X(nr_page_table_pages, "nr_page_table_pages", MEMKIND_GAUGE) \
+  X(nr_sec_page_table_pages, "nr_sec_page_table_pages", MEMKIND_GAUGE) \
+  X(nr_iommu_pages, "nr_iommu_pages", MEMKIND_GAUGE) \
+  X(nr_swapcached, "nr_swapcached", MEMKIND_GAUGE) \
+  X(pgpromote_success, "pgpromote_success", MEMKIND_EVENTS) \
+  X(pgpromote_candidate, "pgpromote_candidate", MEMKIND_EVENTS) \
+  X(pgpromote_candidate_nrl, "pgpromote_candidate_nrl", MEMKIND_EVENTS) \
+  X(pgdemote_kswapd, "pgdemote_kswapd", MEMKIND_EVENTS) \
+  X(pgdemote_direct, "pgdemote_direct", MEMKIND_EVENTS) \
+  X(pgdemote_khugepaged, "pgdemote_khugepaged", MEMKIND_EVENTS) \
+  X(pgdemote_proactive, "pgdemote_proactive", MEMKIND_EVENTS) \
+  X(nr_hugetlb, "nr_hugetlb", MEMKIND_GAUGE) \
+  X(nr_balloon_pages, "nr_balloon_pages", MEMKIND_GAUGE) \
+  X(nr_kernel_file_pages, "nr_kernel_file_pages", MEMKIND_GAUGE) \
+  X(nr_dirty_threshold, "nr_dirty_threshold", MEMKIND_GAUGE) \
+  X(nr_dirty_background_threshold, "nr_dirty_background_threshold", MEMKIND_GAUGE) \
+  X(nr_memmap_pages, "nr_memmap_pages", MEMKIND_GAUGE) \
+  X(nr_memmap_boot_pages, "nr_memmap_boot_pages", MEMKIND_GAUGE) \
+  X(pgpgin, "pgpgin", MEMKIND_EVENTS) \
+  X(pgpgout, "pgpgout", MEMKIND_EVENTS) \
+  X(pswpin, "pswpin", MEMKIND_EVENTS) \
+  X(pswpout, "pswpout", MEMKIND_EVENTS) \
+  X(pgalloc_dma, "pgalloc_dma", MEMKIND_EVENTS) \
+  X(pgalloc_dma32, "pgalloc_dma32", MEMKIND_EVENTS) \
+  X(pgalloc_normal, "pgalloc_normal", MEMKIND_EVENTS) \
+  X(pgalloc_movable, "pgalloc_movable", MEMKIND_EVENTS) \
+  X(pgalloc_device, "pgalloc_device", MEMKIND_EVENTS) \
+  X(allocstall_dma, "allocstall_dma", MEMKIND_EVENTS) \
+  X(allocstall_dma32, "allocstall_dma32", MEMKIND_EVENTS) \
+  X(allocstall_normal, "allocstall_normal", MEMKIND_EVENTS) \
+  X(allocstall_movable, "allocstall_movable", MEMKIND_EVENTS) \
+  X(allocstall_device, "allocstall_device", MEMKIND_EVENTS) \
+  X(pgskip_dma, "pgskip_dma", MEMKIND_EVENTS) \
+  X(pgskip_dma32, "pgskip_dma32", MEMKIND_EVENTS) \
+  X(pgskip_normal, "pgskip_normal", MEMKIND_EVENTS) \
+  X(pgskip_movable, "pgskip_movable", MEMKIND_EVENTS) \
+  X(pgskip_device, "pgskip_device", MEMKIND_EVENTS) \
+  X(pgfree, "pgfree", MEMKIND_EVENTS) \
+  X(pgactivate, "pgactivate", MEMKIND_EVENTS) \
+  X(pgdeactivate, "pgdeactivate", MEMKIND_EVENTS) \
+  X(pglazyfree, "pglazyfree", MEMKIND_EVENTS) \
+  X(pgfault, "pgfault", MEMKIND_EVENTS) \
+  X(pgmajfault, "pgmajfault", MEMKIND_EVENTS) \
+  X(pglazyfreed, "pglazyfreed", MEMKIND_EVENTS) \
+  X(pgrefill, "pgrefill", MEMKIND_EVENTS) \
+  X(pgreuse, "pgreuse", MEMKIND_EVENTS) \
+  X(pgsteal_kswapd, "pgsteal_kswapd", MEMKIND_EVENTS) \
+  X(pgsteal_direct, "pgsteal_direct", MEMKIND_EVENTS) \
+  X(pgsteal_khugepaged, "pgsteal_khugepaged", MEMKIND_EVENTS) \
+  X(pgsteal_proactive, "pgsteal_proactive", MEMKIND_EVENTS) \
+  X(pgscan_kswapd, "pgscan_kswapd", MEMKIND_EVENTS) \
+  X(pgscan_direct, "pgscan_direct", MEMKIND_EVENTS) \
+  X(pgscan_khugepaged, "pgscan_khugepaged", MEMKIND_EVENTS) \
+  X(pgscan_proactive, "pgscan_proactive", MEMKIND_EVENTS) \
+  X(pgscan_direct_throttle, "pgscan_direct_throttle", MEMKIND_EVENTS) \
+  X(pgscan_anon, "pgscan_anon", MEMKIND_EVENTS) \
+  X(pgscan_file, "pgscan_file", MEMKIND_EVENTS) \
+  X(pgsteal_anon, "pgsteal_anon", MEMKIND_EVENTS) \
+  X(pgsteal_file, "pgsteal_file", MEMKIND_EVENTS) \
+  X(zone_reclaim_success, "zone_reclaim_success", MEMKIND_EVENTS) \
+  X(zone_reclaim_failed, "zone_reclaim_failed", MEMKIND_EVENTS) \
+  X(pginodesteal, "pginodesteal", MEMKIND_EVENTS) \
+  X(slabs_scanned, "slabs_scanned", MEMKIND_EVENTS) \
+  X(kswapd_inodesteal, "kswapd_inodesteal", MEMKIND_EVENTS) \
+  X(kswapd_low_wmark_hit_quickly, "kswapd_low_wmark_hit_quickly", MEMKIND_EVENTS) \
+  X(kswapd_high_wmark_hit_quickly, "kswapd_high_wmark_hit_quickly", MEMKIND_EVENTS) \
+  X(pageoutrun, "pageoutrun", MEMKIND_EVENTS) \
+  X(pgrotated, "pgrotated", MEMKIND_EVENTS) \
+  X(drop_pagecache, "drop_pagecache", MEMKIND_EVENTS) \
+  X(drop_slab, "drop_slab", MEMKIND_EVENTS) \
+  X(oom_kill, "oom_kill", MEMKIND_EVENTS) \
+  X(numa_pte_updates, "numa_pte_updates", MEMKIND_EVENTS) \
+  X(numa_huge_pte_updates, "numa_huge_pte_updates", MEMKIND_EVENTS) \
+  X(numa_hint_faults, "numa_hint_faults", MEMKIND_EVENTS) \
+  X(numa_hint_faults_local, "numa_hint_faults_local", MEMKIND_EVENTS) \
+  X(numa_pages_migrated, "numa_pages_migrated", MEMKIND_EVENTS) \
+  X(pgmigrate_success, "pgmigrate_success", MEMKIND_EVENTS) \
+  X(pgmigrate_fail, "pgmigrate_fail", MEMKIND_EVENTS) \
+  X(thp_migration_success, "thp_migration_success", MEMKIND_EVENTS) \
+  X(thp_migration_fail, "thp_migration_fail", MEMKIND_EVENTS) \
+  X(thp_migration_split, "thp_migration_split", MEMKIND_EVENTS) \
+  X(compact_migrate_scanned, "compact_migrate_scanned", MEMKIND_EVENTS) \
+  X(compact_free_scanned, "compact_free_scanned", MEMKIND_EVENTS) \
+  X(compact_isolated, "compact_isolated", MEMKIND_EVENTS) \
+  X(compact_stall, "compact_stall", MEMKIND_EVENTS) \
+  X(compact_fail, "compact_fail", MEMKIND_EVENTS) \
+  X(compact_success, "compact_success", MEMKIND_EVENTS) \
+  X(compact_daemon_wake, "compact_daemon_wake", MEMKIND_EVENTS) \
+  X(compact_daemon_migrate_scanned, "compact_daemon_migrate_scanned", MEMKIND_EVENTS) \
+  X(compact_daemon_free_scanned, "compact_daemon_free_scanned", MEMKIND_EVENTS) \
+  X(htlb_buddy_alloc_success, "htlb_buddy_alloc_success", MEMKIND_EVENTS) \
+  X(htlb_buddy_alloc_fail, "htlb_buddy_alloc_fail", MEMKIND_EVENTS) \
+  X(unevictable_pgs_culled, "unevictable_pgs_culled", MEMKIND_EVENTS) \
+  X(unevictable_pgs_scanned, "unevictable_pgs_scanned", MEMKIND_EVENTS) \
+  X(unevictable_pgs_rescued, "unevictable_pgs_rescued", MEMKIND_EVENTS) \
+  X(unevictable_pgs_mlocked, "unevictable_pgs_mlocked", MEMKIND_EVENTS) \
+  X(unevictable_pgs_munlocked, "unevictable_pgs_munlocked", MEMKIND_EVENTS) \
+  X(unevictable_pgs_cleared, "unevictable_pgs_cleared", MEMKIND_EVENTS) \
+  X(unevictable_pgs_stranded, "unevictable_pgs_stranded", MEMKIND_EVENTS) \
+  X(thp_fault_alloc, "thp_fault_alloc", MEMKIND_EVENTS) \
+  X(thp_fault_fallback, "thp_fault_fallback", MEMKIND_EVENTS) \
+  X(thp_fault_fallback_charge, "thp_fault_fallback_charge", MEMKIND_EVENTS) \
+  X(thp_collapse_alloc, "thp_collapse_alloc", MEMKIND_EVENTS) \
+  X(thp_collapse_alloc_failed, "thp_collapse_alloc_failed", MEMKIND_EVENTS) \
+  X(thp_file_alloc, "thp_file_alloc", MEMKIND_EVENTS) \
+  X(thp_file_fallback, "thp_file_fallback", MEMKIND_EVENTS) \
+  X(thp_file_fallback_charge, "thp_file_fallback_charge", MEMKIND_EVENTS) \
+  X(thp_file_mapped, "thp_file_mapped", MEMKIND_EVENTS) \
+  X(thp_split_page, "thp_split_page", MEMKIND_EVENTS) \
+  X(thp_split_page_failed, "thp_split_page_failed", MEMKIND_EVENTS) \
+  X(thp_deferred_split_page, "thp_deferred_split_page", MEMKIND_EVENTS) \
+  X(thp_underused_split_page, "thp_underused_split_page", MEMKIND_EVENTS) \
+  X(thp_split_pmd, "thp_split_pmd", MEMKIND_EVENTS) \
+  X(thp_scan_exceed_none_pte, "thp_scan_exceed_none_pte", MEMKIND_EVENTS) \
+  X(thp_scan_exceed_swap_pte, "thp_scan_exceed_swap_pte", MEMKIND_EVENTS) \
+  X(thp_scan_exceed_share_pte, "thp_scan_exceed_share_pte", MEMKIND_EVENTS) \
+  X(thp_split_pud, "thp_split_pud", MEMKIND_EVENTS) \
+  X(thp_zero_page_alloc, "thp_zero_page_alloc", MEMKIND_EVENTS) \
+  X(thp_zero_page_alloc_failed, "thp_zero_page_alloc_failed", MEMKIND_EVENTS) \
+  X(thp_swpout, "thp_swpout", MEMKIND_EVENTS) \
+  X(thp_swpout_fallback, "thp_swpout_fallback", MEMKIND_EVENTS) \
+  X(balloon_inflate, "balloon_inflate", MEMKIND_EVENTS) \
+  X(balloon_deflate, "balloon_deflate", MEMKIND_EVENTS) \
+  X(balloon_migrate, "balloon_migrate", MEMKIND_EVENTS) \
+  X(swap_ra, "swap_ra", MEMKIND_EVENTS) \
+  X(swap_ra_hit, "swap_ra_hit", MEMKIND_EVENTS) \
+  X(swpin_zero, "swpin_zero", MEMKIND_EVENTS) \
+  X(swpout_zero, "swpout_zero", MEMKIND_EVENTS) \
+  X(ksm_swpin_copy, "ksm_swpin_copy", MEMKIND_EVENTS) \
+  X(cow_ksm, "cow_ksm", MEMKIND_EVENTS) \
+  X(zswpin, "zswpin", MEMKIND_EVENTS) \
+  X(zswpout, "zswpout", MEMKIND_EVENTS) \
+  X(zswpwb, "zswpwb", MEMKIND_EVENTS) \
+  X(direct_map_level2_splits, "direct_map_level2_splits", MEMKIND_EVENTS) \
+  X(direct_map_level3_splits, "direct_map_level3_splits", MEMKIND_EVENTS) \
+  X(direct_map_level2_collapses, "direct_map_level2_collapses", MEMKIND_EVENTS) \
+  X(direct_map_level3_collapses, "direct_map_level3_collapses", MEMKIND_EVENTS) \
+  X(nr_unstable, "nr_unstable", MEMKIND_GAUGE) \
+  X(nr_bounce, "nr_bounce", MEMKIND_GAUGE) \
+  X(nr_unaccepted, "nr_unaccepted", MEMKIND_GAUGE) \
+  X(workingset_refault, "workingset_refault", MEMKIND_EVENTS) \
+  X(workingset_activate, "workingset_activate", MEMKIND_EVENTS) \
+  X(workingset_restore, "workingset_restore", MEMKIND_EVENTS)
+
+typedef enum {
+#define MEMKEY_ENUM(id, name, kind) MEMKEY_ ## id,
+  MEMKEYS_MEMINFO_LIST(MEMKEY_ENUM)
+  MEMKEYS_VMSTAT_LIST(MEMKEY_ENUM)
+#undef MEMKEY_ENUM
+  MEMKEY_MAX
+} MEMKEY_e;
+
+typedef struct {
+  const char *name;
+  int len;
+  MEMKIND_e kind;
+} memkey_t;
+
+extern const memkey_t memkeys[MEMKEY_MAX];
+
+/* slot of a key name, -1 if unknown */
+int  memkeys_find(const char *name);
+/* the "key value" or "key: value" lines of buf into their slots */
+void memkeys_parse(const char *buf, uint64_t keys[MEMKEY_MAX]);
+
+#endif /* _MEMKEYS_H */
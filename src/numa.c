@@ -0,0 +1,238 @@
+/* numa.c
+ *
+ * Memory and locality of the NUMA nodes of Linux (/sys/devices/system/node).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "numa.h"
+#include "selfstat.h"
+
+void numa_init(numa_t *n)
+{
+  memset(n, 0, sizeof(*n));
+  memset(n->cpu_node, -1, sizeof(n->cpu_node));
+}
+
+static int numa_compare(const void *a, const void *b)
+{
+  return ((const numa_node_t *)a)->node - ((const numa_node_t *)b)->node;
+}
+
+/* list of ranges "0-3,8,10-11" of the cpus of the node i */
+static void numa_cpulist(numa_t *n, int i, int dirfd)
+{
+  char buf[4096], *p;
+  long from, to;
+  ssize_t r;
+  int fd;
+
+  n->nodes[i].ncpus = 0;
+  if ((fd = selfstat_openat(dirfd, "cpulist", O_RDONLY | O_CLOEXEC)) < 0)
+    return;
+  r = selfstat_read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (r <= 0)
+    return;
+  buf[r] = '\0';
+
+  for (p = buf; *p >= '0' && *p <= '9'; )
+  {
+    from = to = strtol(p, &p, 10);
+    if (*p == '-')
+      to = strtol(p + 1, &p, 10);
+    for (; from <= to && from < NUMA_CPUS; from++)
+    {
+      n->cpu_node[from] = i;
+      n->nodes[i].ncpus++;
+    }
+    if (*p == ',')
+      p++;
+  }
+}
+
+/* the files of the listed nodes, under the current root */
+static int numa_files(numa_t *n)
+{
+  char path[sizeof(NUMA_DIR) + 32];
+  int i, dirfd;
+
+  n->gen = selfstat_generation();
+  memset(n->cpu_node, -1, sizeof(n->cpu_node));
+  for (i = 0; i < n->nb; i++)
+  {
+    numa_node_t *node = n->nodes + i;
+
+    snprintf(path, sizeof(path), NUMA_DIR "/node%d", node->node);
+    if ((dirfd = selfstat_open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+      continue;
+    node->fd_meminfo = selfstat_openat(dirfd, "meminfo", O_RDONLY | O_CLOEXEC);
+    node->fd_numastat = selfstat_openat(dirfd, "numastat", O_RDONLY | O_CLOEXEC);
+    numa_cpulist(n, i, dirfd);
+    close(dirfd);
+  }
+  return 0;
+}
+
+int numa_open(numa_t *n)
+{
+  struct dirent *de;
+  DIR *dir;
+  void *p;
+  int max = 0;
+
+  if ((dir = selfstat_opendir(NUMA_DIR)) == NULL)
+    return -1;
+  while ((de = readdir(dir)) != NULL)
+  {
+    if (strncmp(de->d_name, "node", 4) || de->d_name[4] < '0' || de->d_name[4] > '9')
+      continue;
+    if (n->nb == max)
+    {
+      max = (max) ? max * 2 : 8;
+      if ((p = realloc(n->nodes, max * sizeof(numa_node_t))) == NULL)
+        break;
+      n->nodes = p;
+    }
+    memset(n->nodes + n->nb, 0, sizeof(numa_node_t));
+    n->nodes[n->nb].node = atoi(de->d_name + 4);
+    n->nodes[n->nb].fd_meminfo = n->nodes[n->nb].fd_numastat = -1;
+    n->nb++;
+  }
+  closedir(dir);
+  if (!n->nb)
+    return -1;
+  qsort(n->nodes, n->nb, sizeof(numa_node_t), numa_compare);
+  return numa_files(n);
+}
+
+/* "Node 0 MemFree:         2830936 kB" */
+static void numa_meminfo(int fd, numa_stat_t *st)
+{
+  char buf[4096], *p, *key;
+  ssize_t r;
+
+  if (fd < 0 || (r = selfstat_pread(fd, buf, sizeof(buf) - 1, 0)) <= 0)
+    return;
+  buf[r] = '\0';
+  for (p = buf; *p; )
+  {
+    uint64_t *v = NULL;
+
+    /* after "Node <n> " */
+    if ((key = strchr(p, ' ')) == NULL || (key = strchr(key + 1, ' ')) == NULL)
+      break;
+    key++;
+    if (!strncmp(key, "MemTotal:", 9))
+      v = &st->total_kb;
+    else if (!strncmp(key, "MemFree:", 8))
+      v = &st->free_kb;
+    else if (!strncmp(key, "MemUsed:", 8))
+      v = &st->used_kb;
+    else if (!strncmp(key, "FilePages:", 10))
+      v = &st->file_kb;
+    else if (!strncmp(key, "AnonPages:", 10))
+      v = &st->anon_kb;
+    if (v)
+      *v = strtoull(strchr(key, ':') + 1, NULL, 10);
+    if ((p = strchr(key, '\n')) == NULL)
+      break;
+    p++;
+  }
+}
+
+/* "numa_hit 15289182" */
+static void numa_numastat(int fd, numa_stat_t *st)
+{
+  char buf[1024], *p, *v;
+  ssize_t r;
+
+  if (fd < 0 || (r = selfstat_pread(fd, buf, sizeof(buf) - 1, 0)) <= 0)
+    return;
+  buf[r] = '\0';
+  for (p = buf; p && (v = strchr(p, ' ')); p = strchr(v, '\n'), p += (p != NULL))
+  {
+    uint64_t x = strtoull(v + 1, NULL, 10);
+
+    if (!strncmp(p, "numa_hit ", 9))
+      st->hit = x;
+    else if (!strncmp(p, "numa_miss ", 10))
+      st->miss = x;
+    else if (!strncmp(p, "numa_foreign ", 13))
+      st->foreign = x;
+    else if (!strncmp(p, "interleave_hit ", 15))
+      st->interleave = x;
+    else if (!strncmp(p, "local_node ", 11))
+      st->local = x;
+    else if (!strncmp(p, "other_node ", 11))
+      st->other = x;
+  }
+}
+
+int numa_read(numa_t *n, int odd)
+{
+  int i;
+
+  if (!n->nb)
+    return -1;
+  if (n->gen != selfstat_generation())
+  {
+    for (i = 0; i < n->nb; i++)
+    {
+      if (n->nodes[i].fd_meminfo >= 0)
+        close(n->nodes[i].fd_meminfo);
+      if (n->nodes[i].fd_numastat >= 0)
+        close(n->nodes[i].fd_numastat);
+      n->nodes[i].fd_meminfo = n->nodes[i].fd_numastat = -1;
+    }
+    numa_files(n);
+  }
+  for (i = 0; i < n->nb; i++)
+  {
+    numa_stat_t *st = &n->nodes[i].data[odd];
+
+    memset(st, 0, sizeof(*st));
+    numa_meminfo(n->nodes[i].fd_meminfo, st);
+    numa_numastat(n->nodes[i].fd_numastat, st);
+  }
+  return 0;
+}
+
+void numa_close(numa_t *n)
+{
+  int i;
+
+  for (i = 0; i < n->nb; i++)
+  {
+    if (n->nodes[i].fd_meminfo >= 0)
+      close(n->nodes[i].fd_meminfo);
+    if (n->nodes[i].fd_numastat >= 0)
+      close(n->nodes[i].fd_numastat);
+  }
+  free(n->nodes);
+  numa_init(n);
+}
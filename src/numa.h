@@ -0,0 +1,82 @@
+/* numa.h
+ *
+ * Memory and locality of the NUMA nodes of Linux (/sys/devices/system/node).
+ *
+ * The nodes are listed once, the meminfo and numastat files of each node
+ * stay open and are read with pread. The cpus of a node are read from its
+ * cpulist at the listing, the busy time of a node is summed by the cpus
+ * group from its own deltas so no file is read again for it.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _NUMA_H
+#define _NUMA_H
+
+#include <inttypes.h>
+
+#define NUMA_DIR "/sys/devices/system/node"
+#define NUMA_CPUS 4096
+
+typedef struct {
+  uint64_t total_kb;    /* meminfo */
+  uint64_t free_kb;
+  uint64_t used_kb;
+  uint64_t file_kb;
+  uint64_t anon_kb;
+  uint64_t hit;         /* numastat, in pages */
+  uint64_t miss;
+  uint64_t foreign;
+  uint64_t interleave;
+  uint64_t local;
+  uint64_t other;
+} numa_stat_t;
+
+typedef struct {
+  int node;
+  int fd_meminfo;
+  int fd_numastat;
+  int ncpus;
+  numa_stat_t data[2];
+  uint64_t ticks;       /* of its cpus, summed by the cpus group since the last collect */
+  uint64_t busy;
+  uint64_t user;
+  uint64_t sys;
+} numa_node_t;
+
+typedef struct {
+  unsigned int gen;
+  int nb;
+  numa_node_t *nodes;   /* by node number */
+  short cpu_node[NUMA_CPUS];    /* index in nodes of each cpu, -1 for none */
+} numa_t;
+
+void numa_init(numa_t *n);
+int  numa_open(numa_t *n);
+/* the nodes are listed again on a new root */
+int  numa_read(numa_t *n, int odd);
+void numa_close(numa_t *n);
+
+static inline numa_node_t *numa_cpu_node(numa_t *n, int cpu)
+{
+  return (n->nb && cpu >= 0 && cpu < NUMA_CPUS && n->cpu_node[cpu] >= 0) ? n->nodes + n->cpu_node[cpu] : NULL;
+}
+
+#endif /* _NUMA_H */
@@ -37,8 +37,12 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include "blockdev.h"
 #include "perflinux.h"
+#include "selfstat.h"
 
 #define PROCDIR "/proc"
 #define FC_HOSTDIR "/sys/class/fc_host"
@@ -60,6 +64,30 @@ struct {
   int nbcpu;
 } perfunix_cpu_data = { 0, 0, -1};
 
+/* columns of a cpu line of /proc/stat, the older kernels give less of them */
+enum CPU_TICK_e { TICK_USER, TICK_NICE, TICK_SYSTEM, TICK_IDLE, TICK_IOWAIT, TICK_IRQ,
+                  TICK_SOFTIRQ, TICK_STEAL, TICK_GUEST, TICK_GUEST_NICE, TICKS };
+
+/* the ticks of the cpu line at p, user and nice include guest and guest_nice
+ * in the kernel, they are removed so that the columns sum to the elapsed */
+static void perfunix_cpu_ticks(char *p, uint64_t t[TICKS])
+{
+  char *e;
+  int k;
+
+  for (k = 0; k < TICKS; k++, p = e)
+  {
+    t[k] = strtoull(p, &e, 10);
+    if (e == p)
+      break;
+  }
+  for (; k < TICKS; k++)
+    t[k] = 0;
+  t[TICK_USER] -= (t[TICK_GUEST] < t[TICK_USER]) ? t[TICK_GUEST] : t[TICK_USER];
+  t[TICK_NICE] -= (t[TICK_GUEST_NICE] < t[TICK_NICE]) ? t[TICK_GUEST_NICE] : t[TICK_NICE];
+  t[TICK_GUEST] += t[TICK_GUEST_NICE];
+}
+
 void perfunix_clean_all()
 {
   free(fc_host.sys_fc_host);
@@ -77,7 +105,7 @@ int perfunix_cpu_total(perfunix_id_t *name __attribute__((unused)), perfunix_cpu
   if (perfunix_cpu_data.nbcpu == -1)
   {
     perfunix_cpu_data.nbcpu = 0;
-    if ((f = fopen(PROCDIR FSDIRSEP "cpuinfo", "r")) != NULL)
+    if ((f = selfstat_fopen(PROCDIR FSDIRSEP "cpuinfo", "r")) != NULL)
     {
       while (fgets(buf,512,f))
       {
@@ -88,7 +116,7 @@ int perfunix_cpu_total(perfunix_id_t *name __attribute__((unused)), perfunix_cpu
                 perfunix_cpu_data.mhz = strtoull(buf+11, NULL, 10);
         }
       }
-      fclose(f);
+      selfstat_fclose(f);
     }
   }
 
@@ -96,31 +124,40 @@ int perfunix_cpu_total(perfunix_id_t *name __attribute__((unused)), perfunix_cpu
 
   uint64_t *ui64_buf = (uint64_t*)buf;
   uint32_t *ui32_buf = (uint32_t*)buf;
-  if ((f = fopen(PROCDIR FSDIRSEP "stat", "r")) != NULL)
+  uint64_t t[TICKS];
+  if ((f = selfstat_fopen(PROCDIR FSDIRSEP "stat", "r")) != NULL)
   {
     while (fgets(buf,512,f))
     {
       if(*ui32_buf == *((uint32_t*)"ctxt") )
         userbuff->pswitch = strtoull(buf+5, NULL, 10);     /* number of process switches (change in currently running process) */
+      else if(*ui64_buf == *((uint64_t*)"procs_ru"))
+        userbuff->runque = strtoull(buf+14, NULL, 10);     /* tasks running or ready to run */
       else if(*ui64_buf == *((uint64_t*)"procs_bl"))
-        userbuff->runque = strtoull(buf+14, NULL, 10);     /* number of process switches (change in currently running process) */
+        userbuff->blocked = strtoull(buf+14, NULL, 10);    /* tasks blocked on an I/O */
       else if(*ui32_buf == *((uint32_t*)"cpu ") || *ui32_buf == *((uint32_t*)"cpu\t"))
       {
-        userbuff->puser = strtoull(buf+4, &p, 10) + ((p) ? strtoull(++p, &p, 10) : 0);
-        userbuff->psys  = (p) ? strtoull(++p, &p, 10) : 0;
-        userbuff->pidle = (p) ? strtoull(++p, &p, 10) : 0;
-        userbuff->pwait = (p) ? strtoull(++p, &p, 10) : 0;
+        perfunix_cpu_ticks(buf+4, t);
+        userbuff->puser    = t[TICK_USER];
+        userbuff->pnice    = t[TICK_NICE];
+        userbuff->psys     = t[TICK_SYSTEM];
+        userbuff->pidle    = t[TICK_IDLE];
+        userbuff->pwait    = t[TICK_IOWAIT];
+        userbuff->pirq     = t[TICK_IRQ];
+        userbuff->psoftirq = t[TICK_SOFTIRQ];
+        userbuff->psteal   = t[TICK_STEAL];
+        userbuff->pguest   = t[TICK_GUEST];
       }
     }
-    fclose(f);
+    selfstat_fclose(f);
   }
-  if ((f = fopen(PROCDIR FSDIRSEP "loadavg", "r")) != NULL)
+  if ((f = selfstat_fopen(PROCDIR FSDIRSEP "loadavg", "r")) != NULL)
   {
     size_t l;
     fgets(buf,512,f);
     for (l = 0, p=buf; l<3; l++, p++)
       userbuff->loadavg_dbl[l] = strtod(p, &p);
-    fclose(f);
+    selfstat_fclose(f);
   }
 
   userbuff->processorHZ  = perfunix_cpu_data.mhz*1000000;
@@ -140,7 +177,7 @@ int perfunix_cpu(perfunix_id_t *name __attribute__((unused)), perfunix_cpu_t* us
 		if (perfunix_cpu_data.nbcpu == -1)
 		{
       perfunix_cpu_data.nbcpu = 0;
-			if ((f = fopen(PROCDIR FSDIRSEP "cpuinfo", "r")) != NULL)
+			if ((f = selfstat_fopen(PROCDIR FSDIRSEP "cpuinfo", "r")) != NULL)
 			{
 				while (fgets(buf, 512, f))
 				{
@@ -151,6 +188,7 @@ int perfunix_cpu(perfunix_id_t *name __attribute__((unused)), perfunix_cpu_t* us
 							perfunix_cpu_data.mhz = strtoull(buf + 14, NULL, 10);
 					}
 				}
+				selfstat_fclose(f);
 			}
 		}
 		return perfunix_cpu_data.nbcpu;
@@ -160,11 +198,12 @@ int perfunix_cpu(perfunix_id_t *name __attribute__((unused)), perfunix_cpu_t* us
     return -1;
 
   size_t s = 0;
+  uint64_t t[TICKS];
 
   uint32_t *ui32_buf = (uint32_t*)buf;
   uint16_t *ui16_buf = (uint16_t*)buf;
 
-  if ((f = fopen(PROCDIR FSDIRSEP "stat", "r")) != NULL)
+  if ((f = selfstat_fopen(PROCDIR FSDIRSEP "stat", "r")) != NULL)
   {
     while (fgets(buf,512,f) && s < (size_t)desired_number)
     {
@@ -174,105 +213,75 @@ int perfunix_cpu(perfunix_id_t *name __attribute__((unused)), perfunix_cpu_t* us
       {
         if ((p = strpbrk(buf+4," \t")) != NULL)
         {
-          userbuff[s].user = strtoull(++p, &p, 10);
-          userbuff[s].user += (p) ? strtoull(++p, &p, 10) : 0;
-          userbuff[s].sys  = (p) ? strtoull(++p, &p, 10) : 0;
-          userbuff[s].idle = (p) ? strtoull(++p, &p, 10) : 0;
-          userbuff[s++].wait = (p) ? strtoull(++p, &p, 10) : 0;
+          perfunix_cpu_ticks(p, t);
+          userbuff[s].cpu     = (int)strtol(buf+3, NULL, 10);
+          userbuff[s].user    = t[TICK_USER];
+          userbuff[s].nice    = t[TICK_NICE];
+          userbuff[s].sys     = t[TICK_SYSTEM];
+          userbuff[s].idle    = t[TICK_IDLE];
+          userbuff[s].wait    = t[TICK_IOWAIT];
+          userbuff[s].irq     = t[TICK_IRQ];
+          userbuff[s].softirq = t[TICK_SOFTIRQ];
+          userbuff[s].steal   = t[TICK_STEAL];
+          userbuff[s++].guest = t[TICK_GUEST];
         }
       }
     }
-    fclose(f);
+    selfstat_fclose(f);
   }
 	return s;
 }
 
+/* meminfo and vmstat stay open and are read whole, reopened on a new root */
+struct {
+  int fd[2];
+  unsigned int gen;
+  char *buf;
+  size_t size;
+} perfunix_memory_data = { { -1, -1 }, 0, NULL, 0 };
+
 int perfunix_memory_total(perfunix_id_t *name0 __attribute__((unused)), perfunix_memory_total_t* userbuff,
                          int sizeof_userbuff __attribute__((unused)), int desired_number __attribute__((unused)))
 {
-  FILE *f;
-  char buf[512];
+  static const char *paths[2] = { MEMKEYS_MEMINFO, MEMKEYS_VMSTAT };
+  uint64_t *keys = userbuff->keys;
+  int i;
 
-  if ((f = fopen(PROCDIR FSDIRSEP "meminfo", "r")) != NULL)
+  if (perfunix_memory_data.gen != selfstat_generation())
   {
-    while (fgets(buf,512,f))
+    for (i = 0; i < 2; i++)
     {
-      if (*buf == 'M')
-      {
-        if (buf[3] == 'T')
-          userbuff->real_total = strtoull(buf+10, NULL, 10);
-        if (buf[3] == 'F')
-          userbuff->real_free = strtoull(buf+9, NULL, 10);
-      }
-      if (*buf == 'S' && buf[1] == 'w')
-      {
-        switch (buf[4])
-        {
-        case 'F':
-          userbuff->pgsp_free = strtoull(buf+10, NULL, 10);
-          break;
-        case 'T':
-          userbuff->pgsp_total = strtoull(buf+11, NULL, 10);
-          break;
-        default:
-          ;
-        }
-      }
-      if (*buf == 'A' && buf[1] == 'c' && buf[6] == ':')
-        userbuff->virt_active = strtoull(buf+7, NULL, 10);
-      if (*buf == 'I' && buf[8] == ':')
-        userbuff->virt_total = strtoull(buf+9, NULL, 10);
-      if (*buf == 'H')
-      {
-        switch (buf[10])
-        {
-        case 'F':
-          userbuff->huge_free = strtoull(buf+16, NULL, 10);
-          break;
-        case 'T':
-          userbuff->huge_total = strtoull(buf+17, NULL, 10);
-          break;
-        case 'z':
-          userbuff->huge_size = strtoull(buf+14, NULL, 10);
-          break;
-        default:
-          ;
-        }
-      }
+      if (perfunix_memory_data.fd[i] >= 0)
+        close(perfunix_memory_data.fd[i]);
+      perfunix_memory_data.fd[i] = -1;
     }
-    fclose(f);
+    perfunix_memory_data.gen = selfstat_generation();
   }
-  if ((f = fopen(PROCDIR FSDIRSEP "vmstat", "r")) != NULL)
-  {
-    while (fgets(buf,512,f))
-    {
-      if (*buf == 'p')
-      {
-        if (buf[1] == 's')
-        {
-          if (buf[4] == 'i')
-            userbuff->pgins = strtoull(buf+7, NULL, 10);
-          else
-            userbuff->pgouts = strtoull(buf+8, NULL, 10);
-        }
-        else
-        {
-          if (buf[3] == 'g')
-          {
-            if (buf[4] == 'i')
-              userbuff->pgspins = strtoull(buf+7, NULL, 10);
-            if (buf[4] == 'o')
-              userbuff->pgspouts = strtoull(buf+8, NULL, 10);
-          }
-          else
-            if (buf[2] == 'f' && buf[3] == 'a')
-              userbuff->pgexct = strtoull(buf+8, NULL, 10);
 
-        }
-      }
-    }
-    fclose(f);
+  memset(keys, 0, sizeof(userbuff->keys));
+  for (i = 0; i < 2; i++)
+  {
+    if (perfunix_memory_data.fd[i] < 0)
+      perfunix_memory_data.fd[i] = selfstat_open(paths[i], O_RDONLY | O_CLOEXEC);
+    if (perfunix_memory_data.fd[i] >= 0
+        && selfstat_pread_all(perfunix_memory_data.fd[i], &perfunix_memory_data.buf, &perfunix_memory_data.size, 8192) > 0)
+      memkeys_parse(perfunix_memory_data.buf, keys);
   }
+
+  userbuff->real_total = keys[MEMKEY_MemTotal];
+  userbuff->real_free = keys[MEMKEY_MemFree];
+  userbuff->pgsp_total = keys[MEMKEY_SwapTotal];
+  userbuff->pgsp_free = keys[MEMKEY_SwapFree];
+  userbuff->virt_active = keys[MEMKEY_Active];
+  userbuff->virt_total = keys[MEMKEY_Inactive];
+  userbuff->huge_total = keys[MEMKEY_HugePages_Total];
+  userbuff->huge_free = keys[MEMKEY_HugePages_Free];
+  userbuff->huge_size = keys[MEMKEY_Hugepagesize];
+  userbuff->pgins = keys[MEMKEY_pswpin];
+  userbuff->pgouts = keys[MEMKEY_pswpout];
+  userbuff->pgspins = keys[MEMKEY_pgpgin];
+  userbuff->pgspouts = keys[MEMKEY_pgpgout];
+  userbuff->pgexct = keys[MEMKEY_pgfault];
   return 1;
 }
 
@@ -289,11 +298,11 @@ int perfunix_pagingspace(perfunix_id_t *name __attribute__((unused)),
   { // initialize number of lines
     if (nb_lines == -1)
     {
-      if ((f = fopen(PROCDIR FSDIRSEP "swaps", "r")) != NULL)
+      if ((f = selfstat_fopen(PROCDIR FSDIRSEP "swaps", "r")) != NULL)
       {
         while (fgets(buf,512,f))
           nb_lines++;
-        fclose(f);
+        selfstat_fclose(f);
       }
       else
         nb_lines = 0;
@@ -305,7 +314,7 @@ int perfunix_pagingspace(perfunix_id_t *name __attribute__((unused)),
     return -1;
 
   int ret = 0;
-  if ((f = fopen(PROCDIR FSDIRSEP "swaps", "r")) != NULL)
+  if ((f = selfstat_fopen(PROCDIR FSDIRSEP "swaps", "r")) != NULL)
   {
     nb_lines = 0;
     fgets(buf,512,f); // suppress first line
@@ -326,81 +335,115 @@ int perfunix_pagingspace(perfunix_id_t *name __attribute__((unused)),
         ret++;
       }
     }
-    fclose(f);
+    selfstat_fclose(f);
   }
   else
     return -1;
   return ret;
 }
 
+/* columns of a line of /proc/diskstats after the name, 11 before linux 4.18
+ * and 15 before 5.5, the missing ones are 0 */
+enum DISK_FIELD_e { DISK_RIOS, DISK_RMERGED, DISK_RSECT, DISK_RMS, DISK_WIOS, DISK_WMERGED, DISK_WSECT, DISK_WMS,
+                    DISK_INFLIGHT, DISK_IOMS, DISK_QMS, DISK_DIOS, DISK_DMERGED, DISK_DSECT, DISK_DMS,
+                    DISK_FIOS, DISK_FMS, DISK_FIELDS };
+
+static void perfunix_disk_fields(char *p, uint64_t d[DISK_FIELDS])
+{
+  int k;
+
+  for (k = 0; k < DISK_FIELDS; k++)
+  {
+    while (*p == ' ')
+      p++;
+    if (*p < '0' || *p > '9')
+      break;
+    for (d[k] = 0; *p >= '0' && *p <= '9'; p++)
+      d[k] = d[k] * 10 + (*p - '0');
+  }
+  for (; k < DISK_FIELDS; k++)
+    d[k] = 0;
+}
+
+/* the block devices listed once, see blockdev.h */
+struct {
+  blockdev_table_t table;
+  int ready;
+} perfunix_disk_data = { .ready = 0 };
+
+static blockdev_table_t *perfunix_disk_table(void)
+{
+  if (!perfunix_disk_data.ready)
+  {
+    blockdev_init(&perfunix_disk_data.table);
+    perfunix_disk_data.ready = 1;
+  }
+  return &perfunix_disk_data.table;
+}
+
+int perfunix_disk_select(const char *include, const char *exclude, int partitions)
+{
+  return blockdev_select(perfunix_disk_table(), include, exclude, partitions);
+}
+
+int perfunix_disk_uevent_fd(int polled)
+{
+  return blockdev_uevent_fd(perfunix_disk_table(), polled);
+}
+
+void perfunix_disk_uevents(void)
+{
+  blockdev_uevents(perfunix_disk_table());
+}
+
 int perfunix_disk(perfunix_id_t *name __attribute__((unused)),
                                perfunix_disk_t* userbuff,
                                int sizeof_userbuff,
                                int desired_number)
 {
-  static int nb_lines = -1;
-  FILE *f;
-  char buf[512];
-  uint32_t *ui32_buf = (uint32_t*)buf;
+  blockdev_table_t *t = perfunix_disk_table();
+  uint64_t d[DISK_FIELDS];
+  int i, ret = 0;
 
   if (userbuff == NULL && desired_number == 0)
-  { // initialize number of lines
-    if (nb_lines == -1)
-    {
-      nb_lines = 0;
-      if ((f = fopen(PROCDIR FSDIRSEP "diskstats", "r")) != NULL)
-      {
-        while (fgets(buf,512,f)) {
-          if ((*ui32_buf != *((uint32_t*)"   8") || buf[16] != ' ')  &&
-               *ui32_buf != *((uint32_t*)" 253"))
-            continue;
-
-          nb_lines++;
-
-        }
-        fclose(f);
-      }
-    }
-    return nb_lines;
+  { // number of disks of the last read
+    if (t->fd < 0 && blockdev_read(t) < 0)
+      return -1;
+    return t->nselected;
   }
 
   if (userbuff == NULL || sizeof_userbuff<(int)sizeof(perfunix_disk_t))
     return -1;
 
-  int ret = 0;
-  if ((f = fopen(PROCDIR FSDIRSEP "diskstats", "r")) != NULL)
+  if (blockdev_read(t) < 0)
+    return -1;
+  for (i = 0; i < t->nlines && ret < desired_number; i++)
   {
-    nb_lines = 0;
-    while (fgets(buf,512,f))
-    {
-      if ((*ui32_buf != *((uint32_t*)"   8") || buf[16] != ' ')  &&
-           *ui32_buf != *((uint32_t*)" 253"))
-        continue;
-
-      nb_lines++;
-      char *p = strpbrk(buf+13, " \t");
-      if (p && ret < desired_number)
-      {
-        *p++ = '\0';
-        strcpy(userbuff[ret].name, buf+13);
-        userbuff[ret].rfers = (p) ? strtoull(p, &p, 10) : 0; // read IO
-        userbuff[ret].q_sampled = (p) ? strtoull(++p, &p, 10) : 0; // read merged
-        userbuff[ret].rblks = (p) ? strtoull(++p, &p, 10) : 0; // read sectors
-        userbuff[ret].rserv = (p) ? strtoull(++p, &p, 10) * 1000: 0; // read tim
-        userbuff[ret].wfers = (p) ? strtoull(++p, &p, 10) : 0; // write IO
-        userbuff[ret].wq_sampled = (p) ? strtoull(++p, &p, 10) : 0; // write merged
-        userbuff[ret].wblks = (p) ? strtoull(++p, &p, 10) : 0; // write sectors
-        userbuff[ret].wserv =(p) ? strtoull(++p, &p, 10) * 1000 : 0; // write time
-        userbuff[ret].wq_depth = (p) ? strtoull(++p, &p, 10) : 0;// in_flight
-        userbuff[ret].time = (p) ? strtoull(++p, &p, 10) : 0; // time active
-        userbuff[ret].wq_time = (p) ? strtoull(++p, &p, 10) : 0; // wait time
-        ret++;
-      }
-    }
-    fclose(f);
+    blockdev_line_t *line = t->lines + i;
+
+    if (line->dev < 0)
+      continue;
+    snprintf(userbuff[ret].name, sizeof(userbuff[ret].name), "%s", t->devs[line->dev].label);
+    perfunix_disk_fields(line->fields, d);
+    userbuff[ret].rfers = d[DISK_RIOS];
+    userbuff[ret].rmerged = d[DISK_RMERGED];
+    userbuff[ret].rblks = d[DISK_RSECT];
+    userbuff[ret].rserv = d[DISK_RMS] * 1000;
+    userbuff[ret].wfers = d[DISK_WIOS];
+    userbuff[ret].wmerged = d[DISK_WMERGED];
+    userbuff[ret].wblks = d[DISK_WSECT];
+    userbuff[ret].wserv = d[DISK_WMS] * 1000;
+    userbuff[ret].wq_depth = d[DISK_INFLIGHT];
+    userbuff[ret].time = d[DISK_IOMS];
+    userbuff[ret].wq_time = d[DISK_QMS];
+    userbuff[ret].dfers = d[DISK_DIOS];
+    userbuff[ret].dmerged = d[DISK_DMERGED];
+    userbuff[ret].dblks = d[DISK_DSECT];
+    userbuff[ret].dserv = d[DISK_DMS] * 1000;
+    userbuff[ret].ffers = d[DISK_FIOS];
+    userbuff[ret].fserv = d[DISK_FMS] * 1000;
+    ret++;
   }
-  else
-    return -1;
   return ret;
 }
 
@@ -429,7 +472,7 @@ int perfunix_protocol( perfunix_id_t *name,
     length = sizeof(userbuff->u.nfsv4.client)/sizeof(userbuff->u.nfsv4.client.null)-1;
   }
 
-  if ((f = fopen(PROCDIR FSDIRSEP "net" FSDIRSEP "rpc" FSDIRSEP "nfs", "r")) != NULL)
+  if ((f = selfstat_fopen(PROCDIR FSDIRSEP "net" FSDIRSEP "rpc" FSDIRSEP "nfs", "r")) != NULL)
   {
     uint32_t s;
     while (fgets(buf,512,f))
@@ -444,7 +487,7 @@ int perfunix_protocol( perfunix_id_t *name,
       }
       break; // line found
     }
-    fclose(f);
+    selfstat_fclose(f);
   }
   else
     return -1;
@@ -466,7 +509,7 @@ int perfunix_netinterface(perfunix_id_t *name __attribute__((unused)),
     if (nb_lines == -1)
     {
       nb_lines = 0;
-      if ((f = fopen(PROCDIR FSDIRSEP "net" FSDIRSEP "dev", "r")) != NULL)
+      if ((f = selfstat_fopen(PROCDIR FSDIRSEP "net" FSDIRSEP "dev", "r")) != NULL)
       {
         fgets(buf,512,f);
         fgets(buf,512,f);
@@ -475,7 +518,7 @@ int perfunix_netinterface(perfunix_id_t *name __attribute__((unused)),
             continue;
           nb_lines++;
         }
-        fclose(f);
+        selfstat_fclose(f);
       }
     }
     return nb_lines;
@@ -485,7 +528,7 @@ int perfunix_netinterface(perfunix_id_t *name __attribute__((unused)),
     return -1;
 
   int ret = 0;
-  if ((f = fopen(PROCDIR FSDIRSEP "net" FSDIRSEP "dev", "r")) != NULL)
+  if ((f = selfstat_fopen(PROCDIR FSDIRSEP "net" FSDIRSEP "dev", "r")) != NULL)
   {
     fgets(buf,512,f);
     fgets(buf,512,f);
@@ -500,7 +543,7 @@ int perfunix_netinterface(perfunix_id_t *name __attribute__((unused)),
       {
         *p++ = '\0';
         strcpy(userbuff[ret].name, n);
-        userbuff[ret].ibytes    = (p) ? strtoull(++p, &p, 10) : 0; // 1
+        userbuff[ret].ibytes    = (p) ? strtoull(p, &p, 10) : 0; // 1, only one space before a large value
         userbuff[ret].ipackets  = (p) ? strtoull(++p, &p, 10) : 0; // 2
         userbuff[ret].ierrors   = (p) ? strtoull(++p, &p, 10) : 0; // 3
         userbuff[ret].if_iqdrops= (p) ? strtoull(++p, &p, 10) : 0; // 4
@@ -523,7 +566,7 @@ int perfunix_netinterface(perfunix_id_t *name __attribute__((unused)),
         userbuff[ret++].collisions = (p) ? strtoull(p, NULL, 10) : 0;
       }
     }
-    fclose(f);
+    selfstat_fclose(f);
   }
 
   return ret;
@@ -536,7 +579,7 @@ int perfunix_fcstat(perfunix_id_t *name __attribute__((unused)),
 {
   if (fc_host.nb < 0) {
     struct dirent *dent;
-    DIR *dir=opendir( FC_HOSTDIR );
+    DIR *dir=selfstat_opendir( FC_HOSTDIR );
     if (!dir) return -1;
 
     fc_host.nb = 0;
@@ -611,11 +654,11 @@ int perfunix_fcstat(perfunix_id_t *name __attribute__((unused)),
 
 #define SETFCVALUE(x)                                     \
       userbuff[i].x = 0;                                  \
-      if ((f=fopen(fc_host.sys_fc_host[i].x, "r"))!=NULL) \
+      if ((f=selfstat_fopen(fc_host.sys_fc_host[i].x, "r"))!=NULL) \
       {                                                   \
         if (fgets(line, 150, f))                          \
           userbuff[i].x = strtoull(line+2, NULL, 16);     \
-        fclose(f);                                        \
+        selfstat_fclose(f);                               \
       }
 
       SETFCVALUE(TxWords)
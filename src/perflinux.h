@@ -37,6 +37,8 @@
 #include <sys/types.h>
 #include <inttypes.h>
 
+#include "memkeys.h"
+
 #define LV_PAGING 1
 
 #define ID_LENGTH 64
@@ -55,10 +57,16 @@ typedef struct { /* perfstat_id_t : structure element identifier */
 } perfunix_id_t;
 
 typedef struct { /* perfunix_cpu_t : cpu information */
-    uint64_t user;     /* ticks spent in user mode */
+    int cpu;           /* number of the cpu (cpuN) */
+    uint64_t user;     /* ticks spent in user mode, without nice and guest */
     uint64_t sys;      /* ticks spent in system mode */
     uint64_t idle;     /* ticks spent idle */
     uint64_t wait;     /* ticks spent waiting for I/O */
+    uint64_t nice;     /* ticks spent in user mode with a positive nice, without guest */
+    uint64_t irq;      /* ticks spent in hard interrupts */
+    uint64_t softirq;  /* ticks spent in soft interrupts */
+    uint64_t steal;    /* ticks stolen by the hypervisor */
+    uint64_t guest;    /* ticks spent running guests, nice or not */
 } perfunix_cpu_t;
 
 typedef struct { /* perfunix_cpu_total_t : global cpu information */
@@ -66,11 +74,17 @@ typedef struct { /* perfunix_cpu_total_t : global cpu information */
     uint64_t processorHZ; /* processor speed in Hz */
     uint64_t pswitch;     /* number of process switches (change in currently running process) */
     double loadavg_dbl[3];/* load average : differ from AIX */
-    uint64_t runque;      /* length of the run queue (processes ready) */
-    uint64_t puser;       /* processor tics in user mode */
+    uint64_t runque;      /* tasks running or ready to run (procs_running) */
+    uint64_t blocked;     /* tasks blocked on an I/O (procs_blocked) */
+    uint64_t puser;       /* processor tics in user mode, without nice and guest */
     uint64_t psys;        /* processor tics in system mode */
     uint64_t pidle;       /* processor tics idle */
     uint64_t pwait;       /* processor tics waiting for I/O */
+    uint64_t pnice;       /* processor tics in user mode with a positive nice, without guest */
+    uint64_t pirq;        /* processor tics in hard interrupts */
+    uint64_t psoftirq;    /* processor tics in soft interrupts */
+    uint64_t psteal;      /* processor tics stolen by the hypervisor */
+    uint64_t pguest;      /* processor tics running guests, nice or not */
 } perfunix_cpu_total_t;
 
 typedef struct { /* perfunix_memory_total_t : Virtual memory utilization */
@@ -88,6 +102,7 @@ typedef struct { /* perfunix_memory_total_t : Virtual memory utilization */
     uint64_t pgsp_total;    /* total paging space (in KB pages) */
     uint64_t pgsp_free;     /* free paging space (in KB pages) */
     uint64_t virt_active;   /* Active virtual pages. Virtual pages are considered active if they have been accessed */
+    uint64_t keys[MEMKEY_MAX];  /* every key of meminfo and vmstat, see memkeys.h */
 } perfunix_memory_total_t;
 
 typedef struct { /* perfunix_pagingspace_t : Paging space data for a specific logical volume */
@@ -109,12 +124,17 @@ typedef struct { /* perfunix_disk_t : disk information */
     uint64_t wfers;             /* number of transfers to disk */
     uint64_t wblks;             /* number of blocks written to disk */
     uint64_t wserv;             /* write or send service time */
-    uint64_t wq_time;           /* accumulated wait queueing time */
-    uint64_t wq_sampled;        /* accumulated sampled dk_wq_depth */
-    uint64_t q_sampled;         /* accumulated sampled dk_q_depth */
-
-    uint64_t wq_depth;          /* instantaneous wait queue depth
-                                     * (number of requests waiting to be sent to disk) */
+    uint64_t wq_time;           /* time in queue of all the requests (weighted ms) */
+    uint64_t rmerged;           /* number of reads merged */
+    uint64_t wmerged;           /* number of writes merged */
+    uint64_t dfers;             /* number of discards */
+    uint64_t dmerged;           /* number of discards merged */
+    uint64_t dblks;             /* number of blocks discarded */
+    uint64_t dserv;             /* discard service time */
+    uint64_t ffers;             /* number of flushes */
+    uint64_t fserv;             /* flush service time */
+
+    uint64_t wq_depth;          /* instantaneous number of requests in flight */
 } perfunix_disk_t;
 
 typedef struct { /* perfunix_netinterface_t : Description of the network interface */
@@ -193,6 +213,11 @@ extern int perfunix_pagingspace(perfunix_id_t *name,
                                 int sizeof_userbuff,               
                                 int desired_number);               
 
+/* -d, -D and -e, see blockdev.h */
+extern int perfunix_disk_select(const char *include, const char *exclude, int partitions);
+/* the uevents of the block devices read by an event loop, see blockdev.h */
+extern int perfunix_disk_uevent_fd(int polled);
+extern void perfunix_disk_uevents(void);
 extern int perfunix_disk(perfunix_id_t *name,
                                perfunix_disk_t* userbuff,
                                int sizeof_userbuff,
@@ -0,0 +1,96 @@
+/* pressure.c
+ *
+ * Pressure stall information of Linux (/proc/pressure/{cpu,memory,io}).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "pressure.h"
+#include "selfstat.h"
+
+const char *pressure_names[PRESSURE_MAX] = { "cpu", "memory", "io" };
+
+int pressure_open(pressure_t *p, const char *name, const char *trigger)
+{
+  char path[64];
+
+  p->name = name;
+  p->trigger = NULL;
+  snprintf(path, sizeof(path), PRESSURE_DIR "%s", name);
+
+  if ((p->fd = selfstat_open(path, (trigger) ? O_RDWR | O_NONBLOCK | O_CLOEXEC : O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+
+  /* the trailing nul is part of the trigger for the kernel */
+  if (trigger && write(p->fd, trigger, strlen(trigger) + 1) < 0)
+  {
+    pressure_close(p);
+    return -1;
+  }
+  if (trigger)
+    p->trigger = strdup(trigger);
+  return 0;
+}
+
+static void pressure_line(const char *buf, pressure_line_t *line)
+{
+  char *p;
+
+  line->avg10  = ((p = strstr(buf, "avg10="))) ? strtod(p + 6, NULL) : 0;
+  line->avg60  = ((p = strstr(buf, "avg60="))) ? strtod(p + 6, NULL) : 0;
+  line->avg300 = ((p = strstr(buf, "avg300="))) ? strtod(p + 7, NULL) : 0;
+  line->total  = ((p = strstr(buf, "total="))) ? strtoull(p + 6, NULL, 10) : 0;
+}
+
+int pressure_read(pressure_t *p, pressure_stat_t *st)
+{
+  char buf[256], *full;
+  ssize_t n;
+
+  memset(st, 0, sizeof(*st));
+  if (p->fd < 0 || (n = selfstat_pread(p->fd, buf, sizeof(buf) - 1, 0)) <= 0)
+    return -1;
+  buf[n] = '\0';
+
+  /* "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\nfull ..." */
+  if ((full = strstr(buf, "full ")))
+  {
+    full[-1] = '\0';
+    pressure_line(full, &st->full);
+    st->has_full = 1;
+  }
+  pressure_line(buf, &st->some);
+  return 0;
+}
+
+void pressure_close(pressure_t *p)
+{
+  if (p->fd >= 0)
+    close(p->fd);
+  p->fd = -1;
+  free(p->trigger);
+  p->trigger = NULL;
+}
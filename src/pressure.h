@@ -0,0 +1,70 @@
+/* pressure.h
+ *
+ * Pressure stall information of Linux (/proc/pressure/{cpu,memory,io}).
+ *
+ * The file of a resource stays open: it is read with pread for the pressure
+ * group and it can hold a kernel side trigger ("some 150000 1000000" means
+ * 150ms of stall within 1s), the fd is then signaled with POLLPRI each time
+ * the threshold is crossed.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _PRESSURE_H
+#define _PRESSURE_H
+
+#include <inttypes.h>
+
+#define PRESSURE_DIR "/proc/pressure/"
+
+enum PRESSURE_e {
+  PRESSURE_CPU = 0,
+  PRESSURE_MEMORY = 1,
+  PRESSURE_IO = 2,
+  PRESSURE_MAX = 3
+};
+
+typedef struct {
+  double avg10;
+  double avg60;
+  double avg300;
+  uint64_t total;       /* cumulated stall time in us */
+} pressure_line_t;
+
+typedef struct {
+  pressure_line_t some;
+  pressure_line_t full;
+  int has_full;
+} pressure_stat_t;
+
+typedef struct {
+  const char *name;
+  int fd;
+  char *trigger;        /* NULL without trigger */
+} pressure_t;
+
+extern const char *pressure_names[PRESSURE_MAX];
+
+/* the trigger needs the fd to be opened read/write */
+int  pressure_open(pressure_t *p, const char *name, const char *trigger);
+int  pressure_read(pressure_t *p, pressure_stat_t *st);
+void pressure_close(pressure_t *p);
+
+#endif /* _PRESSURE_H */
@@ -31,6 +31,9 @@
  * A copy of the GPL can be found in the file "COPYING" in this distribution.
  */
 
+/* getdents64 */
+#define _GNU_SOURCE
+
 #define PROCDIR "/proc"
 #define FSDIRSEP "/"
 #include <features.h>
@@ -47,28 +50,66 @@
 #include <inttypes.h>
 
 #include "proclinux.h"
+#include "selfstat.h"
+
+int getprocs_names = 1;
+
+/* The directory of the processes stays open and is read with getdents64 in
+ * a static buffer: opendir would allocate a DIR at each call. It is only
+ * reopened when the root changes. */
+static int proc_fd = -1;
+static unsigned int proc_gen;
+static char proc_dents[32768];
+static ssize_t proc_len, proc_pos;
+
+static int proc_rewind(void)
+{
+	if (proc_fd < 0 || proc_gen != selfstat_generation()) {
+		if (proc_fd >= 0)
+			close(proc_fd);
+		proc_gen = selfstat_generation();
+		if ((proc_fd = selfstat_open(PROCDIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+			return -1;
+	}
+	else if (lseek(proc_fd, 0, SEEK_SET) < 0)
+		return -1;
+	proc_len = proc_pos = 0;
+	return 0;
+}
+
+static struct dirent64 *proc_next(void)
+{
+	struct dirent64 *dent;
+
+	if (proc_pos >= proc_len) {
+		if ((proc_len = getdents64(proc_fd, proc_dents, sizeof(proc_dents))) <= 0)
+			return NULL;
+		proc_pos = 0;
+	}
+	dent = (struct dirent64 *)(proc_dents + proc_pos);
+	proc_pos += dent->d_reclen;
+	return dent;
+}
 
 int getprocs64 (void *procsinfo, int sizproc __attribute__((unused)), void *fdsinfo __attribute__((unused)),
                 int sizfd __attribute__((unused)), pid_t *idx __attribute__((unused)), int count)
 {
-	DIR *proc = opendir(PROCDIR);
 	char path[100], *subpath, *filepath;
-	struct dirent *dent;
+	struct dirent64 *dent;
 	int nb = 0;
 	procentry64_t *data = (procentry64_t*) procsinfo;
 	static long int jiffies = 0;
 
 	if (!jiffies) jiffies = sysconf(_SC_CLK_TCK);
 
-	if (!proc) return -1;
+	if (proc_rewind()) return -1;
 
 	if (!procsinfo) {
-	while ((dent = readdir(proc)) != NULL) {
+	while ((dent = proc_next()) != NULL) {
 	if(*dent->d_name < '1' || *dent->d_name > '9')
 	continue;
 	nb++;
 	}
-	closedir(proc);
 	return nb;
 	}
 
@@ -76,7 +117,7 @@ int getprocs64 (void *procsinfo, int sizproc __attribute__((unused)), void *fdsi
 
 	subpath = path + sizeof(PROCDIR);
 
-	while ((dent = readdir(proc)) != NULL && nb < count) {
+	while ((dent = proc_next()) != NULL && nb < count) {
 		if(*dent->d_name < '1' || *dent->d_name > '9')
 			continue;
 		unsigned long utime = 0, stime = 0, vsize = 0, lflag;
@@ -84,12 +125,15 @@ int getprocs64 (void *procsinfo, int sizproc __attribute__((unused)), void *fdsi
 		strcpy(subpath, dent->d_name);
 		filepath = subpath + strlen(dent->d_name);
 		strcpy(filepath, FSDIRSEP "stat");
-		int hf = open(path, O_RDONLY, 0666);
+		int hf = selfstat_open(path, O_RDONLY);
 		if (hf > -1) {
 			char line[512];
-			ssize_t s = read(hf, line, sizeof(line)); /* Flawfinder: ignore */
-			if (s < 1 || s == sizeof(line))
-			return -1;
+			ssize_t s = selfstat_read(hf, line, sizeof(line)); /* Flawfinder: ignore */
+			if (s < 1 || s == sizeof(line)) {
+				close(hf);
+				return -1;
+			}
+			line[s] = '\0';
 
 			sscanf(line,"%" SCNu32 " %*s %c %*d %*d "
 			    "%*d %*d %*d %lu %*u "
@@ -104,21 +148,30 @@ int getprocs64 (void *procsinfo, int sizproc __attribute__((unused)), void *fdsi
 			close(hf);
 			if (!(lflag & 0x80000000)) {
 				ssize_t lenname = 0;
-				strcpy(filepath, FSDIRSEP "status");
-				hf = open(path, O_RDONLY, 0666);
-				if (hf > -1) {
-					s = lseek(hf, 6, SEEK_SET);
-					if (s == 6) {
-						s = read(hf, data[nb].pi_comm, MAX_PATH);  /* Flawfinder: ignore */
-						for (;lenname < s && data[nb].pi_comm[lenname] != '\n'; 
-								lenname++)
-							;
-						data[nb].pi_comm[lenname] = '\0';
+				char *lp = strchr(line, '('), *rp = strrchr(line, ')');
+				if (!getprocs_names && lp && rp > lp) {
+					/* the comm is between the parenthesis of stat */
+					lenname = (rp - lp - 1 < MAX_PATH) ? rp - lp - 1 : MAX_PATH;
+					memcpy(data[nb].pi_comm, lp + 1, lenname);
+					data[nb].pi_comm[lenname] = '\0';
+				}
+				else {
+					strcpy(filepath, FSDIRSEP "status");
+					hf = selfstat_open(path, O_RDONLY);
+					if (hf > -1) {
+						s = lseek(hf, 6, SEEK_SET);
+						if (s == 6) {
+							s = selfstat_read(hf, data[nb].pi_comm, MAX_PATH);  /* Flawfinder: ignore */
+							for (;lenname < s && data[nb].pi_comm[lenname] != '\n'; 
+									lenname++)
+								;
+							data[nb].pi_comm[lenname] = '\0';
+						}
+					close(hf);
 					}
-				close(hf);
+					else
+						*data[nb].pi_comm = '\0';
 				}
-				else
-					*data[nb].pi_comm = '\0';
 
 				data[nb].pi_size = vsize >> 10;
 				data[nb].pi_ru.ru_stime = stime * 1000 / jiffies;
@@ -127,6 +180,5 @@ int getprocs64 (void *procsinfo, int sizproc __attribute__((unused)), void *fdsi
 			}
 		}
 	}
-	closedir(proc);
 	return nb;
 }
@@ -59,6 +59,10 @@ struct procentry64
 	}pi_ru;		/* this process' rusage info */
 };
 
+/* 0 takes the name of the processes from the comm of stat (15 chars) instead
+ * of the first line of status, which saves an open per process */
+extern int getprocs_names;
+
 int	getprocs64(void *procsinfo, int sizproc, void *fdsinfo, int sizfd,
    	           pid_t *index, int count);
 
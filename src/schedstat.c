@@ -0,0 +1,135 @@
+/* schedstat.c
+ *
+ * Run queue latency of the cpus of Linux (/proc/schedstat).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "schedstat.h"
+#include "selfstat.h"
+
+#define SCHEDSTAT_BUF_MIN 16384
+#define SCHEDSTAT_CPU_FIELDS 9  /* yld_count, 0, sched_count, sched_goidle, ttwu_count,
+                                   ttwu_local, rq_cpu_time, run_delay, pcount */
+
+void schedstat_init(schedstat_t *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->fd = -1;
+}
+
+int schedstat_open(schedstat_t *s)
+{
+  s->gen = selfstat_generation();
+  if ((s->fd = selfstat_open(SCHEDSTAT_FILE, O_RDONLY | O_CLOEXEC)) < 0)
+    return -1;
+  if (selfstat_pread_all(s->fd, &s->buf, &s->size, SCHEDSTAT_BUF_MIN) <= 0 ||
+      strncmp(s->buf, "version ", 8) || atoi(s->buf + 8) < SCHEDSTAT_VERSION)
+  {
+    close(s->fd);
+    s->fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+int schedstat_read(schedstat_t *s)
+{
+  int next = 1 - s->odd, n = 0, k;
+  uint64_t f[SCHEDSTAT_CPU_FIELDS];
+  char *p;
+
+  if (s->gen != selfstat_generation())
+  {
+    if (s->fd >= 0)
+      close(s->fd);
+    if (schedstat_open(s) < 0)
+      return -1;
+  }
+  if (s->fd < 0 || selfstat_pread_all(s->fd, &s->buf, &s->size, SCHEDSTAT_BUF_MIN) <= 0)
+    return -1;
+
+  /* "cpu<n> <9 fields>", the domain lines are skipped */
+  for (p = s->buf; *p; p += (*p == '\n'))
+  {
+    schedstat_cpu_t *c;
+    int cpu;
+
+    if (strncmp(p, "cpu", 3))
+    {
+      while (*p && *p != '\n')
+        p++;
+      continue;
+    }
+    for (p += 3, cpu = 0; *p >= '0' && *p <= '9'; p++)
+      cpu = cpu * 10 + (*p - '0');
+    for (k = 0; k < SCHEDSTAT_CPU_FIELDS; k++)
+    {
+      while (*p == ' ')
+        p++;
+      for (f[k] = 0; *p >= '0' && *p <= '9'; p++)
+        f[k] = f[k] * 10 + (*p - '0');
+    }
+    while (*p && *p != '\n')
+      p++;
+
+    if (n == s->max)
+    {
+      int max = (s->max) ? s->max * 2 : 64;
+      void *a, *b;
+
+      if ((a = realloc(s->cpus[0], max * sizeof(schedstat_cpu_t))) == NULL)
+        return -1;
+      s->cpus[0] = a;
+      if ((b = realloc(s->cpus[1], max * sizeof(schedstat_cpu_t))) == NULL)
+        return -1;
+      s->cpus[1] = b;
+      s->max = max;
+    }
+    c = s->cpus[next] + n;
+    c->cpu = cpu;
+    c->run_ns = f[6];
+    c->delay_ns = f[7];
+    c->slices = f[8];
+    /* the cpus are in the order of their numbers, a hotplug shifts them */
+    if (n >= s->nb || s->cpus[s->odd][n].cpu != cpu)
+      s->cpus[s->odd][n] = *c;
+    n++;
+  }
+  s->nb = n;
+  s->odd = next;
+  return 0;
+}
+
+void schedstat_close(schedstat_t *s)
+{
+  if (s->fd >= 0)
+    close(s->fd);
+  free(s->buf);
+  free(s->cpus[0]);
+  free(s->cpus[1]);
+  schedstat_init(s);
+}
@@ -0,0 +1,63 @@
+/* schedstat.h
+ *
+ * Run queue latency of the cpus of Linux (/proc/schedstat, version 15 and
+ * later, the kernel needs CONFIG_SCHEDSTATS and kernel.sched_schedstats=1).
+ *
+ * The cpu lines give the time the tasks ran on the cpu, the time they waited
+ * on its run queue and the timeslices run, in ns since the boot. The file
+ * stays open and is read whole with pread.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _SCHEDSTAT_H
+#define _SCHEDSTAT_H
+
+#include <inttypes.h>
+
+#define SCHEDSTAT_FILE "/proc/schedstat"
+#define SCHEDSTAT_VERSION 15
+
+typedef struct {
+  int cpu;
+  uint64_t run_ns;      /* tasks running on the cpu */
+  uint64_t delay_ns;    /* tasks waiting on the run queue of the cpu */
+  uint64_t slices;      /* timeslices run */
+} schedstat_cpu_t;
+
+typedef struct {
+  int fd;
+  unsigned int gen;
+  char *buf;            /* whole file, grown and never shrunk */
+  size_t size;
+  int nb;
+  int max;
+  schedstat_cpu_t *cpus[2];     /* current and previous */
+  int odd;              /* index of the current cpus */
+} schedstat_t;
+
+void schedstat_init(schedstat_t *s);
+/* fails on an unknown version */
+int  schedstat_open(schedstat_t *s);
+/* a new cpu or a change of the cpus has a delta of 0 */
+int  schedstat_read(schedstat_t *s);
+void schedstat_close(schedstat_t *s);
+
+#endif /* _SCHEDSTAT_H */
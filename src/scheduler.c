@@ -0,0 +1,116 @@
+/* scheduler.c
+ *
+ * Tick computation of the main loop.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "scheduler.h"
+
+static inline uint64_t scheduler_ns(clockid_t id)
+{
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * SCHEDULER_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t scheduler_clock(void)
+{
+  return scheduler_ns(CLOCK_MONOTONIC);
+}
+
+uint64_t scheduler_realtime(void)
+{
+  return scheduler_ns(CLOCK_REALTIME);
+}
+
+void scheduler_open(scheduler_t *s, uint64_t tick_ns)
+{
+  memset(s, 0, sizeof(*s));
+  s->tick_ns = (tick_ns) ? tick_ns : SCHEDULER_NS_PER_SEC;
+}
+
+void scheduler_set_tick(scheduler_t *s, uint64_t tick_ns)
+{
+  if (tick_ns && tick_ns != s->tick_ns)
+  {
+    s->tick_ns = tick_ns;
+    s->next_ns = 0;
+  }
+}
+
+/* whole ticks passed since the next one, ie after a suspend */
+static inline void scheduler_skip(scheduler_t *s, uint64_t real)
+{
+  if (real - s->next_ns >= s->tick_ns)
+  {
+    uint64_t n = (real - s->next_ns) / s->tick_ns;
+    s->skipped += n;
+    s->next_ns += n * s->tick_ns;
+  }
+}
+
+uint64_t scheduler_next(scheduler_t *s)
+{
+  uint64_t real = scheduler_realtime();
+  uint64_t mono = scheduler_clock();
+
+  /* first tick or realtime stepped backward */
+  if (!s->next_ns || real + s->tick_ns < s->next_ns)
+    s->next_ns = (real / s->tick_ns + 1) * s->tick_ns;
+
+  s->late = (real >= s->next_ns);
+  if (s->late)
+  {
+    scheduler_skip(s, real);
+    return mono;
+  }
+  return mono + (s->next_ns - real);
+}
+
+int scheduler_tick(scheduler_t *s)
+{
+  uint64_t real = scheduler_realtime();
+
+  if (s->late)
+    s->overruns++;
+  else if (real < s->next_ns)
+    return 0;
+  else
+    scheduler_skip(s, real);
+
+  s->ticks++;
+  s->wake_ns = scheduler_clock();
+  s->now_ns = s->next_ns;
+  s->next_ns += s->tick_ns;
+  return 1;
+}
+
+void scheduler_done(scheduler_t *s)
+{
+  s->collect_ns = scheduler_clock() - s->wake_ns;
+  s->collect_total_ns += s->collect_ns;
+  if (s->collect_ns > s->collect_max_ns)
+    s->collect_max_ns = s->collect_ns;
+  s->collected++;
+}
@@ -0,0 +1,77 @@
+/* scheduler.h
+ *
+ * Tick computation of the main loop.
+ *
+ * The ticks are aligned on the realtime boundaries (every second .000) but
+ * the deadline given to the event loop is on CLOCK_MONOTONIC, so neither a
+ * NTP step nor a long collect makes the loop drift: the offset between the
+ * two clocks is read again each time the next deadline is computed. A tick
+ * served after its deadline counts as an overrun, the boundaries passed
+ * without being served count as skipped. The time spent between the tick
+ * and scheduler_done() is the cost of the collect of the tick.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <inttypes.h>
+
+#define SCHEDULER_NS_PER_SEC 1000000000ULL
+
+typedef struct {
+  uint64_t tick_ns;
+  uint64_t next_ns;     /* realtime of the next tick */
+  uint64_t now_ns;      /* realtime of the served tick */
+  uint64_t wake_ns;     /* monotonic time of the wake up */
+  int late;             /* the next tick was already passed when armed */
+  uint64_t ticks;
+  uint64_t overruns;
+  uint64_t skipped;
+  uint64_t collected;
+  uint64_t collect_ns;  /* cost of the last tick */
+  uint64_t collect_max_ns;
+  uint64_t collect_total_ns;
+} scheduler_t;
+
+void scheduler_open(scheduler_t *s, uint64_t tick_ns);
+
+/* changes the tick keeping the counters, the next one is aligned again */
+void scheduler_set_tick(scheduler_t *s, uint64_t tick_ns);
+
+/* monotonic deadline of the next tick */
+uint64_t scheduler_next(scheduler_t *s);
+
+/* called at the deadline, returns 0 if it is too early for the realtime
+ * (slewed or stepped backward) and the deadline has to be computed again
+ */
+int  scheduler_tick(scheduler_t *s);
+
+/* ends the collect of the current tick */
+void scheduler_done(scheduler_t *s);
+
+/* monotonic time in ns, used to measure the real interval between collects */
+uint64_t scheduler_clock(void);
+
+/* realtime in ns */
+uint64_t scheduler_realtime(void);
+
+#endif /* _SCHEDULER_H */
@@ -0,0 +1,327 @@
+/* selfstat.c
+ *
+ * Self instrumentation of jsonperfmon: cost of each collector.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+/* fopencookie */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "selfstat.h"
+#include "scheduler.h"
+
+selfstat_io_t selfstat_io;
+uint64_t selfstat_allocs;
+
+static char selfstat_rootdir[PATH_MAX];
+static unsigned int selfstat_rootgen;
+
+void selfstat_root(const char *root)
+{
+  size_t l = strlen(root);
+
+  /* without the trailing separator, the paths start by one */
+  while (l && root[l - 1] == '/')
+    l--;
+  if (l >= sizeof(selfstat_rootdir))
+    l = sizeof(selfstat_rootdir) - 1;
+  memcpy(selfstat_rootdir, root, l);
+  selfstat_rootdir[l] = '\0';
+  selfstat_rootgen++;
+}
+
+unsigned int selfstat_generation(void)
+{
+  return selfstat_rootgen;
+}
+
+const char *selfstat_path(const char *path, char *buf, size_t len)
+{
+  if (!*selfstat_rootdir)
+    return path;
+  snprintf(buf, len, "%s%s", selfstat_rootdir, path);
+  return buf;
+}
+
+#ifdef linux
+/* A file read at each tick keeps its stream, its fd and its buffer: the
+ * next open only rewinds it and the kernel regenerates the content of a
+ * /proc or /sys file read again from the offset 0. So once all the files
+ * have been opened a tick allocates nothing for its reads. */
+typedef struct {
+  FILE *f;
+  int fd;
+  off_t off;
+  unsigned int gen;   /* root of the fd */
+  int used;
+  char path[128];
+  char buf[BUFSIZ];
+} selfstat_file_t;
+
+static selfstat_file_t selfstat_files[SELFSTAT_FILES];
+
+static ssize_t selfstat_cookie_read(void *cookie, char *buf, size_t n)
+{
+  selfstat_file_t *sf = (selfstat_file_t *)cookie;
+  ssize_t r = selfstat_pread(sf->fd, buf, n, sf->off);
+
+  if (r > 0)
+    sf->off += r;
+  return r;
+}
+
+static int selfstat_cookie_seek(void *cookie, off64_t *off, int whence)
+{
+  selfstat_file_t *sf = (selfstat_file_t *)cookie;
+
+  if (whence == SEEK_SET)
+    sf->off = *off;
+  else if (whence == SEEK_CUR)
+    sf->off += *off;
+  else
+    return -1;
+  *off = sf->off;
+  return 0;
+}
+
+static int selfstat_cookie_close(void *cookie)
+{
+  selfstat_file_t *sf = (selfstat_file_t *)cookie;
+  int r = (sf->fd >= 0) ? close(sf->fd) : 0;
+
+  sf->fd = -1;
+  sf->f = NULL;
+  return r;
+}
+
+static const cookie_io_functions_t selfstat_cookie = {
+  selfstat_cookie_read, NULL, selfstat_cookie_seek, selfstat_cookie_close
+};
+
+/* the files beyond the table are opened and closed each time */
+static ssize_t selfstat_fd_read(void *cookie, char *buf, size_t n)
+{
+  return selfstat_read((int)(intptr_t)cookie, buf, n);
+}
+
+static int selfstat_fd_close(void *cookie)
+{
+  return close((int)(intptr_t)cookie);
+}
+
+static const cookie_io_functions_t selfstat_fd_cookie = {
+  selfstat_fd_read, NULL, NULL, selfstat_fd_close
+};
+#endif
+
+/* the files are only read */
+FILE *selfstat_fopen(const char *path, const char *mode)
+{
+#ifdef linux
+  selfstat_file_t *sf = NULL;
+  FILE *f;
+  int i, fd;
+
+  for (i = 0; i < SELFSTAT_FILES; i++)
+    if (selfstat_files[i].f && !strcmp(selfstat_files[i].path, path))
+    {
+      sf = selfstat_files + i;
+      break;
+    }
+    else if (!sf && !selfstat_files[i].f && strlen(path) < sizeof(sf->path))
+      sf = selfstat_files + i;
+
+  if (sf && !sf->used)
+  {
+    if (sf->f && sf->fd >= 0 && sf->gen == selfstat_rootgen)
+    {
+      rewind(sf->f);
+      sf->used = 1;
+      return sf->f;
+    }
+    /* first open or new root, the stream is kept */
+    if (sf->fd >= 0 && sf->f)
+      close(sf->fd);
+    if ((sf->fd = selfstat_open(path, O_RDONLY | O_CLOEXEC)) < 0)
+      return NULL;
+    sf->gen = selfstat_rootgen;
+    sf->off = 0;
+    if (!sf->f)
+    {
+      strcpy(sf->path, path);
+      if ((sf->f = fopencookie(sf, mode, selfstat_cookie)) == NULL)
+      {
+        close(sf->fd);
+        sf->fd = -1;
+        return NULL;
+      }
+      setvbuf(sf->f, sf->buf, _IOFBF, sizeof(sf->buf));
+    }
+    else
+      rewind(sf->f);
+    sf->used = 1;
+    return sf->f;
+  }
+
+  if ((fd = selfstat_open(path, O_RDONLY | O_CLOEXEC)) < 0)
+    return NULL;
+  if ((f = fopencookie((void *)(intptr_t)fd, mode, selfstat_fd_cookie)) == NULL)
+    close(fd);
+  return f;
+#else
+  char buf[PATH_MAX];
+
+  selfstat_io.opens++;
+  return fopen(selfstat_path(path, buf, sizeof(buf)), mode);
+#endif
+}
+
+int selfstat_fclose(FILE *f)
+{
+#ifdef linux
+  int i;
+
+  for (i = 0; i < SELFSTAT_FILES; i++)
+    if (selfstat_files[i].f == f)
+    {
+      selfstat_files[i].used = 0;
+      return 0;
+    }
+#endif
+  return fclose(f);
+}
+
+int selfstat_open(const char *path, int flags)
+{
+  char buf[PATH_MAX];
+
+  selfstat_io.opens++;
+  return open(selfstat_path(path, buf, sizeof(buf)), flags);
+}
+
+int selfstat_openat(int dirfd, const char *path, int flags)
+{
+  selfstat_io.opens++;
+  return openat(dirfd, path, flags);
+}
+
+DIR *selfstat_opendir(const char *path)
+{
+  char buf[PATH_MAX];
+
+  selfstat_io.opens++;
+  return opendir(selfstat_path(path, buf, sizeof(buf)));
+}
+
+ssize_t selfstat_read(int fd, void *buf, size_t n)
+{
+  ssize_t r = read(fd, buf, n);
+
+  selfstat_io.reads++;
+  if (r > 0)
+    selfstat_io.bytes += (uint64_t)r;
+  return r;
+}
+
+ssize_t selfstat_pread(int fd, void *buf, size_t n, off_t off)
+{
+  ssize_t r = pread(fd, buf, n, off);
+
+  selfstat_io.reads++;
+  if (r > 0)
+    selfstat_io.bytes += (uint64_t)r;
+  return r;
+}
+
+ssize_t selfstat_pread_all(int fd, char **buf, size_t *size, size_t min)
+{
+  size_t len = 0;
+  ssize_t n;
+  char *b;
+
+  for (;;)
+  {
+    if (*size - len < 2)
+    {
+      if ((b = realloc(*buf, (*size) ? *size * 2 : min)) == NULL)
+        return -1;
+      *buf = b;
+      *size = (*size) ? *size * 2 : min;
+    }
+    if ((n = selfstat_pread(fd, *buf + len, *size - len - 1, len)) < 0)
+      return -1;
+    len += n;
+    /* a short read is the end of the file */
+    if ((size_t)n < *size - (len - n) - 1)
+      break;
+  }
+  (*buf)[len] = '\0';
+  return len;
+}
+
+uint64_t selfstat_cpu(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * SCHEDULER_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+void selfstat_begin(selfstat_mark_t *m)
+{
+  m->io = selfstat_io;
+  m->allocs = selfstat_allocs;
+  m->cpu_ns = selfstat_cpu();
+  m->wall_ns = scheduler_clock();
+}
+
+void selfstat_end(const selfstat_mark_t *m, selfstat_t *st)
+{
+  st->wall_ns = scheduler_clock() - m->wall_ns;
+  st->cpu_ns = selfstat_cpu() - m->cpu_ns;
+  st->io.opens = selfstat_io.opens - m->io.opens;
+  st->io.reads = selfstat_io.reads - m->io.reads;
+  st->io.bytes = selfstat_io.bytes - m->io.bytes;
+  st->calls++;
+  st->total_calls++;
+  st->total_wall_ns += st->wall_ns;
+  st->total_bytes += st->io.bytes;
+  st->total_allocs += selfstat_allocs - m->allocs;
+  sketch_add(&st->wall_us, st->wall_ns / 1000.0);
+  sketch_add(&st->cpu_us, st->cpu_ns / 1000.0);
+}
+
+/* the last values are kept */
+void selfstat_reset(selfstat_t *st)
+{
+  st->calls = 0;
+  sketch_reset(&st->wall_us);
+  sketch_reset(&st->cpu_us);
+}
@@ -0,0 +1,107 @@
+/* selfstat.h
+ *
+ * Self instrumentation of jsonperfmon: cost of each collector.
+ *
+ * The collectors read /proc and /sys through the wrappers below, which count
+ * the opens, the reads and the bytes read. A probe around a collector gives
+ * its wall and cpu times (CLOCK_THREAD_CPUTIME_ID) and the accesses it made,
+ * the times are also added to sketches so their distribution over the period
+ * of the self group is known and mergeable across hosts.
+ *
+ * The wrappers also prefix the paths by a root ("" on a live host), so the
+ * collectors can read a container host tree or a capture to replay.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _SELFSTAT_H
+#define _SELFSTAT_H
+
+#include <stdio.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include "sketch.h"
+
+typedef struct {
+  uint64_t opens;
+  uint64_t reads;
+  uint64_t bytes;
+} selfstat_io_t;
+
+/* accesses of the whole process, only incremented */
+extern selfstat_io_t selfstat_io;
+
+/* heap allocations of the process, only counted by a build with
+ * -DALLOC_CHECK=ON which interposes malloc (alloccount.c) */
+extern uint64_t selfstat_allocs;
+
+typedef struct {
+  uint64_t wall_ns;
+  uint64_t cpu_ns;
+  selfstat_io_t io;
+  uint64_t allocs;
+} selfstat_mark_t;
+
+typedef struct {
+  uint32_t calls;       /* since the last reset */
+  uint64_t wall_ns;     /* last call */
+  uint64_t cpu_ns;
+  selfstat_io_t io;
+  sketch_t wall_us;     /* since the last reset */
+  sketch_t cpu_us;
+  uint64_t total_calls; /* since the start */
+  uint64_t total_wall_ns;
+  uint64_t total_bytes;
+  uint64_t total_out;   /* json bytes produced */
+  uint64_t total_allocs;
+} selfstat_t;
+
+/* files kept open between the ticks */
+#define SELFSTAT_FILES 64
+
+void    selfstat_root(const char *root);
+/* changes with the root, to reopen what was opened under the previous one */
+unsigned int selfstat_generation(void);
+/* path under the root, in buf if there is a root */
+const char *selfstat_path(const char *path, char *buf, size_t len);
+
+/* a file of the table is only rewound by the next open, selfstat_fclose
+ * releases it without closing */
+FILE   *selfstat_fopen(const char *path, const char *mode);
+int     selfstat_fclose(FILE *f);
+int     selfstat_open(const char *path, int flags);
+/* relative to a directory already opened under the root */
+int     selfstat_openat(int dirfd, const char *path, int flags);
+DIR    *selfstat_opendir(const char *path);
+ssize_t selfstat_read(int fd, void *buf, size_t n);
+ssize_t selfstat_pread(int fd, void *buf, size_t n, off_t off);
+/* the whole file in *buf, nul terminated, grown from min and never shrunk */
+ssize_t selfstat_pread_all(int fd, char **buf, size_t *size, size_t min);
+
+/* cpu time of the calling thread in ns */
+uint64_t selfstat_cpu(void);
+
+void    selfstat_begin(selfstat_mark_t *m);
+void    selfstat_end(const selfstat_mark_t *m, selfstat_t *st);
+void    selfstat_reset(selfstat_t *st);
+
+#endif /* _SELFSTAT_H */
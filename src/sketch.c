@@ -0,0 +1,142 @@
+/* sketch.c
+ *
+ * Streaming quantile sketch with log-linear buckets (HDR histogram like).
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sketch.h"
+
+void sketch_reset(sketch_t *sk)
+{
+  memset(sk, 0, sizeof(*sk));
+}
+
+static inline int sketch_index(double v)
+{
+  int e, idx;
+  double m = frexp(v, &e);   /* v = m * 2^e with m in [0.5, 1[ */
+
+  idx = (e - 1 - SKETCH_MIN_EXP) * SKETCH_SUB + (int)((2*m - 1) * SKETCH_SUB);
+  return (idx < SKETCH_BUCKETS) ? idx : SKETCH_BUCKETS - 1;
+}
+
+/* middle of the bucket */
+static inline double sketch_value(int idx)
+{
+  return ldexp(1.0 + (idx % SKETCH_SUB + 0.5) / SKETCH_SUB, idx / SKETCH_SUB + SKETCH_MIN_EXP);
+}
+
+void sketch_add(sketch_t *sk, double v)
+{
+  if (!sk->count || v > sk->max)
+    sk->max = v;
+  sk->count++;
+
+  if (v < ldexp(1.0, SKETCH_MIN_EXP))
+    sk->zero++;
+  else
+    sk->buckets[sketch_index(v)]++;
+}
+
+void sketch_merge(sketch_t *dst, const sketch_t *src)
+{
+  int i;
+
+  if (!src->count)
+    return;
+  if (!dst->count || src->max > dst->max)
+    dst->max = src->max;
+  dst->count += src->count;
+  dst->zero += src->zero;
+  for (i = 0; i < SKETCH_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+}
+
+double sketch_quantile(const sketch_t *sk, double q)
+{
+  uint32_t rank, seen;
+  int i;
+
+  if (!sk->count)
+    return 0;
+
+  rank = (uint32_t)ceil(q * sk->count);
+  if (!rank)
+    rank = 1;
+
+  if ((seen = sk->zero) >= rank)
+    return 0;
+
+  for (i = 0; i < SKETCH_BUCKETS - 1; i++)
+    if ((seen += sk->buckets[i]) >= rank)
+    {
+      double v = sketch_value(i);
+      return (v > sk->max) ? sk->max : v;
+    }
+  return sk->max;
+}
+
+void sketch_append(GString *out, const sketch_t *sk)
+{
+  char *sep = "";
+  int i;
+
+  g_string_append_printf(out, "%d,%d;%g;%" PRIu32 ";", SKETCH_SUB_BITS, SKETCH_MIN_EXP, sk->max, sk->zero);
+  for (i = 0; i < SKETCH_BUCKETS; i++)
+    if (sk->buckets[i])
+    {
+      g_string_append_printf(out, "%s%d:%" PRIu32, sep, i, sk->buckets[i]);
+      sep = ",";
+    }
+}
+
+int sketch_parse(sketch_t *sk, const char *str)
+{
+  char *p;
+  long idx;
+
+  sketch_reset(sk);
+  if (strtol(str, &p, 10) != SKETCH_SUB_BITS || *p != ',' || strtol(p + 1, &p, 10) != SKETCH_MIN_EXP || *p != ';')
+    return -1;
+
+  sk->max = strtod(p + 1, &p);
+  if (*p != ';')
+    return -1;
+  sk->count = sk->zero = (uint32_t)strtoul(p + 1, &p, 10);
+  if (*p++ != ';')
+    return -1;
+
+  while (*p >= '0' && *p <= '9')
+  {
+    idx = strtol(p, &p, 10);
+    if (*p != ':' || idx < 0 || idx >= SKETCH_BUCKETS)
+      return -1;
+    sk->buckets[idx] = (uint32_t)strtoul(p + 1, &p, 10);
+    sk->count += sk->buckets[idx];
+    if (*p == ',')
+      p++;
+  }
+  return 0;
+}
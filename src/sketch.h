@@ -0,0 +1,65 @@
+/* sketch.h
+ *
+ * Streaming quantile sketch with log-linear buckets (HDR histogram like).
+ *
+ * Each octave [2^e, 2^(e+1)[ is split in SKETCH_SUB linear buckets so the
+ * relative error of a quantile is lower than 1/(2*SKETCH_SUB). The bucket
+ * layout only depends on the constants below, so two sketches are merged
+ * exactly by adding their counts, whatever host produced them.
+ *
+ * The serialized form is "<sub_bits>,<min_exp>;<max>;<zero>;<idx>:<count>,..."
+ * where zero counts the values lower than 2^min_exp and only the non empty
+ * buckets are listed. The last bucket also holds the values beyond its
+ * octave, a quantile falling in it is the max.
+ *
+ * Copyright 2019 Philippe Duveau and Pari Mutuel Urbain.
+ *
+ * This file is part of jsonperfmon.
+ *
+ * Jsonperfmon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Jsonperfmon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jsonperfmon.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A copy of the GPL can be found in the file "COPYING" in this distribution.
+ */
+
+#ifndef _SKETCH_H
+#define _SKETCH_H
+
+#include <inttypes.h>
+
+#include "glib_compat.h"
+
+#define SKETCH_SUB_BITS 3
+#define SKETCH_SUB      (1 << SKETCH_SUB_BITS)
+#define SKETCH_MIN_EXP  (-4)   /* values under 1/16 count as zero */
+#define SKETCH_OCTAVES  68     /* up to 2^64, the whole range of the counters and rates */
+#define SKETCH_BUCKETS  (SKETCH_OCTAVES * SKETCH_SUB)
+
+typedef struct {
+  uint32_t count;
+  uint32_t zero;
+  double max;
+  uint32_t buckets[SKETCH_BUCKETS];
+} sketch_t;
+
+void   sketch_reset(sketch_t *sk);
+void   sketch_add(sketch_t *sk, double v);
+/* adds the counts of src, both have the same bucket layout */
+void   sketch_merge(sketch_t *dst, const sketch_t *src);
+double sketch_quantile(const sketch_t *sk, double q);
+
+void   sketch_append(GString *out, const sketch_t *sk);
+/* reads the serialized form, -1 when it is invalid or of another layout */
+int    sketch_parse(sketch_t *sk, const char *str);
+
+#endif /* _SKETCH_H */